@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+/*
+ * Tiny self-timing benchmark harness.
+ *
+ * Each benchmark runs its body repeatedly for at least BENCHMARK_MIN_TIME_MS
+ * and prints one line of JSON with the mean time per iteration, so the
+ * output can be piped straight into jq or a spreadsheet. When a benchmark
+ * processes audio it also gives how many times faster than real time it
+ * ran.
+ */
+
+#define BENCHMARK_MIN_TIME_MS 500
+
+using BenchmarkCounters = std::initializer_list<std::pair<const char*, double>>;
+
+/*
+ * Times `body`. `audioSeconds` is the length of audio one iteration
+ * processes (0 if it isn't audio), `counters` are extra values added to
+ * the JSON line as they are.
+ */
+void    runBenchmark(const char* name, double audioSeconds, const std::function<void()>& body, BenchmarkCounters counters = {});
+
+/*
+ * For benchmarks that run once rather than being timed by runBenchmark().
+ * Whether `name` matches the filter, and its result as one line of JSON.
+ */
+bool    benchmarkSelected(const char* name);
+void    reportBenchmark(const char* name, BenchmarkCounters counters);
+
+/*
+ * Reports a benchmark whose result is wrong, not just slow. The run then
+ * exits non-zero.
+ */
+void    benchmarkFailed(const char* name, const char* message);
+
+/*
+ * Keeps the compiler from optimising away work whose result is unused
+ */
+void    doNotOptimise(const void* data);
+
+/*
+ * Seeded synthetic music, 16kHz mono, for benchmarks that need a real
+ * signature
+ */
+std::vector<int16_t>    makeBenchmarkMusic(int seconds);
+
+/*
+ * Benchmark suites
+ */
+void    benchmarkDecimator();
+void    benchmarkCapture();
+void    benchmarkFingerprint();
+void    benchmarkShazam();
+void    benchmarkHedging();
@@ -0,0 +1,170 @@
+#include <QByteArray>
+#include <cmath>
+#include <cstring>
+#include <numbers>
+#include <string>
+#include <vector>
+
+#include "audio/buffer_pool.h"
+#include "audio/decimator.h"
+#include "audio/ring_buffer.h"
+#include "audio/rolling_window.h"
+#include "bench.h"
+#include "capture/capture_source.h"
+
+#define CAPTURE_BENCHMARK_SAMPLE_RATE 48000
+#define CAPTURE_BENCHMARK_CHANNELS 2
+
+// PipeWire's usual quantum range, 1024 is the default
+#define CAPTURE_BENCHMARK_QUANTA { 256, 512, 1024, 2048 }
+
+/*
+ * One second of stereo F32 audio
+ */
+static std::vector<char> makeSecond() {
+    std::vector<char> audio(static_cast<size_t>(CAPTURE_BENCHMARK_SAMPLE_RATE) * CAPTURE_BENCHMARK_CHANNELS * sizeof(float));
+    auto* samples = reinterpret_cast<float*>(audio.data());
+
+    for (int frame = 0; frame < CAPTURE_BENCHMARK_SAMPLE_RATE; frame++) {
+        const double time = static_cast<double>(frame) / CAPTURE_BENCHMARK_SAMPLE_RATE;
+        samples[frame * 2] = static_cast<float>(0.4 * std::sin(2 * std::numbers::pi * 440.0 * time));
+        samples[frame * 2 + 1] = static_cast<float>(0.3 * std::sin(2 * std::numbers::pi * 660.0 * time));
+    }
+
+    return audio;
+}
+
+static void benchmarkQuantum(const std::vector<char>& second, int quantumFrames) {
+    AudioFormat format;
+    format.sampleRate = CAPTURE_BENCHMARK_SAMPLE_RATE;
+    format.bitsPerSample = 32;
+    format.channels = CAPTURE_BENCHMARK_CHANNELS;
+    format.floatingPoint = true;
+
+    const auto quantumSize = static_cast<size_t>(quantumFrames) * format.bytesPerFrame();
+    const size_t quantaPerSecond = second.size() / quantumSize;
+
+    // The drain timer picks up whatever arrived in the last 20ms
+    const size_t drainSize = static_cast<size_t>(format.sampleRate) * format.bytesPerFrame() * AUDIO_RING_BUFFER_DRAIN_INTERVAL_MS / 1000;
+
+    AudioRingBuffer ringBuffer(AUDIO_RING_BUFFER_CAPACITY);
+    const std::string suffix = "_q" + std::to_string(quantumFrames) + "_stereo_f32";
+
+    // What the real-time thread does with each quantum, the consumer
+    // side just throws the audio away
+    runBenchmark(("ring_write" + suffix).c_str(), 1.0, [&] {
+        size_t sinceDrain = 0;
+
+        for (size_t quantum = 0; quantum < quantaPerSecond; quantum++) {
+            ringBuffer.write(second.data() + quantum * quantumSize, quantumSize);
+
+            sinceDrain += quantumSize;
+            if (sinceDrain >= drainSize) {
+                ringBuffer.discard();
+                sinceDrain = 0;
+            }
+        }
+
+        ringBuffer.discard();
+    }, {
+        { "quantum_frames", static_cast<double>(quantumFrames) },
+        { "quanta", static_cast<double>(quantaPerSecond) },
+    });
+
+    // The whole append path, quanta into the ring buffer and drains into
+    // the capture buffer. Same steps as CaptureSource::drainAndDecimate().
+    AudioDecimator decimator;
+    decimator.configure(format);
+
+    QByteArray drainBuffer(AUDIO_DRAIN_BLOCK_SIZE, Qt::Uninitialized);
+    const qsizetype blockSize = AUDIO_DRAIN_BLOCK_SIZE - AUDIO_DRAIN_BLOCK_SIZE % format.bytesPerFrame();
+    QByteArray captureBuffer;
+
+    const auto drain = [&] {
+        while (ringBuffer.getAvailable() > 0) {
+            const auto bytesRead = static_cast<qsizetype>(ringBuffer.read(drainBuffer.data(), static_cast<size_t>(blockSize)));
+            if (bytesRead == 0) {
+                break;
+            }
+
+            const qsizetype size = captureBuffer.size();
+            captureBuffer.resize(size + decimator.getMaxOutputSamples(bytesRead) * qsizetype(sizeof(int16_t)));
+
+            const qsizetype samples = decimator.process(
+                drainBuffer.constData(), bytesRead, reinterpret_cast<int16_t*>(captureBuffer.data() + size));
+            captureBuffer.resize(size + samples * qsizetype(sizeof(int16_t)));
+        }
+    };
+
+    runBenchmark(("capture_append" + suffix).c_str(), 1.0, [&] {
+        decimator.reset();
+        captureBuffer.resize(0);
+        captureBuffer.reserve(DECIMATED_SAMPLE_RATE * sizeof(int16_t));
+        size_t sinceDrain = 0;
+
+        for (size_t quantum = 0; quantum < quantaPerSecond; quantum++) {
+            ringBuffer.write(second.data() + quantum * quantumSize, quantumSize);
+
+            sinceDrain += quantumSize;
+            if (sinceDrain >= drainSize) {
+                drain();
+                sinceDrain = 0;
+            }
+        }
+
+        drain();
+        doNotOptimise(captureBuffer.constData());
+    }, {
+        { "quantum_frames", static_cast<double>(quantumFrames) },
+        { "quanta", static_cast<double>(quantaPerSecond) },
+    });
+}
+
+/*
+ * Handing a finished capture over to fingerprinting, the same steps as
+ * CaptureSource::completeFromPrerollWindow(). Each capture is still held
+ * (as if being fingerprinted) until the next one is handed over, the worst
+ * case for the pool. That it doesn't allocate once warm is checked by the
+ * capture test.
+ */
+static void benchmarkHandoff() {
+    const qsizetype captureSize = qsizetype(DECIMATED_SAMPLE_RATE) * qsizetype(sizeof(int16_t)) * DEFAULT_CAPTURE_LENGTH_IN_SECONDS;
+
+    RollingAudioWindow window;
+    window.setCapacity(captureSize);
+
+    const std::vector<int16_t> music = makeBenchmarkMusic(DEFAULT_CAPTURE_LENGTH_IN_SECONDS);
+    window.append(reinterpret_cast<const char*>(music.data()), captureSize);
+
+    AudioBufferPool pool;
+    QByteArray fingerprinting;
+
+    const auto handoff = [&] {
+        QByteArray buffer = pool.acquire(captureSize);
+        window.snapshot(captureSize, buffer);
+
+        // The previous capture is done with as this one is handed over
+        fingerprinting = buffer;
+        pool.recycle(std::move(buffer));
+        doNotOptimise(fingerprinting.constData());
+    };
+
+    // Fills the pool
+    handoff();
+    handoff();
+
+    const std::string name = "capture_handoff_" + std::to_string(DEFAULT_CAPTURE_LENGTH_IN_SECONDS) + "s";
+    runBenchmark(name.c_str(), DEFAULT_CAPTURE_LENGTH_IN_SECONDS, handoff, {
+        { "capture_bytes", static_cast<double>(captureSize) },
+    });
+}
+
+void benchmarkCapture() {
+    const std::vector<char> second = makeSecond();
+
+    for (const int quantumFrames : CAPTURE_BENCHMARK_QUANTA) {
+        benchmarkQuantum(second, quantumFrames);
+    }
+
+    benchmarkHandoff();
+}
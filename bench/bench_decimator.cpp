@@ -0,0 +1,70 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numbers>
+#include <string>
+#include <vector>
+
+#include "audio/decimator.h"
+#include "bench.h"
+
+#define DECIMATOR_BENCHMARK_SECONDS 10
+
+// Roughly what a 20ms drain picks up from a 48kHz stream
+#define DECIMATOR_BENCHMARK_CHUNK_FRAMES 960
+
+/*
+ * A few seconds of stereo F32 audio, as PipeWire delivers it
+ */
+static std::vector<char> makeStereoAudio(int sampleRate, int seconds) {
+    const int frames = sampleRate * seconds;
+    std::vector<char> audio(static_cast<size_t>(frames) * 2 * sizeof(float));
+
+    for (int frame = 0; frame < frames; frame++) {
+        const double time = static_cast<double>(frame) / sampleRate;
+        const float left = static_cast<float>(0.4 * std::sin(2 * std::numbers::pi * 440.0 * time));
+        const float right = static_cast<float>(0.3 * std::sin(2 * std::numbers::pi * 1250.0 * time));
+        memcpy(audio.data() + (frame * 2) * sizeof(float), &left, sizeof(float));
+        memcpy(audio.data() + (frame * 2 + 1) * sizeof(float), &right, sizeof(float));
+    }
+
+    return audio;
+}
+
+static void benchmarkRate(int sampleRate) {
+    AudioFormat format;
+    format.sampleRate = sampleRate;
+    format.bitsPerSample = 32;
+    format.channels = 2;
+    format.floatingPoint = true;
+
+    const std::vector<char> audio = makeStereoAudio(sampleRate, DECIMATOR_BENCHMARK_SECONDS);
+    const qsizetype chunkSize = DECIMATOR_BENCHMARK_CHUNK_FRAMES * format.bytesPerFrame();
+
+    AudioDecimator decimator;
+    decimator.configure(format);
+    std::vector<int16_t> output(decimator.getMaxOutputSamples(static_cast<qsizetype>(audio.size())));
+
+    const std::string name = "decimate_" + std::to_string(sampleRate) + "_stereo_f32";
+
+    runBenchmark(name.c_str(), DECIMATOR_BENCHMARK_SECONDS, [&] {
+        decimator.reset();
+        qsizetype written = 0;
+
+        // Chunk by chunk, the way the drain timer feeds it
+        for (qsizetype offset = 0; offset < static_cast<qsizetype>(audio.size()); offset += chunkSize) {
+            const qsizetype size = std::min(chunkSize, static_cast<qsizetype>(audio.size()) - offset);
+            written += decimator.process(audio.data() + offset, size, output.data() + written);
+        }
+
+        doNotOptimise(output.data());
+    }, {
+        { "input_bytes_per_second", static_cast<double>(sampleRate) * format.bytesPerFrame() },
+        { "output_bytes_per_second", static_cast<double>(DECIMATED_SAMPLE_RATE) * sizeof(int16_t) },
+    });
+}
+
+void benchmarkDecimator() {
+    benchmarkRate(44100);
+    benchmarkRate(48000);
+}
@@ -0,0 +1,62 @@
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+#include <random>
+#include <vector>
+#include <vibra.h>
+
+#include "audio/decimator.h"
+#include "bench.h"
+#include "fingerprint/streaming_fingerprinter.h"
+
+// Shazam only ever gets 12 seconds
+#define FINGERPRINT_BENCHMARK_SECONDS SIGNATURE_MAX_SECONDS
+
+/*
+ * Decaying notes at random pitches, so the peak search has something to
+ * find. Seeded, so every run fingerprints the same audio.
+ */
+std::vector<int16_t> makeBenchmarkMusic(int seconds) {
+    std::vector<int16_t> audio(static_cast<size_t>(DECIMATED_SAMPLE_RATE) * seconds);
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<double> pitch(200.0, 4000.0);
+
+    const int noteLength = DECIMATED_SAMPLE_RATE / 4;
+    double frequency = pitch(random);
+
+    for (size_t i = 0; i < audio.size(); i++) {
+        const int position = static_cast<int>(i % noteLength);
+        if (position == 0) {
+            frequency = pitch(random);
+        }
+
+        const double time = static_cast<double>(position) / DECIMATED_SAMPLE_RATE;
+        const double sample = 0.5 * std::exp(-6.0 * time) * std::sin(2 * std::numbers::pi * frequency * time);
+        audio[i] = static_cast<int16_t>(sample * 32767.0);
+    }
+
+    return audio;
+}
+
+void benchmarkFingerprint() {
+    const std::vector<int16_t> audio = makeBenchmarkMusic(FINGERPRINT_BENCHMARK_SECONDS);
+    const auto* data = reinterpret_cast<const char*>(audio.data());
+    const auto size = static_cast<qsizetype>(audio.size() * sizeof(int16_t));
+
+    const double seconds = FINGERPRINT_BENCHMARK_SECONDS;
+
+    runBenchmark("fingerprint_vibra_12s", seconds, [&] {
+        const auto fingerprint = vibra_get_fingerprint_from_signed_pcm(data, static_cast<int>(size), DECIMATED_SAMPLE_RATE, 16, 1);
+        doNotOptimise(vibra_get_uri_from_fingerprint(fingerprint));
+    });
+
+    const AudioFormat format = AudioDecimator::outputFormat();
+    StreamingFingerprinter fingerprinter;
+
+    runBenchmark("fingerprint_native_12s", seconds, [&] {
+        fingerprinter.reset();
+        fingerprinter.feed(data, size, format);
+        const QString uri = fingerprinter.getSignature().encodeToUri();
+        doNotOptimise(uri.constData());
+    });
+}
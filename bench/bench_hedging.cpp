@@ -0,0 +1,88 @@
+#include <QEventLoop>
+#include <QFile>
+#include <QTimer>
+
+#include "bench.h"
+#include "fingerprint/signature_generator.h"
+#include "latency_stats.h"
+#include "mock_shazam_server.h"
+#include "shazam/shazam.h"
+
+// Lookups made at once against the mock server. One in every
+// HEDGING_BENCHMARK_STALL_EVERY stalls, few enough to stay above the
+// percentile lookups are hedged at.
+#define HEDGING_BENCHMARK_LOOKUPS 200
+#define HEDGING_BENCHMARK_DELAY_MS 50
+#define HEDGING_BENCHMARK_STALL_MS 2000
+#define HEDGING_BENCHMARK_STALL_EVERY 25
+
+// Gives up on a run that has stopped answering
+#define HEDGING_BENCHMARK_TIMEOUT_MS 60000
+
+/*
+ * Hedged lookups against a mock Shazam that stalls now and again. The
+ * requests hedges beat are left to finish, so what hedging saved is
+ * measured rather than guessed.
+ */
+void benchmarkHedging() {
+    if (!benchmarkSelected("shazam_hedging")) {
+        return;
+    }
+
+    QFile file(":/bench/data/shazam_response_found.json");
+    if (!file.open(QIODevice::ReadOnly)) {
+        benchmarkFailed("shazam_hedging", "couldn't open the sample response");
+        return;
+    }
+
+    MockShazamServer server(file.readAll(), nullptr);
+    server.setDelays(HEDGING_BENCHMARK_DELAY_MS, HEDGING_BENCHMARK_STALL_MS, HEDGING_BENCHMARK_STALL_EVERY);
+    if (!server.listen(0)) {
+        benchmarkFailed("shazam_hedging", "the mock server couldn't listen");
+        return;
+    }
+
+    // Read when the client is made
+    qputenv(SHAZAM_URL_ENVIRONMENT_VARIABLE, "http://localhost:" + QByteArray::number(server.getPort()) + "/");
+
+    Shazam shazam(nullptr);
+    shazam.setLookupCache(false);
+    shazam.setMeasureHedging(true);
+
+    QEventLoop loop;
+    int answered = 0;
+    QObject::connect(&shazam, &Shazam::detectionComplete, &loop, [&] {
+        if (++answered == HEDGING_BENCHMARK_LOOKUPS) {
+            loop.quit();
+        }
+    });
+
+    // Every one different, so none of them share a result
+    for (int i = 0; i < HEDGING_BENCHMARK_LOOKUPS; i++) {
+        shazam.detectFromUri(QStringLiteral("data:audio/vnd.shazam.sig;base64,lookup%1").arg(i), SIGNATURE_MAX_SECONDS);
+    }
+
+    QTimer::singleShot(HEDGING_BENCHMARK_TIMEOUT_MS, &loop, &QEventLoop::quit);
+    loop.exec();
+
+    // The requests hedges beat are still going
+    QTimer::singleShot(HEDGING_BENCHMARK_STALL_MS, &loop, &QEventLoop::quit);
+    loop.exec();
+
+    if (answered < HEDGING_BENCHMARK_LOOKUPS) {
+        benchmarkFailed("shazam_hedging", "not every lookup was answered");
+    } else if (shazam.getHedgeWins() == 0) {
+        benchmarkFailed("shazam_hedging", "no hedge answered first");
+    }
+
+    reportBenchmark("shazam_hedging", {
+        { "lookups", static_cast<double>(server.getLookups()) },
+        { "stalls", static_cast<double>(server.getStalls()) },
+        { "hedged", static_cast<double>(shazam.getHedged()) },
+        { "hedge_wins", static_cast<double>(shazam.getHedgeWins()) },
+        { "round_trip_p50_ms", latencyPercentile(LatencyStage::HttpRoundTrip, 0.50) },
+        { "hedged_lookup_p50_ms", latencyPercentile(LatencyStage::HedgedLookup, 0.50) },
+        { "hedge_saving_p50_ms", latencyPercentile(LatencyStage::HedgeSaving, 0.50) },
+        { "hedge_saving_p95_ms", latencyPercentile(LatencyStage::HedgeSaving, 0.95) },
+    });
+}
@@ -0,0 +1,104 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <QCoreApplication>
+#include <QtGlobal>
+
+#include "bench.h"
+
+static const char* g_filter = nullptr;
+static bool g_failed = false;
+
+bool benchmarkSelected(const char* name) {
+    return g_filter == nullptr || strstr(name, g_filter) != nullptr;
+}
+
+void runBenchmark(const char* name, double audioSeconds, const std::function<void()>& body, BenchmarkCounters counters) {
+    if (!benchmarkSelected(name)) {
+        return;
+    }
+
+    using Clock = std::chrono::steady_clock;
+
+    // Warm up caches, lazily built tables and the CPU clock
+    body();
+
+    long iterations = 0;
+    const auto start = Clock::now();
+    auto elapsed = Clock::duration::zero();
+
+    while (elapsed < std::chrono::milliseconds(BENCHMARK_MIN_TIME_MS)) {
+        body();
+        iterations++;
+        elapsed = Clock::now() - start;
+    }
+
+    const double nanoseconds = std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+
+    printf("{\"benchmark\":\"%s\",\"iterations\":%ld,\"ns_per_iteration\":%.0f", name, iterations, nanoseconds);
+
+    if (audioSeconds > 0) {
+        printf(",\"audio_seconds\":%g,\"ns_per_audio_second\":%.0f,\"realtime_factor\":%.1f",
+            audioSeconds, nanoseconds / audioSeconds, audioSeconds * 1e9 / nanoseconds);
+    }
+
+    for (const auto& [counter, value] : counters) {
+        printf(",\"%s\":%g", counter, value);
+    }
+
+    printf("}\n");
+    fflush(stdout);
+}
+
+void reportBenchmark(const char* name, BenchmarkCounters counters) {
+    printf("{\"benchmark\":\"%s\"", name);
+
+    for (const auto& [counter, value] : counters) {
+        printf(",\"%s\":%g", counter, value);
+    }
+
+    printf("}\n");
+    fflush(stdout);
+}
+
+void benchmarkFailed(const char* name, const char* message) {
+    fprintf(stderr, "%s failed: %s\n", name, message);
+    g_failed = true;
+}
+
+void doNotOptimise(const void* data) {
+    asm volatile("" : : "r"(data) : "memory");
+}
+
+/*
+ * Keeps the code under test from logging into the JSON output
+ */
+static void quietMessageHandler(QtMsgType type, const QMessageLogContext& context, const QString& message) {
+    Q_UNUSED(context);
+
+    if (type == QtCriticalMsg || type == QtFatalMsg) {
+        fprintf(stderr, "%s\n", qPrintable(message));
+    }
+}
+
+/*
+ * Usage: SongDetector_bench [name filter]
+ */
+int main(int argc, char* argv[]) {
+    // The hedging benchmark needs an event loop
+    QCoreApplication app(argc, argv);
+
+    if (argc > 1) {
+        g_filter = argv[1];
+    }
+
+    qInstallMessageHandler(quietMessageHandler);
+
+    benchmarkDecimator();
+    benchmarkCapture();
+    benchmarkFingerprint();
+    benchmarkShazam();
+    benchmarkHedging();
+
+    return g_failed ? 1 : 0;
+}
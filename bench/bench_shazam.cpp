@@ -0,0 +1,107 @@
+#include <QFile>
+#include <QJsonDocument>
+#include <QString>
+
+#include "audio/decimator.h"
+#include "bench.h"
+#include "fingerprint/streaming_fingerprinter.h"
+#include "shazam/shazam_body.h"
+#include "shazam/shazam_codec.h"
+#include "shazam/shazam_response.h"
+
+#define SHAZAM_BENCHMARK_SAMPLE_MS (SIGNATURE_MAX_SECONDS * 1000)
+
+static QByteArray readResource(const QString& path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qFatal("Failed to open %s", qPrintable(path));
+    }
+
+    return file.readAll();
+}
+
+static void benchmarkParse(const char* name, const QString& path) {
+    const QByteArray json = readResource(path);
+
+    runBenchmark(name, 0, [&] {
+        const auto response = ShazamResponse::fromJsonDocument(QJsonDocument::fromJson(json));
+        doNotOptimise(&response);
+    }, {
+        { "bytes", static_cast<double>(json.size()) },
+    });
+}
+
+static void benchmarkStreamParse(const char* name, const QString& path) {
+    const QByteArray json = readResource(path);
+
+    // Has to pick out the same song as the DOM parser
+    const auto expected = ShazamResponse::fromJsonDocument(QJsonDocument::fromJson(json));
+    ShazamResponseFields fields;
+    if (!parseShazamResponse(json, fields)) {
+        benchmarkFailed(name, "the response didn't parse");
+        return;
+    }
+
+    const auto actual = ShazamResponse::fromFields(fields);
+    if (actual.getFound() != expected.getFound() ||
+        actual.getTitle() != expected.getTitle() ||
+        actual.getArtist() != expected.getArtist() ||
+        actual.getAlbum() != expected.getAlbum() ||
+        actual.getKey() != expected.getKey() ||
+        actual.getReleaseDate() != expected.getReleaseDate() ||
+        actual.getOffset() != expected.getOffset()) {
+        benchmarkFailed(name, "the result differs from the DOM parser's");
+    }
+
+    runBenchmark(name, 0, [&] {
+        ShazamResponseFields parsed;
+        parseShazamResponse(json, parsed);
+        const auto response = ShazamResponse::fromFields(parsed);
+        doNotOptimise(&response);
+    }, {
+        { "bytes", static_cast<double>(json.size()) },
+    });
+}
+
+void benchmarkShazam() {
+    // A real signature, so the body is the size Shazam actually receives
+    const std::vector<int16_t> audio = makeBenchmarkMusic(SIGNATURE_MAX_SECONDS);
+    StreamingFingerprinter fingerprinter;
+    fingerprinter.feed(reinterpret_cast<const char*>(audio.data()),
+        static_cast<qsizetype>(audio.size() * sizeof(int16_t)), AudioDecimator::outputFormat());
+    const QString uri = fingerprinter.getSignature().encodeToUri();
+
+    const auto bodySize = ShazamBody(uri, SHAZAM_BENCHMARK_SAMPLE_MS).toJsonDocument().toJson(QJsonDocument::Compact).size();
+
+    runBenchmark("shazam_body_serialise", 0, [&] {
+        const ShazamBody body(uri, SHAZAM_BENCHMARK_SAMPLE_MS);
+        const QByteArray json = body.toJsonDocument().toJson(QJsonDocument::Compact);
+        doNotOptimise(json.constData());
+    }, {
+        { "bytes", static_cast<double>(bodySize) },
+    });
+
+    // Written into the same buffer every time, as Shazam does
+    QByteArray written;
+    ShazamBody(uri, SHAZAM_BENCHMARK_SAMPLE_MS).writeJson(written);
+    if (QJsonDocument::fromJson(written) != ShazamBody(uri, SHAZAM_BENCHMARK_SAMPLE_MS).toJsonDocument()) {
+        benchmarkFailed("shazam_body_write", "the body differs from the QJsonDocument one");
+    }
+
+    runBenchmark("shazam_body_write", 0, [&] {
+        const ShazamBody body(uri, SHAZAM_BENCHMARK_SAMPLE_MS);
+        body.writeJson(written);
+        doNotOptimise(written.constData());
+    }, {
+        { "bytes", static_cast<double>(written.size()) },
+    });
+
+    // Representative responses, in the shape Shazam sends them
+    benchmarkParse("shazam_response_parse_found", ":/bench/data/shazam_response_found.json");
+    benchmarkParse("shazam_response_parse_not_found", ":/bench/data/shazam_response_not_found.json");
+    benchmarkStreamParse("shazam_response_stream_parse_found", ":/bench/data/shazam_response_found.json");
+    benchmarkStreamParse("shazam_response_stream_parse_not_found", ":/bench/data/shazam_response_not_found.json");
+
+    // Found, but without the match the offset comes from
+    benchmarkStreamParse("shazam_response_stream_parse_no_matches", ":/bench/data/shazam_response_found_no_matches.json");
+}
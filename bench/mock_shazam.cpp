@@ -0,0 +1,55 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+
+#include "mock_shazam_server.h"
+
+/*
+ * Runs a MockShazamServer until killed:
+ *
+ *   SongDetector_mock_shazam --stall-every 5 &
+ *   SONGDETECTOR_SHAZAM_URL=http://localhost:8080/ SongDetectorDaemon --source wav:song.wav
+ */
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Answers Shazam lookups locally, slowly on purpose.");
+    parser.addHelpOption();
+    parser.addOption({ "port", "Port to listen on (localhost only).", "port", "8080" });
+    parser.addOption({ "delay-ms", "How long a lookup takes.", "ms", "100" });
+    parser.addOption({ "stall-ms", "How long a stalled lookup takes.", "ms", "4000" });
+    parser.addOption({ "stall-every", "Stall every nth lookup, 0 never stalls.", "n", "10" });
+    parser.addOption({ "response", "Shazam response to answer with.", "path", ":/bench/data/shazam_response_found.json" });
+    parser.process(app);
+
+    bool portValid = false;
+    bool delayValid = false;
+    bool stallValid = false;
+    bool stallEveryValid = false;
+    const quint16 port = parser.value("port").toUShort(&portValid);
+    const int delayMs = parser.value("delay-ms").toInt(&delayValid);
+    const int stallMs = parser.value("stall-ms").toInt(&stallValid);
+    const int stallEvery = parser.value("stall-every").toInt(&stallEveryValid);
+
+    if (!portValid || !delayValid || !stallValid || !stallEveryValid || delayMs < 0 || stallMs < 0 || stallEvery < 0) {
+        qWarning() << "Invalid option, see --help";
+        return 1;
+    }
+
+    QFile file(parser.value("response"));
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to open" << file.fileName();
+        return 1;
+    }
+
+    MockShazamServer server(file.readAll(), &app);
+    server.setDelays(delayMs, stallMs, stallEvery);
+    if (!server.listen(port)) {
+        return 1;
+    }
+
+    qInfo().noquote() << QStringLiteral("Mock Shazam on http://localhost:%1/").arg(server.getPort());
+    return app.exec();
+}
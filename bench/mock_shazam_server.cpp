@@ -0,0 +1,94 @@
+#include <QDebug>
+#include <QHostAddress>
+#include <QTcpSocket>
+#include <QTimer>
+
+#include "mock_shazam_server.h"
+
+static qint64 contentLength(const QByteArray& headers) {
+    for (const QByteArray& line : headers.split('\n')) {
+        if (line.trimmed().toLower().startsWith("content-length:")) {
+            return line.mid(line.indexOf(':') + 1).trimmed().toLongLong();
+        }
+    }
+
+    return 0;
+}
+
+MockShazamServer::MockShazamServer(const QByteArray& response, QObject* parent) :
+    QObject(parent),
+    m_server(this) {
+        m_response = "HTTP/1.1 200 OK\r\n"
+            "Content-Type: application/json\r\n"
+            "Content-Length: " + QByteArray::number(response.size()) + "\r\n"
+            "Connection: close\r\n"
+            "\r\n" + response;
+
+        connect(&m_server, &QTcpServer::newConnection, this, &MockShazamServer::onNewConnection);
+}
+
+void MockShazamServer::setDelays(int delayMs, int stallMs, int stallEvery) {
+    m_delayMs = delayMs;
+    m_stallMs = stallMs;
+    m_stallEvery = stallEvery;
+}
+
+bool MockShazamServer::listen(quint16 port) {
+    if (!m_server.listen(QHostAddress::LocalHost, port)) {
+        qWarning() << "Failed to listen on port" << port << m_server.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+quint16 MockShazamServer::getPort() const {
+    return m_server.serverPort();
+}
+
+quint64 MockShazamServer::getLookups() const {
+    return m_lookups;
+}
+
+quint64 MockShazamServer::getStalls() const {
+    return m_stalls;
+}
+
+/*
+ * Slots
+ */
+void MockShazamServer::onNewConnection() {
+    while (auto* client = m_server.nextPendingConnection()) {
+        connect(client, &QTcpSocket::disconnected, client, &QObject::deleteLater);
+
+        connect(client, &QTcpSocket::readyRead, this, [this, client] {
+            // Wait for the whole request, headers and body
+            const QByteArray request = client->peek(MOCK_SHAZAM_MAX_REQUEST_SIZE);
+            const qsizetype headersEnd = request.indexOf("\r\n\r\n");
+
+            if (headersEnd < 0 || request.size() < headersEnd + 4 + contentLength(request.left(headersEnd))) {
+                if (client->bytesAvailable() >= MOCK_SHAZAM_MAX_REQUEST_SIZE) {
+                    client->abort();
+                }
+                return;
+            }
+
+            client->readAll();
+
+            m_lookups++;
+            const bool stall = m_stallEvery > 0 && m_lookups % m_stallEvery == 0;
+            if (stall) {
+                m_stalls++;
+            }
+
+            const int delayMs = stall ? m_stallMs : m_delayMs;
+            qInfo() << "Lookup" << m_lookups << (stall ? "stalls" : "answers") << "after" << delayMs << "ms";
+
+            // Dropped with the connection when the client gives up on it
+            QTimer::singleShot(delayMs, client, [this, client] {
+                client->write(m_response);
+                client->disconnectFromHost();
+            });
+        });
+    }
+}
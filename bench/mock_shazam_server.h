@@ -0,0 +1,53 @@
+#pragma once
+
+#include <QByteArray>
+#include <QObject>
+#include <QTcpServer>
+
+// A client that sends this much without finishing its request is dropped
+#define MOCK_SHAZAM_MAX_REQUEST_SIZE (1024 * 1024)
+
+/*
+ * Stands in for Shazam so lookups, and hedging in particular, can be tried
+ * out locally. Every lookup is answered with the same response after a
+ * delay, and every so often one stalls for much longer.
+ *
+ * Hedges are lookups like any other, so one sent for a stalled lookup is
+ * answered after the usual delay (unless it happens to stall too). Only
+ * listens on localhost.
+ */
+class MockShazamServer : public QObject {
+    Q_OBJECT
+
+    public:
+        MockShazamServer(const QByteArray& response, QObject* parent);
+
+        /*
+         * Every lookup is answered after `delayMs`, except every
+         * `stallEvery`th one (0 for none), which takes `stallMs`
+         */
+        void        setDelays(int delayMs, int stallMs, int stallEvery);
+
+        /*
+         * 0 picks a free port
+         */
+        bool        listen(quint16 port);
+
+        quint16     getPort() const;
+        quint64     getLookups() const;
+        quint64     getStalls() const;
+
+    private slots:
+        void        onNewConnection();
+
+    private:
+        QTcpServer  m_server;
+        QByteArray  m_response;
+
+        int         m_delayMs = 100;
+        int         m_stallMs = 4000;
+        int         m_stallEvery = 10;
+
+        quint64     m_lookups = 0;
+        quint64     m_stalls = 0;
+};
@@ -0,0 +1,17 @@
+#pragma once
+
+/*
+ * Describes a block of interleaved PCM audio
+ */
+struct AudioFormat {
+    int sampleRate = 44100;
+    int bitsPerSample = 32;
+    int channels = 1;
+
+    // True for IEEE float samples, otherwise signed integers
+    bool floatingPoint = false;
+
+    int bytesPerFrame() const {
+        return channels * bitsPerSample / 8;
+    }
+};
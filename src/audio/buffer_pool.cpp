@@ -0,0 +1,53 @@
+#include <utility>
+
+#include "buffer_pool.h"
+
+AudioBufferPool::AudioBufferPool() {
+    m_buffers.reserve(AUDIO_BUFFER_POOL_SIZE);
+}
+
+QByteArray AudioBufferPool::acquire(qsizetype capacity) {
+    // The largest buffer that is no longer in use, so a longer capture
+    // doesn't make every buffer grow in turn
+    auto best = m_buffers.end();
+
+    for (auto it = m_buffers.begin(); it != m_buffers.end(); ++it) {
+        if (it->isDetached() && (best == m_buffers.end() || it->capacity() > best->capacity())) {
+            best = it;
+        }
+    }
+
+    QByteArray buffer;
+    if (best != m_buffers.end()) {
+        buffer = std::move(*best);
+        m_buffers.erase(best);
+
+        // Shrinking keeps the allocation
+        buffer.resize(0);
+    }
+
+    if (buffer.capacity() < capacity) {
+        buffer.reserve(capacity);
+        m_allocations++;
+    }
+
+    return buffer;
+}
+
+void AudioBufferPool::recycle(QByteArray&& buffer) {
+    if (buffer.capacity() == 0) {
+        return;
+    }
+
+    if (m_buffers.size() < AUDIO_BUFFER_POOL_SIZE) {
+        m_buffers.push_back(std::move(buffer));
+        return;
+    }
+
+    // Full, the buffer is freed once its last copy goes
+    buffer = QByteArray();
+}
+
+quint64 AudioBufferPool::getAllocations() const {
+    return m_allocations;
+}
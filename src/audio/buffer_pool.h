@@ -0,0 +1,48 @@
+#pragma once
+
+#include <QByteArray>
+#include <vector>
+
+// Buffers kept for reuse. One is normally enough, the rest cover a
+// capture that is still being fingerprinted when the next one starts.
+#define AUDIO_BUFFER_POOL_SIZE 4
+
+/*
+ * Recycles the buffers captures are handed out in, so that steady state
+ * identifications don't allocate.
+ *
+ * A capture is written into a buffer from acquire() and passed on as a
+ * shallow, reference counted QByteArray copy, through fingerprinting and
+ * whatever else holds on to it, then given back with recycle(). Once every
+ * copy has been dropped, on whichever thread, the pool's own reference is
+ * the only one left and the buffer goes to the next acquire() with its
+ * allocation intact. Nothing is ever written while another copy exists,
+ * so nothing is ever copied on write.
+ *
+ * Only the thread that owns the pool may call it.
+ */
+class AudioBufferPool {
+    public:
+        AudioBufferPool();
+
+        /*
+         * An empty buffer with room for at least `capacity` bytes, which
+         * nobody else holds
+         */
+        QByteArray  acquire(qsizetype capacity);
+
+        /*
+         * Gives a buffer back, it is reused once every copy of it is gone
+         */
+        void        recycle(QByteArray&& buffer);
+
+        /*
+         * Number of times acquire() had to allocate, which stops going up
+         * once the pool has warmed up
+         */
+        quint64     getAllocations() const;
+
+    private:
+        std::vector<QByteArray> m_buffers;
+        quint64                 m_allocations = 0;
+};
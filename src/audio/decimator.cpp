@@ -0,0 +1,214 @@
+#include <QtEndian>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numbers>
+#include <numeric>
+
+#include "decimator.h"
+
+// Number of zero crossings of the sinc on either side of the centre, at
+// the lower of the two rates. More gives a sharper filter.
+#define FILTER_HALF_WIDTH 16
+
+// Cutoff as a fraction of the lower Nyquist frequency. The fingerprinters
+// ignore everything above 5.5kHz, so this leaves plenty of margin.
+#define FILTER_CUTOFF 0.9
+
+static int16_t toInt16(float value) {
+    return static_cast<int16_t>(std::clamp(std::lround(value * 32767.0f), -32768L, 32767L));
+}
+
+AudioDecimator::AudioDecimator() {
+}
+
+void AudioDecimator::configure(const AudioFormat& inputFormat) {
+    if (m_configured &&
+        inputFormat.sampleRate == m_inputFormat.sampleRate &&
+        inputFormat.channels == m_inputFormat.channels &&
+        inputFormat.bitsPerSample == m_inputFormat.bitsPerSample &&
+        inputFormat.floatingPoint == m_inputFormat.floatingPoint) {
+        return;
+    }
+
+    m_inputFormat = inputFormat;
+    m_configured = true;
+
+    const int divisor = std::gcd(inputFormat.sampleRate, DECIMATED_SAMPLE_RATE);
+    m_upFactor = DECIMATED_SAMPLE_RATE / divisor;
+    m_downFactor = inputFormat.sampleRate / divisor;
+
+    const AudioFormat output = outputFormat();
+    m_passThrough =
+        inputFormat.sampleRate == output.sampleRate &&
+        inputFormat.channels == output.channels &&
+        inputFormat.bitsPerSample == output.bitsPerSample &&
+        !inputFormat.floatingPoint;
+
+    designFilter();
+    reset();
+}
+
+void AudioDecimator::reset() {
+    m_history.assign(std::max(m_tapsPerPhase - 1, 0), 0.0f);
+    m_position = static_cast<int64_t>(m_history.size()) * m_upFactor;
+}
+
+qsizetype AudioDecimator::process(const char* data, qsizetype size, int16_t* output) {
+    const int bytesPerSample = m_inputFormat.bitsPerSample / 8;
+    const int bytesPerFrame = m_inputFormat.bytesPerFrame();
+    const qsizetype frames = size / bytesPerFrame;
+
+    if (m_passThrough) {
+        memcpy(output, data, frames * sizeof(int16_t));
+        return frames;
+    }
+
+    // Downmix onto the end of the history
+    const size_t historySize = m_history.size();
+    m_history.resize(historySize + frames);
+    float* mono = m_history.data() + historySize;
+    const float channelScale = 1.0f / m_inputFormat.channels;
+
+    for (qsizetype frame = 0; frame < frames; frame++) {
+        const char* frameData = data + frame * bytesPerFrame;
+        float sample = 0.0f;
+        for (int channel = 0; channel < m_inputFormat.channels; channel++) {
+            sample += readSample(frameData + channel * bytesPerSample);
+        }
+        mono[frame] = sample * channelScale;
+    }
+
+    // Filter and resample. Output n is at input time n * down / up, which
+    // lands on phase (n * down) % up of the polyphase filter.
+    const int64_t available = static_cast<int64_t>(m_history.size());
+    qsizetype written = 0;
+
+    while (true) {
+        const int64_t newest = m_position / m_upFactor;
+        if (newest >= available) {
+            break;
+        }
+
+        const int phase = static_cast<int>(m_position % m_upFactor);
+        const float* coefficients = m_coefficients.data() + static_cast<size_t>(phase) * m_tapsPerPhase;
+        const float* samples = m_history.data() + newest - (m_tapsPerPhase - 1);
+
+        float sum = 0.0f;
+        for (int tap = 0; tap < m_tapsPerPhase; tap++) {
+            sum += coefficients[tap] * samples[tap];
+        }
+
+        output[written++] = toInt16(sum);
+        m_position += m_downFactor;
+    }
+
+    // Keep just enough history for the next call
+    const int64_t keep = m_tapsPerPhase - 1;
+    const int64_t drop = available - keep;
+    if (drop > 0) {
+        m_history.erase(m_history.begin(), m_history.begin() + drop);
+        m_position -= drop * m_upFactor;
+    }
+
+    return written;
+}
+
+qsizetype AudioDecimator::getMaxOutputSamples(qsizetype inputBytes) const {
+    const qsizetype frames = inputBytes / m_inputFormat.bytesPerFrame();
+
+    if (m_passThrough) {
+        return frames;
+    }
+
+    return frames * m_upFactor / m_downFactor + 2;
+}
+
+bool AudioDecimator::isConfigured() const {
+    return m_configured;
+}
+
+bool AudioDecimator::isPassThrough() const {
+    return m_passThrough;
+}
+
+AudioFormat AudioDecimator::outputFormat() {
+    AudioFormat format;
+    format.sampleRate = DECIMATED_SAMPLE_RATE;
+    format.bitsPerSample = 16;
+    format.channels = 1;
+    format.floatingPoint = false;
+    return format;
+}
+
+/*******************************************************
+ * Private methods
+ *******************************************************/
+
+float AudioDecimator::readSample(const char* data) const {
+    if (m_inputFormat.floatingPoint) {
+        float value;
+        memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    switch (m_inputFormat.bitsPerSample) {
+        case 16:
+            return qFromLittleEndian<int16_t>(data) / 32768.0f;
+        case 24: {
+            // Sign extend by building the top three bytes of an int32
+            const auto bytes = reinterpret_cast<const uint8_t*>(data);
+            const auto value = static_cast<int32_t>((uint32_t(bytes[2]) << 24) | (uint32_t(bytes[1]) << 16) | (uint32_t(bytes[0]) << 8));
+            return value / 2147483648.0f;
+        }
+        case 32:
+            return qFromLittleEndian<int32_t>(data) / 2147483648.0f;
+        default:
+            return 0.0f;
+    }
+}
+
+void AudioDecimator::designFilter() {
+    if (m_passThrough) {
+        m_tapsPerPhase = 1;
+        m_coefficients.assign(1, 1.0f);
+        return;
+    }
+
+    // Prototype filter runs at the upsampled rate, with its cutoff at
+    // the lower of the two Nyquist frequencies
+    const double ratio = std::max(1.0, static_cast<double>(m_downFactor) / m_upFactor);
+    m_tapsPerPhase = static_cast<int>(std::ceil(2 * FILTER_HALF_WIDTH * ratio));
+
+    const int length = m_tapsPerPhase * m_upFactor;
+    const double cutoff = FILTER_CUTOFF * 0.5 / std::max(m_upFactor, m_downFactor);
+    const double centre = (length - 1) / 2.0;
+
+    std::vector<double> prototype(length);
+    for (int i = 0; i < length; i++) {
+        const double x = i - centre;
+        const double sinc = x == 0.0 ?
+            2.0 * cutoff :
+            std::sin(2.0 * std::numbers::pi * cutoff * x) / (std::numbers::pi * x);
+
+        // Blackman window
+        const double window =
+            0.42 -
+            0.5 * std::cos(2.0 * std::numbers::pi * i / (length - 1)) +
+            0.08 * std::cos(4.0 * std::numbers::pi * i / (length - 1));
+
+        // Upsampling by m_upFactor spreads the signal energy, so
+        // scale the gain back up
+        prototype[i] = sinc * window * m_upFactor;
+    }
+
+    // Split into phases, reversed so that coefficient k multiplies
+    // the k-th oldest of the samples under the filter
+    m_coefficients.assign(static_cast<size_t>(length), 0.0f);
+    for (int phase = 0; phase < m_upFactor; phase++) {
+        float* coefficients = m_coefficients.data() + static_cast<size_t>(phase) * m_tapsPerPhase;
+        for (int tap = 0; tap < m_tapsPerPhase; tap++) {
+            coefficients[m_tapsPerPhase - 1 - tap] = static_cast<float>(prototype[phase + tap * m_upFactor]);
+        }
+    }
+}
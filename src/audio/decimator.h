@@ -0,0 +1,81 @@
+#pragma once
+
+#include <QtGlobal>
+#include <cstdint>
+#include <vector>
+
+#include "audio_format.h"
+
+// Rate the fingerprinters work at, there is no point keeping more
+#define DECIMATED_SAMPLE_RATE 16000
+
+/*
+ * Converts interleaved PCM audio into 16kHz mono signed 16-bit samples.
+ *
+ * The audio is downmixed, low-pass filtered and resampled in a single pass
+ * with a polyphase windowed-sinc filter, which works for any rational
+ * ratio (e.g. 48000 -> 16000 is 1/3, 44100 -> 16000 is 160/441). The
+ * filter history is kept between calls so audio can be converted chunk by
+ * chunk as it arrives.
+ */
+class AudioDecimator {
+    public:
+        AudioDecimator();
+
+        /*
+         * Sets the input format and designs the filter. Does nothing if
+         * the format hasn't changed.
+         */
+        void        configure(const AudioFormat& inputFormat);
+
+        /*
+         * Forgets the filter history, keeps the configuration
+         */
+        void        reset();
+
+        /*
+         * Converts `size` bytes of input into `output`, which must have
+         * room for getMaxOutputSamples(size) samples. Returns the number
+         * of samples written.
+         */
+        qsizetype   process(const char* data, qsizetype size, int16_t* output);
+
+        qsizetype   getMaxOutputSamples(qsizetype inputBytes) const;
+        bool        isConfigured() const;
+
+        /*
+         * True when the input is already 16kHz mono 16-bit, in which case
+         * process() is a plain copy
+         */
+        bool        isPassThrough() const;
+
+        /*
+         * Format of the converted audio
+         */
+        static AudioFormat  outputFormat();
+
+    private:
+        float       readSample(const char* data) const;
+        void        designFilter();
+
+        AudioFormat         m_inputFormat;
+        bool                m_configured = false;
+        bool                m_passThrough = false;
+
+        // Resampling ratio is m_upFactor / m_downFactor
+        int                 m_upFactor = 1;
+        int                 m_downFactor = 1;
+        int                 m_tapsPerPhase = 0;
+
+        // One set of m_tapsPerPhase coefficients per phase, stored back
+        // to back and reversed so each output is a straight dot product
+        std::vector<float>  m_coefficients;
+
+        // Downmixed input, starting with the last m_tapsPerPhase - 1
+        // samples of the previous call
+        std::vector<float>  m_history;
+
+        // Position of the next output sample, in upsampled units
+        // relative to the start of m_history
+        int64_t             m_position = 0;
+};
@@ -0,0 +1,327 @@
+#include <QDebug>
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+#include "decimator.h"
+#include "fingerprint/fft_plan.h"
+#include "novelty_detector.h"
+
+// A frame quieter than this (RMS, dBFS) is left out, same as SilenceGate
+#define NOVELTY_MIN_LEVEL_DB -55.0
+
+// Chroma is taken from where the fundamentals and first few harmonics
+// are, the spectral shape from most of the decimated band
+#define NOVELTY_CHROMA_MIN_FREQUENCY 100.0
+#define NOVELTY_CHROMA_MAX_FREQUENCY 4000.0
+#define NOVELTY_BAND_MIN_FREQUENCY 100.0
+#define NOVELTY_BAND_MAX_FREQUENCY 7000.0
+
+// A band this many dB louder or quieter, relative to the others, is as
+// different as two spectra get
+#define NOVELTY_BAND_RANGE_DB 10.0
+
+NoveltyDetector::NoveltyDetector() :
+    m_frame(NOVELTY_FRAME_SIZE),
+    m_window(NOVELTY_FRAME_SIZE),
+    m_windowed(NOVELTY_FRAME_SIZE),
+    m_spectrum(NOVELTY_FRAME_SIZE / 2 + 1),
+    m_scratch(NOVELTY_FRAME_SIZE / 2),
+    m_binChroma(NOVELTY_FRAME_SIZE / 2 + 1, -1),
+    m_binBand(NOVELTY_FRAME_SIZE / 2 + 1, -1) {
+        for (size_t i = 0; i < m_window.size(); i++) {
+            m_window[i] = static_cast<float>(0.5 - 0.5 * std::cos(2 * std::numbers::pi * i / (NOVELTY_FRAME_SIZE - 1)));
+        }
+
+        // Which pitch class (C = 0) and band each FFT bin counts towards
+        const double binWidth = static_cast<double>(DECIMATED_SAMPLE_RATE) / NOVELTY_FRAME_SIZE;
+        const double bandRatio = std::log(NOVELTY_BAND_MAX_FREQUENCY / NOVELTY_BAND_MIN_FREQUENCY) / NOVELTY_BANDS;
+
+        for (size_t bin = 1; bin < m_binChroma.size(); bin++) {
+            const double frequency = bin * binWidth;
+
+            if (frequency >= NOVELTY_CHROMA_MIN_FREQUENCY && frequency < NOVELTY_CHROMA_MAX_FREQUENCY) {
+                const auto semitone = static_cast<int>(std::lround(12 * std::log2(frequency / 440.0))) + 9;
+                m_binChroma[bin] = (semitone % NOVELTY_CHROMA_BINS + NOVELTY_CHROMA_BINS) % NOVELTY_CHROMA_BINS;
+            }
+
+            if (frequency >= NOVELTY_BAND_MIN_FREQUENCY && frequency < NOVELTY_BAND_MAX_FREQUENCY) {
+                const auto band = static_cast<int>(std::log(frequency / NOVELTY_BAND_MIN_FREQUENCY) / bandRatio);
+                m_binBand[bin] = std::min(band, NOVELTY_BANDS - 1);
+            }
+        }
+}
+
+bool NoveltyDetector::process(const int16_t* samples, qsizetype count) {
+    bool settled = false;
+
+    while (count > 0) {
+        const qsizetype size = std::min(count, NOVELTY_FRAME_SIZE - m_frameFill);
+        for (qsizetype i = 0; i < size; i++) {
+            m_frame[m_frameFill + i] = samples[i] / 32768.0f;
+        }
+
+        m_frameFill += size;
+        samples += size;
+        count -= size;
+
+        if (m_frameFill < NOVELTY_FRAME_SIZE) {
+            break;
+        }
+
+        m_frameFill = 0;
+        processFrame();
+
+        if (++m_currentFrames == NOVELTY_FRAMES_PER_BLOCK) {
+            settled = processBlock() || settled;
+        }
+    }
+
+    return settled;
+}
+
+void NoveltyDetector::reset() {
+    m_frameFill = 0;
+    m_current = {};
+    m_currentFrames = 0;
+    m_history.clear();
+    m_blocks = 0;
+    m_silentBlocks = 0;
+    m_track = {};
+    m_novelty = 0;
+    m_peakNovelty = 0;
+    m_peakBlock = -1;
+    m_lastChange = -1;
+    m_changePending = false;
+}
+
+void NoveltyDetector::setSettleSeconds(int seconds) {
+    m_settleBlocks = blocksIn(seconds);
+}
+
+double NoveltyDetector::getNovelty() const {
+    return m_novelty;
+}
+
+/*******************************************************
+ * Private methods
+ *******************************************************/
+
+void NoveltyDetector::processFrame() {
+    double energy = 0;
+    for (const float sample : m_frame) {
+        energy += static_cast<double>(sample) * sample;
+    }
+
+    const double rms = std::sqrt(energy / NOVELTY_FRAME_SIZE);
+    if (rms <= 0 || 20 * std::log10(rms) < NOVELTY_MIN_LEVEL_DB) {
+        return;
+    }
+
+    for (size_t i = 0; i < m_frame.size(); i++) {
+        m_windowed[i] = m_frame[i] * m_window[i];
+    }
+
+    RealFftPlan::forSize(NOVELTY_FRAME_SIZE).forward(m_windowed.data(), m_spectrum.data(), m_scratch.data());
+
+    std::array<double, NOVELTY_CHROMA_BINS> chroma{};
+    std::array<double, NOVELTY_BANDS> bands{};
+
+    for (size_t bin = 1; bin < m_spectrum.size(); bin++) {
+        const double power = std::norm(m_spectrum[bin]);
+
+        if (m_binChroma[bin] >= 0) {
+            chroma[m_binChroma[bin]] += std::sqrt(power);
+        }
+
+        if (m_binBand[bin] >= 0) {
+            bands[m_binBand[bin]] += power;
+        }
+    }
+
+    // Both are made independent of the level, so turning the volume up
+    // (or a fade out) isn't a change of track
+    double chromaSum = 0;
+    for (const double value : chroma) {
+        chromaSum += value;
+    }
+
+    double bandMean = 0;
+    for (double& value : bands) {
+        value = 10 * std::log10(value + 1e-12);
+        bandMean += value / NOVELTY_BANDS;
+    }
+
+    for (int i = 0; i < NOVELTY_CHROMA_BINS; i++) {
+        m_current.chroma[i] += chromaSum > 0 ? chroma[i] / chromaSum : 0;
+    }
+
+    for (int i = 0; i < NOVELTY_BANDS; i++) {
+        m_current.bands[i] += bands[i] - bandMean;
+    }
+
+    m_current.frames++;
+}
+
+bool NoveltyDetector::processBlock() {
+    Block block;
+    block.features = m_current;
+    block.silent = m_current.frames < NOVELTY_FRAMES_PER_BLOCK / 2;
+
+    m_current = {};
+    m_currentFrames = 0;
+
+    const qint64 index = m_blocks++;
+    m_history.push_back(block);
+
+    // Blocks that have gone by are only needed for what the track sounds like
+    if (m_history.size() > 2 * NOVELTY_WINDOW_BLOCKS) {
+        const qint64 oldest = index - static_cast<qint64>(m_history.size()) + 1;
+        if (oldest >= m_lastChange) {
+            const Features& features = m_history.front().features;
+            for (int i = 0; i < NOVELTY_CHROMA_BINS; i++) {
+                m_track.chroma[i] += features.chroma[i];
+            }
+            for (int i = 0; i < NOVELTY_BANDS; i++) {
+                m_track.bands[i] += features.bands[i];
+            }
+            m_track.frames += features.frames;
+        }
+
+        m_history.pop_front();
+    }
+
+    if (block.silent) {
+        m_silentBlocks++;
+    } else {
+        // The first music, or music after a gap that ends a track long
+        // enough to be one, is a new track
+        const qint64 trackBlocks = index - m_silentBlocks - m_lastChange;
+        if (m_lastChange < 0 || (m_silentBlocks >= NOVELTY_GAP_BLOCKS &&
+                                 trackBlocks >= blocksIn(NOVELTY_MIN_TRACK_SECONDS))) {
+            qDebug() << "Music after" << m_silentBlocks << "silent blocks, taking it as a new track";
+            markChange(index);
+        }
+
+        m_silentBlocks = 0;
+    }
+
+    if (m_lastChange >= 0 && index - m_lastChange >= blocksIn(NOVELTY_MAX_TRACK_SECONDS)) {
+        qDebug() << "No track change for" << NOVELTY_MAX_TRACK_SECONDS << "seconds, checking again";
+        markChange(index);
+    }
+
+    // Compare the windows either side of the block in the middle
+    if (m_history.size() == 2 * NOVELTY_WINDOW_BLOCKS) {
+        const qint64 candidate = index - NOVELTY_WINDOW_BLOCKS + 1;
+        const Features before = averageBlocks(0, NOVELTY_WINDOW_BLOCKS);
+        const Features after = averageBlocks(NOVELTY_WINDOW_BLOCKS, NOVELTY_WINDOW_BLOCKS);
+
+        m_novelty = before.frames > 0 && after.frames > 0 ? distance(before, after) : 0;
+
+        if (m_lastChange >= 0 && candidate - m_lastChange >= blocksIn(NOVELTY_MIN_TRACK_SECONDS)) {
+            if (m_novelty > NOVELTY_CHANGE_THRESHOLD && m_novelty > m_peakNovelty) {
+                m_peakNovelty = m_novelty;
+                m_peakBlock = candidate;
+            } else if (m_peakBlock >= 0) {
+                // Past the peak, so is the new audio unlike the last track?
+                const qint64 first = index - static_cast<qint64>(m_history.size()) + 1;
+                const Features newTrack = averageBlocks(static_cast<size_t>(m_peakBlock - first),
+                    static_cast<size_t>(index - m_peakBlock + 1));
+
+                Features lastTrack = m_track;
+                if (lastTrack.frames > 0) {
+                    for (double& value : lastTrack.chroma) {
+                        value /= lastTrack.frames;
+                    }
+                    for (double& value : lastTrack.bands) {
+                        value /= lastTrack.frames;
+                    }
+                }
+
+                const double difference = lastTrack.frames > 0 ? distance(lastTrack, newTrack) : 1.0;
+                if (difference > NOVELTY_TRACK_THRESHOLD) {
+                    qDebug() << "Track change, novelty" << m_peakNovelty << "difference" << difference;
+                    markChange(m_peakBlock);
+                } else {
+                    qDebug() << "Not a new track, novelty" << m_peakNovelty << "difference" << difference;
+                    m_peakNovelty = 0;
+                    m_peakBlock = -1;
+                }
+            }
+        }
+    }
+
+    if (m_changePending && m_blocks - m_lastChange >= m_settleBlocks) {
+        m_changePending = false;
+        return true;
+    }
+
+    return false;
+}
+
+void NoveltyDetector::markChange(qint64 block) {
+    m_lastChange = block;
+    m_changePending = true;
+    m_track = {};
+    m_peakNovelty = 0;
+    m_peakBlock = -1;
+}
+
+qint64 NoveltyDetector::blocksIn(int seconds) {
+    // Rounded up, so a settled capture never has any of the last track in it
+    const qint64 blockSamples = NOVELTY_FRAME_SIZE * NOVELTY_FRAMES_PER_BLOCK;
+    return (qint64(seconds) * DECIMATED_SAMPLE_RATE + blockSamples - 1) / blockSamples;
+}
+
+NoveltyDetector::Features NoveltyDetector::averageBlocks(size_t first, size_t count) const {
+    Features average;
+
+    for (size_t i = first; i < first + count && i < m_history.size(); i++) {
+        const Features& features = m_history[i].features;
+
+        for (int j = 0; j < NOVELTY_CHROMA_BINS; j++) {
+            average.chroma[j] += features.chroma[j];
+        }
+        for (int j = 0; j < NOVELTY_BANDS; j++) {
+            average.bands[j] += features.bands[j];
+        }
+        average.frames += features.frames;
+    }
+
+    if (average.frames > 0) {
+        for (double& value : average.chroma) {
+            value /= average.frames;
+        }
+        for (double& value : average.bands) {
+            value /= average.frames;
+        }
+    }
+
+    return average;
+}
+
+double NoveltyDetector::distance(const Features& a, const Features& b) {
+    // Cosine distance between the chroma, which rarely gets past 0.5 as
+    // every note has a few harmonics in other pitch classes
+    double dot = 0;
+    double normA = 0;
+    double normB = 0;
+
+    for (int i = 0; i < NOVELTY_CHROMA_BINS; i++) {
+        dot += a.chroma[i] * b.chroma[i];
+        normA += a.chroma[i] * a.chroma[i];
+        normB += b.chroma[i] * b.chroma[i];
+    }
+
+    const double chroma = normA > 0 && normB > 0 ? 1 - dot / std::sqrt(normA * normB) : 0;
+
+    // Mean difference in the shape of the spectrum
+    double bands = 0;
+    for (int i = 0; i < NOVELTY_BANDS; i++) {
+        bands += std::abs(a.bands[i] - b.bands[i]) / NOVELTY_BANDS;
+    }
+
+    return std::clamp(chroma + bands / NOVELTY_BAND_RANGE_DB, 0.0, 1.0);
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <QtGlobal>
+#include <array>
+#include <complex>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// Analysed in frames of this many samples of 16kHz audio (128ms), and
+// summarised into blocks of this many frames (about 1s)
+#define NOVELTY_FRAME_SIZE 2048
+#define NOVELTY_FRAMES_PER_BLOCK 8
+
+// Chroma (12 pitch classes) plus the shape of the spectrum in this many
+// bands, which is mostly down to the instruments
+#define NOVELTY_CHROMA_BINS 12
+#define NOVELTY_BANDS 8
+
+// The audio either side of a candidate change is compared over this many
+// blocks, long enough to average out chord changes and drum fills
+#define NOVELTY_WINDOW_BLOCKS 8
+
+// How different (0-1) the windows either side of a change have to be, and
+// how different the new track has to be from the one before it, so a
+// chorus coming back round isn't taken for a new track
+#define NOVELTY_CHANGE_THRESHOLD 0.35
+#define NOVELTY_TRACK_THRESHOLD 0.4
+
+// A run of silence at least this long (about 3s) between tracks is a change
+// on its own, shorter ones are breaks and quiet passages within a track
+#define NOVELTY_GAP_BLOCKS 3
+
+// No track is taken to be shorter than this. One that goes on for longer
+// than the maximum is looked up again, in case a change was missed.
+#define NOVELTY_MIN_TRACK_SECONDS 30
+#define NOVELTY_MAX_TRACK_SECONDS 300
+
+/*
+ * Notices when the track that is playing changes, so continuous capture
+ * only needs one lookup per song rather than polling.
+ *
+ * Every block of audio is summarised by its chroma (which notes are
+ * playing) and spectral shape (which instruments are playing them). A
+ * change is a peak in the difference between the windows before and
+ * after a block that also sets the new audio apart from the last track,
+ * or music starting after a gap. The start of the first music counts as
+ * a change too, so nothing is missed.
+ *
+ * Works on the decimated 16kHz mono audio, one 2048 point FFT per 128ms.
+ * Not thread safe.
+ */
+class NoveltyDetector {
+    public:
+        NoveltyDetector();
+
+        /*
+         * Feeds in more (16kHz mono 16-bit) audio. Returns true once a new
+         * track has been playing for the settle time, which happens once
+         * per change.
+         */
+        bool        process(const int16_t* samples, qsizetype count);
+
+        /*
+         * Forgets everything heard so far, the next music is a new track
+         */
+        void        reset();
+
+        /*
+         * How long a new track has to play before process() reports it,
+         * normally the length of a capture so that it is all the new track
+         */
+        void        setSettleSeconds(int seconds);
+
+        /*
+         * Difference (0-1) across the latest block that can be judged
+         */
+        double      getNovelty() const;
+
+    private:
+        struct Features {
+            std::array<double, NOVELTY_CHROMA_BINS> chroma{};
+            std::array<double, NOVELTY_BANDS>       bands{};
+            int                                     frames = 0;
+        };
+
+        struct Block {
+            Features    features;
+            bool        silent = true;
+        };
+
+        void            processFrame();
+        bool            processBlock();
+        void            markChange(qint64 block);
+        Features        averageBlocks(size_t first, size_t count) const;
+        static double   distance(const Features& a, const Features& b);
+        static qint64   blocksIn(int seconds);
+
+        std::vector<float>                  m_frame;
+        qsizetype                           m_frameFill = 0;
+
+        // FFT buffers and tables, set up once
+        std::vector<float>                  m_window;
+        std::vector<float>                  m_windowed;
+        std::vector<std::complex<float>>    m_spectrum;
+        std::vector<std::complex<float>>    m_scratch;
+        std::vector<int>                    m_binChroma;
+        std::vector<int>                    m_binBand;
+
+        // The block being summed up, and the blocks around the candidate
+        Features                            m_current;
+        int                                 m_currentFrames = 0;
+        std::deque<Block>                   m_history;
+        qint64                              m_blocks = 0;
+        int                                 m_silentBlocks = 0;
+
+        // Everything since the last change, what a new track is held up to
+        Features                            m_track;
+
+        // The strongest candidate so far, waiting for the novelty to peak
+        double                              m_novelty = 0;
+        double                              m_peakNovelty = 0;
+        qint64                              m_peakBlock = -1;
+
+        qint64                              m_lastChange = -1;
+        bool                                m_changePending = false;
+        qint64                              m_settleBlocks = 15;
+};
@@ -0,0 +1,79 @@
+#include <algorithm>
+#include <cstring>
+
+#include "ring_buffer.h"
+
+static size_t roundUpToPowerOfTwo(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+AudioRingBuffer::AudioRingBuffer(size_t capacity) :
+    m_capacity(roundUpToPowerOfTwo(capacity)),
+    m_mask(roundUpToPowerOfTwo(capacity) - 1) {
+        m_data.reset(new char[m_capacity]);
+}
+
+/*******************************************************
+ * Producer
+ *******************************************************/
+
+bool AudioRingBuffer::write(const char* data, size_t size) {
+    const size_t writeIndex = m_writeIndex.load(std::memory_order_relaxed);
+    const size_t readIndex = m_readIndex.load(std::memory_order_acquire);
+
+    if (size > m_capacity - (writeIndex - readIndex)) {
+        m_overruns.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Copy in at most two pieces, the second one only if we wrap around
+    const size_t offset = writeIndex & m_mask;
+    const size_t firstPart = std::min(size, m_capacity - offset);
+    memcpy(m_data.get() + offset, data, firstPart);
+    memcpy(m_data.get(), data + firstPart, size - firstPart);
+
+    m_writeIndex.store(writeIndex + size, std::memory_order_release);
+    return true;
+}
+
+/*******************************************************
+ * Consumer
+ *******************************************************/
+
+size_t AudioRingBuffer::read(char* data, size_t maxSize) {
+    const size_t readIndex = m_readIndex.load(std::memory_order_relaxed);
+    const size_t writeIndex = m_writeIndex.load(std::memory_order_acquire);
+
+    const size_t size = std::min(maxSize, writeIndex - readIndex);
+    const size_t offset = readIndex & m_mask;
+    const size_t firstPart = std::min(size, m_capacity - offset);
+    memcpy(data, m_data.get() + offset, firstPart);
+    memcpy(data + firstPart, m_data.get(), size - firstPart);
+
+    m_readIndex.store(readIndex + size, std::memory_order_release);
+    return size;
+}
+
+void AudioRingBuffer::discard() {
+    m_readIndex.store(m_writeIndex.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+/*******************************************************
+ * Getters
+ *******************************************************/
+
+size_t AudioRingBuffer::getCapacity() const {
+    return m_capacity;
+}
+
+size_t AudioRingBuffer::getAvailable() const {
+    return m_writeIndex.load(std::memory_order_acquire) - m_readIndex.load(std::memory_order_relaxed);
+}
+
+uint64_t AudioRingBuffer::getOverruns() const {
+    return m_overruns.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/*
+ * Fixed capacity, lock-free, single-producer/single-consumer byte ring buffer.
+ *
+ * The producer side (write) is safe to call from the PipeWire real-time
+ * thread: it never allocates, never locks and only performs a memcpy
+ * followed by an atomic publish of the write index. The consumer side
+ * (read/discard) must only ever be called from one (non real-time) thread.
+ */
+class AudioRingBuffer {
+    public:
+        /*
+         * Capacity is rounded up to the next power of two so that index
+         * wrapping is a simple mask.
+         */
+        explicit AudioRingBuffer(size_t capacity);
+
+        AudioRingBuffer(const AudioRingBuffer&) = delete;
+        AudioRingBuffer& operator=(const AudioRingBuffer&) = delete;
+
+        /*
+         * Producer API
+         */
+
+        /*
+         * Copies `size` bytes into the buffer. If there isn't enough free
+         * space nothing is written, the overrun counter is incremented and
+         * false is returned.
+         */
+        bool        write(const char* data, size_t size);
+
+        /*
+         * Consumer API
+         */
+
+        /*
+         * Copies up to `maxSize` bytes out of the buffer and returns the
+         * number of bytes actually read.
+         */
+        size_t      read(char* data, size_t maxSize);
+
+        /*
+         * Drops everything that has been written so far. Only the consumer
+         * may call this, so it is safe while the producer is still running.
+         */
+        void        discard();
+
+        /*
+         * Getters
+         */
+        size_t      getCapacity() const;
+        size_t      getAvailable() const;
+        uint64_t    getOverruns() const;
+
+    private:
+        std::unique_ptr<char[]> m_data;
+        const size_t            m_capacity;
+        const size_t            m_mask;
+
+        // Keep the producer and consumer indexes on separate cache lines
+        // so the two threads don't keep invalidating each other.
+        alignas(64) std::atomic<size_t>     m_writeIndex{0};
+        alignas(64) std::atomic<size_t>     m_readIndex{0};
+        alignas(64) std::atomic<uint64_t>   m_overruns{0};
+};
@@ -0,0 +1,79 @@
+#include <algorithm>
+#include <cstring>
+
+#include "rolling_window.h"
+
+RollingAudioWindow::RollingAudioWindow() {
+}
+
+void RollingAudioWindow::setCapacity(qsizetype capacity) {
+    if (capacity == m_data.size()) {
+        clear();
+        return;
+    }
+
+    // Swap with a fresh buffer so the old allocation is actually released
+    QByteArray(capacity, Qt::Uninitialized).swap(m_data);
+    clear();
+}
+
+void RollingAudioWindow::append(const char* data, qsizetype size) {
+    const qsizetype capacity = m_data.size();
+    if (capacity == 0 || size <= 0) {
+        return;
+    }
+
+    // Only the last `capacity` bytes can survive
+    if (size > capacity) {
+        data += size - capacity;
+        size = capacity;
+    }
+
+    // Copy up to the end of the window, then wrap around for the rest
+    const qsizetype firstPart = std::min(size, capacity - m_head);
+    memcpy(m_data.data() + m_head, data, firstPart);
+    memcpy(m_data.data(), data + firstPart, size - firstPart);
+
+    m_head = (m_head + size) % capacity;
+    m_size = std::min(m_size + size, capacity);
+}
+
+QByteArray RollingAudioWindow::snapshot(qsizetype maxSize) const {
+    QByteArray result;
+    snapshot(maxSize, result);
+    return result;
+}
+
+void RollingAudioWindow::snapshot(qsizetype maxSize, QByteArray& destination) const {
+    const qsizetype capacity = m_data.size();
+    const qsizetype size = std::min(maxSize, m_size);
+
+    destination.resize(size);
+    if (size == 0) {
+        return;
+    }
+
+    // Start `size` bytes behind the write head and copy up to the end of
+    // the window, then wrap around to the beginning for the remainder.
+    const qsizetype start = (m_head - size + capacity) % capacity;
+    const qsizetype firstPart = std::min(size, capacity - start);
+    memcpy(destination.data(), m_data.constData() + start, firstPart);
+    memcpy(destination.data() + firstPart, m_data.constData(), size - firstPart);
+}
+
+void RollingAudioWindow::clear() {
+    m_head = 0;
+    m_size = 0;
+}
+
+/*
+ * Getters
+ */
+
+qsizetype RollingAudioWindow::getCapacity() const {
+    return m_data.size();
+}
+
+qsizetype RollingAudioWindow::getSize() const {
+    return m_size;
+}
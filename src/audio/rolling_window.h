@@ -0,0 +1,51 @@
+#pragma once
+
+#include <QByteArray>
+
+/*
+ * Fixed size window over the most recently captured audio.
+ *
+ * Once full, new audio overwrites the oldest audio, so memory use never
+ * grows beyond the capacity chosen in setCapacity(). Not thread safe, it
+ * is only ever touched by the thread that drains the capture ring buffer.
+ * It holds audio after decimation, so 16kHz mono 16-bit.
+ */
+class RollingAudioWindow {
+    public:
+        RollingAudioWindow();
+
+        /*
+         * (Re)allocates the window. Any audio already in the window is lost.
+         */
+        void        setCapacity(qsizetype capacity);
+
+        /*
+         * Copies `size` bytes into the window, overwriting the oldest
+         * audio once it is full
+         */
+        void        append(const char* data, qsizetype size);
+
+        /*
+         * Returns (at most) the last `maxSize` bytes in chronological order
+         */
+        QByteArray  snapshot(qsizetype maxSize) const;
+
+        /*
+         * Same, into `destination`, which is only reallocated if it is
+         * too small or shared
+         */
+        void        snapshot(qsizetype maxSize, QByteArray& destination) const;
+
+        void        clear();
+
+        /*
+         * Getters
+         */
+        qsizetype   getCapacity() const;
+        qsizetype   getSize() const;
+
+    private:
+        QByteArray  m_data;
+        qsizetype   m_head = 0;     // Next byte to be written
+        qsizetype   m_size = 0;     // Number of valid bytes
+};
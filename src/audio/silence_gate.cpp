@@ -0,0 +1,172 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numbers>
+
+#include "decimator.h"
+#include "fingerprint/fft_plan.h"
+#include "silence_gate.h"
+
+// Flatness is only measured where music has most of its energy
+#define SILENCE_GATE_MIN_FREQUENCY 150.0
+#define SILENCE_GATE_MAX_FREQUENCY 5000.0
+
+// peakLevel() looks at one frame in this many
+#define SILENCE_GATE_PEAK_STRIDE 8
+
+SilenceGate::SilenceGate() :
+    m_frame(SILENCE_GATE_FRAME_SIZE),
+    m_window(SILENCE_GATE_FRAME_SIZE),
+    m_windowed(SILENCE_GATE_FRAME_SIZE),
+    m_spectrum(SILENCE_GATE_FRAME_SIZE / 2 + 1),
+    m_scratch(SILENCE_GATE_FRAME_SIZE / 2) {
+        for (size_t i = 0; i < m_window.size(); i++) {
+            m_window[i] = static_cast<float>(0.5 - 0.5 * std::cos(2 * std::numbers::pi * i / (SILENCE_GATE_FRAME_SIZE - 1)));
+        }
+}
+
+void SilenceGate::process(const int16_t* samples, qsizetype count) {
+    while (count > 0) {
+        const qsizetype size = std::min(count, SILENCE_GATE_FRAME_SIZE - m_frameFill);
+        for (qsizetype i = 0; i < size; i++) {
+            m_frame[m_frameFill + i] = samples[i] / 32768.0f;
+        }
+
+        m_frameFill += size;
+        samples += size;
+        count -= size;
+
+        if (m_frameFill < SILENCE_GATE_FRAME_SIZE) {
+            break;
+        }
+
+        m_frameFill = 0;
+
+        if (isMusic()) {
+            m_silentRun = 0;
+            m_musicRun++;
+            if (m_musicRun >= SILENCE_GATE_ATTACK_FRAMES) {
+                m_open = true;
+            }
+        } else {
+            m_musicRun = 0;
+            m_silentRun++;
+            if (m_silentRun >= SILENCE_GATE_HOLD_FRAMES) {
+                m_open = false;
+            }
+        }
+    }
+}
+
+void SilenceGate::reset() {
+    m_frameFill = 0;
+    m_open = false;
+    m_musicRun = 0;
+    m_silentRun = 0;
+}
+
+bool SilenceGate::isOpen() const {
+    return m_open;
+}
+
+double SilenceGate::getSilentSeconds() const {
+    return static_cast<double>(m_silentRun) * SILENCE_GATE_FRAME_SIZE / DECIMATED_SAMPLE_RATE;
+}
+
+double SilenceGate::measureActivity(const int16_t* samples, qsizetype count) {
+    SilenceGate gate;
+    qsizetype frames = 0;
+    qsizetype musicFrames = 0;
+
+    for (qsizetype offset = 0; offset + SILENCE_GATE_FRAME_SIZE <= count; offset += SILENCE_GATE_FRAME_SIZE) {
+        for (qsizetype i = 0; i < SILENCE_GATE_FRAME_SIZE; i++) {
+            gate.m_frame[i] = samples[offset + i] / 32768.0f;
+        }
+
+        frames++;
+        if (gate.isMusic()) {
+            musicFrames++;
+        }
+    }
+
+    return frames > 0 ? static_cast<double>(musicFrames) / frames : 0;
+}
+
+float SilenceGate::peakLevel(const char* data, qsizetype size, int bitsPerSample, int channels, bool floatingPoint) {
+    const qsizetype bytesPerSample = bitsPerSample / 8;
+    const qsizetype bytesPerFrame = bytesPerSample * channels;
+    if (bytesPerFrame == 0) {
+        return 0;
+    }
+
+    float peak = 0;
+
+    for (qsizetype offset = 0; offset + bytesPerSample <= size; offset += bytesPerFrame * SILENCE_GATE_PEAK_STRIDE) {
+        const char* sample = data + offset;
+        float value = 0;
+
+        if (floatingPoint) {
+            memcpy(&value, sample, sizeof(float));
+        } else if (bytesPerSample == 2) {
+            int16_t integer;
+            memcpy(&integer, sample, sizeof(integer));
+            value = integer / 32768.0f;
+        } else if (bytesPerSample == 3) {
+            const int32_t integer = (static_cast<uint8_t>(sample[0]) << 8 |
+                                     static_cast<uint8_t>(sample[1]) << 16 |
+                                     static_cast<uint8_t>(sample[2]) << 24);
+            value = integer / 2147483648.0f;
+        } else if (bytesPerSample == 4) {
+            int32_t integer;
+            memcpy(&integer, sample, sizeof(integer));
+            value = integer / 2147483648.0f;
+        }
+
+        peak = std::max(peak, std::abs(value));
+    }
+
+    return peak;
+}
+
+/*******************************************************
+ * Private methods
+ *******************************************************/
+
+bool SilenceGate::isMusic() const {
+    double energy = 0;
+    for (const float sample : m_frame) {
+        energy += static_cast<double>(sample) * sample;
+    }
+
+    const double rms = std::sqrt(energy / SILENCE_GATE_FRAME_SIZE);
+    if (rms <= 0 || 20 * std::log10(rms) < SILENCE_GATE_MIN_LEVEL_DB) {
+        return false;
+    }
+
+    for (size_t i = 0; i < m_frame.size(); i++) {
+        m_windowed[i] = m_frame[i] * m_window[i];
+    }
+
+    RealFftPlan::forSize(SILENCE_GATE_FRAME_SIZE).forward(m_windowed.data(), m_spectrum.data(), m_scratch.data());
+
+    // Spectral flatness, the geometric mean of the power spectrum over
+    // its arithmetic mean: close to 1 for noise, close to 0 for tones
+    const double binWidth = static_cast<double>(DECIMATED_SAMPLE_RATE) / SILENCE_GATE_FRAME_SIZE;
+    const auto firstBin = static_cast<size_t>(SILENCE_GATE_MIN_FREQUENCY / binWidth);
+    const auto lastBin = static_cast<size_t>(SILENCE_GATE_MAX_FREQUENCY / binWidth);
+
+    double logSum = 0;
+    double sum = 0;
+
+    for (size_t bin = firstBin; bin <= lastBin; bin++) {
+        // Floor keeps log() finite for empty bins
+        const double power = std::norm(m_spectrum[bin]) + 1e-12;
+        logSum += std::log(power);
+        sum += power;
+    }
+
+    const double bins = static_cast<double>(lastBin - firstBin + 1);
+    const double flatness = std::exp(logSum / bins) / (sum / bins);
+
+    return flatness < SILENCE_GATE_MAX_FLATNESS;
+}
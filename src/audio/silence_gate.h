@@ -0,0 +1,80 @@
+#pragma once
+
+#include <QtGlobal>
+#include <complex>
+#include <cstdint>
+#include <vector>
+
+// Analysed in frames of this many samples of 16kHz audio (32ms)
+#define SILENCE_GATE_FRAME_SIZE 512
+
+// A frame quieter than this (RMS, dBFS) is silence
+#define SILENCE_GATE_MIN_LEVEL_DB -55.0
+
+// A frame whose spectrum is flatter than this is noise (hiss, hum and
+// clicks included) rather than music. White noise comes out around 0.56.
+#define SILENCE_GATE_MAX_FLATNESS 0.5
+
+// Music frames in a row before the gate opens (about 100ms), and
+// silent ones before it closes again (about 2s, longer than most gaps
+// between tracks)
+#define SILENCE_GATE_ATTACK_FRAMES 3
+#define SILENCE_GATE_HOLD_FRAMES 63
+
+/*
+ * Decides whether there is any music in the captured audio, from the level
+ * (RMS) and spectral flatness of each frame, so paused or silent sinks
+ * don't cost fingerprinting or a Shazam lookup that is bound to fail.
+ *
+ * Works on the decimated 16kHz mono audio, so it adds one 512 point FFT
+ * per 32ms. Not thread safe.
+ */
+class SilenceGate {
+    public:
+        SilenceGate();
+
+        /*
+         * Feeds in more (16kHz mono 16-bit) audio
+         */
+        void        process(const int16_t* samples, qsizetype count);
+
+        void        reset();
+
+        /*
+         * True while music is playing
+         */
+        bool        isOpen() const;
+
+        /*
+         * Seconds since the last music frame, or since reset()
+         */
+        double      getSilentSeconds() const;
+
+        /*
+         * Fraction (0-1) of the frames in `samples` that are music
+         */
+        static double   measureActivity(const int16_t* samples, qsizetype count);
+
+        /*
+         * Peak level (0-1) of raw audio in any format the decimator
+         * accepts. Only every few frames are looked at, it is used to
+         * notice sound coming back while nothing is being decimated.
+         */
+        static float    peakLevel(const char* data, qsizetype size, int bitsPerSample, int channels, bool floatingPoint);
+
+    private:
+        bool        isMusic() const;
+
+        std::vector<float>                  m_frame;
+        qsizetype                           m_frameFill = 0;
+
+        // FFT buffers, allocated once
+        std::vector<float>                  m_window;
+        mutable std::vector<float>          m_windowed;
+        mutable std::vector<std::complex<float>> m_spectrum;
+        mutable std::vector<std::complex<float>> m_scratch;
+
+        bool                                m_open = false;
+        int                                 m_musicRun = 0;
+        qint64                              m_silentRun = 0;
+};
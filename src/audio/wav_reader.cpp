@@ -0,0 +1,169 @@
+#include <QtEndian>
+#include <algorithm>
+
+#include "wav_reader.h"
+
+#define WAVE_FORMAT_PCM         0x0001
+#define WAVE_FORMAT_IEEE_FLOAT  0x0003
+#define WAVE_FORMAT_EXTENSIBLE  0xfffe
+
+WavReader::WavReader() {
+}
+
+bool WavReader::open(const QString& path) {
+    close();
+
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return fail(m_file.errorString());
+    }
+
+    if (!readHeader()) {
+        m_file.close();
+        return false;
+    }
+
+    return true;
+}
+
+void WavReader::close() {
+    m_file.close();
+    m_errorString.clear();
+    m_dataOffset = 0;
+    m_dataSize = 0;
+    m_position = 0;
+}
+
+qsizetype WavReader::read(char* data, qsizetype maxSize) {
+    const int bytesPerFrame = m_format.bytesPerFrame();
+    const qint64 remaining = m_dataSize - m_position;
+    const qsizetype size = static_cast<qsizetype>(std::min<qint64>(remaining, maxSize)) / bytesPerFrame * bytesPerFrame;
+
+    if (size <= 0) {
+        return 0;
+    }
+
+    const qint64 read = m_file.read(data, size);
+    if (read < 0) {
+        fail(m_file.errorString());
+        return -1;
+    }
+
+    // A truncated file just ends early, drop any partial frame
+    const qsizetype frames = static_cast<qsizetype>(read) / bytesPerFrame;
+    m_position += frames * bytesPerFrame;
+    if (read < size) {
+        m_dataSize = m_position;
+    }
+
+    return frames * bytesPerFrame;
+}
+
+bool WavReader::seek(qint64 frame) {
+    const qint64 position = std::clamp<qint64>(frame * m_format.bytesPerFrame(), 0, m_dataSize);
+    if (!m_file.seek(m_dataOffset + position)) {
+        return fail(m_file.errorString());
+    }
+
+    m_position = position;
+    return true;
+}
+
+/*
+ * Getters
+ */
+
+AudioFormat WavReader::getFormat() const {
+    return m_format;
+}
+
+qint64 WavReader::getFrameCount() const {
+    return m_dataSize / m_format.bytesPerFrame();
+}
+
+QString WavReader::getErrorString() const {
+    return m_errorString;
+}
+
+/*******************************************************
+ * Private methods
+ *******************************************************/
+
+bool WavReader::readHeader() {
+    const QByteArray riff = m_file.read(12);
+    if (riff.size() < 12 || !riff.startsWith("RIFF") || riff.mid(8, 4) != "WAVE") {
+        return fail(QStringLiteral("Not a WAV file"));
+    }
+
+    bool haveFormat = false;
+
+    while (true) {
+        const QByteArray chunkHeader = m_file.read(8);
+        if (chunkHeader.size() < 8) {
+            return fail(QStringLiteral("No audio data"));
+        }
+
+        const QByteArray id = chunkHeader.left(4);
+        const qint64 size = qFromLittleEndian<quint32>(chunkHeader.constData() + 4);
+
+        if (id == "fmt ") {
+            const QByteArray format = m_file.read(size);
+            if (format.size() < 16) {
+                return fail(QStringLiteral("Invalid format chunk"));
+            }
+
+            const char* fields = format.constData();
+            quint16 tag = qFromLittleEndian<quint16>(fields);
+            m_format.channels = qFromLittleEndian<quint16>(fields + 2);
+            m_format.sampleRate = static_cast<int>(qFromLittleEndian<quint32>(fields + 4));
+            m_format.bitsPerSample = qFromLittleEndian<quint16>(fields + 14);
+
+            // The real format tag is the start of the sub-format GUID
+            if (tag == WAVE_FORMAT_EXTENSIBLE && format.size() >= 26) {
+                tag = qFromLittleEndian<quint16>(fields + 24);
+            }
+
+            m_format.floatingPoint = tag == WAVE_FORMAT_IEEE_FLOAT;
+
+            const bool supported =
+                m_format.channels > 0 &&
+                m_format.sampleRate > 0 &&
+                ((tag == WAVE_FORMAT_PCM && (m_format.bitsPerSample == 16 || m_format.bitsPerSample == 24 || m_format.bitsPerSample == 32)) ||
+                 (tag == WAVE_FORMAT_IEEE_FLOAT && m_format.bitsPerSample == 32));
+
+            if (!supported) {
+                return fail(QStringLiteral("Unsupported WAV format %1, %2 bits").arg(tag).arg(m_format.bitsPerSample));
+            }
+
+            haveFormat = true;
+        } else if (id == "data") {
+            if (!haveFormat) {
+                return fail(QStringLiteral("Audio data before the format chunk"));
+            }
+
+            m_dataOffset = m_file.pos();
+
+            // Recorders that were cut off never fill in the size, so
+            // trust the file size over it
+            m_dataSize = std::min(size, m_file.size() - m_dataOffset);
+            if (size == 0 || size == 0xffffffff) {
+                m_dataSize = m_file.size() - m_dataOffset;
+            }
+
+            m_position = 0;
+            return true;
+        } else if (!m_file.seek(m_file.pos() + size)) {
+            return fail(QStringLiteral("Truncated WAV file"));
+        }
+
+        // Chunks are padded to an even size
+        if (size % 2 != 0) {
+            m_file.skip(1);
+        }
+    }
+}
+
+bool WavReader::fail(const QString& error) {
+    m_errorString = error;
+    return false;
+}
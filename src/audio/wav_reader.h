@@ -0,0 +1,56 @@
+#pragma once
+
+#include <QFile>
+#include <QString>
+
+#include "audio_format.h"
+
+/*
+ * Reads the PCM audio out of a WAV file, a block at a time.
+ *
+ * Only the header is parsed up front, the samples are read straight out
+ * of the file as they are asked for, so hours long recordings never have
+ * to fit in memory. 16, 24 and 32-bit integer and 32-bit float samples are
+ * supported, which covers what the decimator can convert.
+ */
+class WavReader {
+    public:
+        WavReader();
+
+        bool        open(const QString& path);
+        void        close();
+
+        /*
+         * Reads up to `maxSize` bytes of audio, always a whole number of
+         * frames. Returns the number of bytes read, 0 at the end of the
+         * audio or -1 on a read error.
+         */
+        qsizetype   read(char* data, qsizetype maxSize);
+
+        /*
+         * Moves to `frame` frames from the start of the audio
+         */
+        bool        seek(qint64 frame);
+
+        /*
+         * Getters
+         */
+        AudioFormat getFormat() const;
+        qint64      getFrameCount() const;
+        QString     getErrorString() const;
+
+    private:
+        bool        readHeader();
+        bool        fail(const QString& error);
+
+        QFile       m_file;
+        AudioFormat m_format;
+        QString     m_errorString;
+
+        // Where the samples are in the file
+        qint64      m_dataOffset = 0;
+        qint64      m_dataSize = 0;
+
+        // Bytes of audio read so far
+        qint64      m_position = 0;
+};
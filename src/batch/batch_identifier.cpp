@@ -0,0 +1,358 @@
+#include <QDebug>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QThread>
+#include <QtConcurrent/QtConcurrentRun>
+#include <algorithm>
+
+#include "audio/wav_reader.h"
+#include "batch_identifier.h"
+#include "fingerprint/streaming_fingerprinter.h"
+#include "trace.h"
+
+// Bytes read from a file at a time
+#define BATCH_READ_BLOCK_SIZE (256 * 1024)
+
+BatchIdentifier::BatchIdentifier(QObject* parent) :
+    QObject(parent),
+    m_shazam(this) {
+        m_threadPool.setMaxThreadCount(QThread::idealThreadCount());
+        if (isTracing()) {
+            m_threadPool.setExpiryTimeout(-1);
+        }
+        m_output.open(stdout, QIODevice::WriteOnly);
+
+        connect(&m_shazam, &Shazam::detectionComplete, this, &BatchIdentifier::onDetectionComplete);
+
+        m_shazam.setMaxInFlight(BATCH_DEFAULT_MAX_REQUESTS);
+        m_shazam.setOrderedResults(true);
+
+        // Segments and tracklist windows are each looked up on their own,
+        // a window overlapping a transition mustn't get the previous track
+        m_shazam.setLookupCache(false);
+}
+
+BatchIdentifier::~BatchIdentifier() {
+    // Don't let a worker outlive the object it reports back to
+    m_threadPool.waitForDone();
+}
+
+void BatchIdentifier::setMaxRequests(int maxRequests) {
+    m_shazam.setMaxInFlight(maxRequests);
+}
+
+void BatchIdentifier::setSegmentInterval(int seconds) {
+    m_interval = std::max(1, seconds);
+}
+
+void BatchIdentifier::setTracklistMode(bool enabled) {
+    m_tracklistMode = enabled;
+
+    // Segments are written as they complete, keep them in the order sent
+    m_shazam.setOrderedResults(!enabled);
+}
+
+bool BatchIdentifier::openLocalIndex(const QString& path) {
+    return m_shazam.openLocalIndex(path);
+}
+
+void BatchIdentifier::start(const QStringList& paths) {
+    const auto files = findFiles(paths);
+    if (files.isEmpty()) {
+        qWarning() << "No WAV files found";
+        m_failed = true;
+    }
+
+    m_shazam.warmUp();
+
+    for (const auto& file : files) {
+        addFile(file);
+    }
+
+    // Even with nothing to do, report it from the event loop
+    QMetaObject::invokeMethod(this, &BatchIdentifier::finishIfDone, Qt::QueuedConnection);
+}
+
+void BatchIdentifier::onDetectionComplete(quint64 requestId, const ShazamResponse& response) {
+    if (!m_inFlight.contains(requestId)) {
+        return;
+    }
+
+    const auto lookup = m_inFlight.take(requestId);
+    auto& file = m_files[lookup.fileId];
+    file.lookupsPending--;
+
+    if (m_tracklistMode) {
+        file.scanner.addResult(lookup.window, response);
+        queueNextTracklistLookup(lookup.fileId);
+    } else {
+        QJsonObject line;
+        line["file"] = file.path;
+        line["offset"] = lookup.window * m_interval;
+        line["length"] = file.windows[lookup.window].lengthInSeconds;
+        line["found"] = response.getFound();
+
+        if (response.getFound()) {
+            line["title"] = response.getTitle();
+            line["artist"] = response.getArtist();
+            line["album"] = response.getAlbum();
+            line["track"] = response.getTrack();
+        }
+
+        writeLine(line);
+    }
+
+    finishFileIfDone(lookup.fileId);
+    sendLookups();
+    finishIfDone();
+}
+
+QStringList BatchIdentifier::findFiles(const QStringList& paths) {
+    QStringList files;
+
+    for (const auto& path : paths) {
+        const QFileInfo info(path);
+
+        if (info.isDir()) {
+            QDirIterator it(path, { "*.wav", "*.WAV" }, QDir::Files, QDirIterator::Subdirectories);
+            QStringList found;
+            while (it.hasNext()) {
+                found.append(it.next());
+            }
+
+            // Directory order is arbitrary, keep runs reproducible
+            found.sort();
+            files.append(found);
+        } else {
+            files.append(path);
+        }
+    }
+
+    return files;
+}
+
+bool BatchIdentifier::feedFrames(WavReader& reader, qint64 frameCount, StreamingFingerprinter& fingerprinter) {
+    const AudioFormat format = reader.getFormat();
+
+    // One block per thread, reused for every window and file it reads
+    thread_local QByteArray block;
+    block.resize(BATCH_READ_BLOCK_SIZE / format.bytesPerFrame() * format.bytesPerFrame());
+
+    qint64 remaining = frameCount * format.bytesPerFrame();
+    while (remaining > 0) {
+        const qsizetype read = reader.read(block.data(), static_cast<qsizetype>(std::min<qint64>(block.size(), remaining)));
+        if (read < 0) {
+            return false;
+        }
+        if (read == 0) {
+            break;
+        }
+
+        fingerprinter.feed(block.constData(), read, format);
+        remaining -= read;
+    }
+
+    return true;
+}
+
+/*******************************************************
+ * Private methods
+ *******************************************************/
+
+BatchIdentifier::WindowsResult BatchIdentifier::fingerprintWindows(const QString& path, int interval, int firstWindow, int windowCount) {
+    WindowsResult result;
+
+    WavReader reader;
+    if (!reader.open(path)) {
+        result.error = reader.getErrorString();
+        return result;
+    }
+
+    const AudioFormat format = reader.getFormat();
+    const qint64 windowFrames = static_cast<qint64>(SIGNATURE_MAX_SECONDS) * format.sampleRate;
+    const qint64 intervalFrames = static_cast<qint64>(interval) * format.sampleRate;
+
+    StreamingFingerprinter fingerprinter;
+
+    for (int window = firstWindow; window < firstWindow + windowCount; window++) {
+        // Only the audio under each window is ever read
+        fingerprinter.reset();
+        if (!reader.seek(window * intervalFrames) || !feedFrames(reader, windowFrames, fingerprinter)) {
+            result.error = reader.getErrorString();
+            return result;
+        }
+
+        const auto& signature = fingerprinter.getSignature();
+
+        Window fingerprinted;
+        fingerprinted.lengthInSeconds = static_cast<int>((signature.getLengthInMilliseconds() + 500) / 1000);
+        fingerprinted.uri = signature.encodeToUri();
+        result.windows.append(fingerprinted);
+    }
+
+    return result;
+}
+
+void BatchIdentifier::addFile(const QString& path) {
+    // Only the header is read here, to work out the windows
+    WavReader reader;
+    if (!reader.open(path)) {
+        writeError(path, reader.getErrorString());
+        m_failed = true;
+        return;
+    }
+
+    const AudioFormat format = reader.getFormat();
+    const qint64 frameCount = reader.getFrameCount();
+    const qint64 intervalFrames = static_cast<qint64>(m_interval) * format.sampleRate;
+    const qint64 minimumFrames = static_cast<qint64>(BATCH_MIN_SEGMENT_SECONDS) * format.sampleRate;
+
+    if (frameCount < minimumFrames) {
+        writeError(path, QStringLiteral("Too short to identify"));
+        return;
+    }
+
+    const auto windowCount = static_cast<int>((frameCount - minimumFrames) / intervalFrames + 1);
+    const int fileId = m_nextFileId++;
+
+    FileState file;
+    file.path = path;
+    file.lengthInSeconds = static_cast<double>(frameCount) / format.sampleRate;
+    file.windows.resize(windowCount);
+    file.tasksPending = (windowCount + BATCH_WINDOWS_PER_TASK - 1) / BATCH_WINDOWS_PER_TASK;
+    m_files.insert(fileId, file);
+
+    for (int first = 0; first < windowCount; first += BATCH_WINDOWS_PER_TASK) {
+        const int count = std::min(BATCH_WINDOWS_PER_TASK, windowCount - first);
+        auto* watcher = new QFutureWatcher<WindowsResult>(this);
+
+        connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, fileId, first] {
+            onWindowsFingerprinted(fileId, first, watcher->result());
+            watcher->deleteLater();
+        });
+
+        watcher->setFuture(QtConcurrent::run(&m_threadPool, &BatchIdentifier::fingerprintWindows, path, m_interval, first, count));
+    }
+}
+
+void BatchIdentifier::onWindowsFingerprinted(int fileId, int firstWindow, const WindowsResult& result) {
+    auto& file = m_files[fileId];
+    file.tasksPending--;
+
+    if (!result.error.isEmpty()) {
+        file.error = result.error;
+    }
+
+    for (qsizetype i = 0; i < result.windows.size(); i++) {
+        const int window = firstWindow + static_cast<int>(i);
+        file.windows[window] = result.windows[i];
+
+        // Without a tracklist every window is looked up, as soon as it's ready
+        if (!m_tracklistMode) {
+            m_queue.enqueue({ fileId, window });
+            file.lookupsPending++;
+        }
+    }
+
+    if (m_tracklistMode && file.tasksPending == 0 && file.error.isEmpty()) {
+        file.scanner = TracklistScanner(static_cast<int>(file.windows.size()), m_interval);
+        queueNextTracklistLookup(fileId);
+    }
+
+    finishFileIfDone(fileId);
+    sendLookups();
+    finishIfDone();
+}
+
+void BatchIdentifier::queueNextTracklistLookup(int fileId) {
+    auto& file = m_files[fileId];
+
+    const int window = file.scanner.nextWindow();
+    if (window >= 0) {
+        m_queue.enqueue({ fileId, window });
+        file.lookupsPending++;
+    }
+}
+
+void BatchIdentifier::finishFileIfDone(int fileId) {
+    const auto& file = m_files[fileId];
+    if (file.tasksPending > 0 || file.lookupsPending > 0) {
+        return;
+    }
+
+    if (!file.error.isEmpty()) {
+        writeError(file.path, file.error);
+        m_failed = true;
+    } else if (m_tracklistMode) {
+        writeTracklist(file);
+    }
+
+    m_files.remove(fileId);
+}
+
+void BatchIdentifier::writeTracklist(const FileState& file) {
+    const auto entries = file.scanner.getEntries();
+
+    for (qsizetype i = 0; i < entries.size(); i++) {
+        const auto& entry = entries[i];
+        const double start = entry.firstWindow * m_interval;
+
+        // Windows overlap, so end each track where the next one starts
+        double end = std::min(
+            static_cast<double>(entry.lastWindow * m_interval + file.windows[entry.lastWindow].lengthInSeconds),
+            file.lengthInSeconds);
+        if (i + 1 < entries.size()) {
+            end = std::min(end, static_cast<double>(entries[i + 1].firstWindow * m_interval));
+        }
+
+        QJsonObject line;
+        line["file"] = file.path;
+        line["start"] = start;
+        line["end"] = end;
+        line["title"] = entry.response.getTitle();
+        line["artist"] = entry.response.getArtist();
+        line["album"] = entry.response.getAlbum();
+        line["track"] = entry.response.getTrack();
+        writeLine(line);
+    }
+
+    qInfo() << "Tracklist for" << file.path << "has" << entries.size() << "tracks from"
+            << file.scanner.getLookupCount() << "lookups of" << file.windows.size() << "windows";
+}
+
+void BatchIdentifier::sendLookups() {
+    // Shazam holds them back until there is room in flight
+    while (!m_queue.isEmpty()) {
+        const auto lookup = m_queue.dequeue();
+        auto& window = m_files[lookup.fileId].windows[lookup.window];
+        const auto requestId = m_shazam.detectFromUri(window.uri, window.lengthInSeconds);
+
+        // Each window is only looked up once
+        window.uri.clear();
+        m_inFlight.insert(requestId, lookup);
+    }
+}
+
+void BatchIdentifier::writeError(const QString& path, const QString& error) {
+    QJsonObject line;
+    line["file"] = path;
+    line["error"] = error;
+    writeLine(line);
+}
+
+void BatchIdentifier::writeLine(const QJsonObject& line) {
+    m_output.write(QJsonDocument(line).toJson(QJsonDocument::Compact));
+    m_output.write("\n");
+
+    // Let whoever is reading follow along as the batch runs
+    m_output.flush();
+}
+
+void BatchIdentifier::finishIfDone() {
+    if (m_files.isEmpty() && m_queue.isEmpty() && m_inFlight.isEmpty()) {
+        finished(m_failed ? 1 : 0);
+    }
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <QFile>
+#include <QHash>
+#include <QJsonObject>
+#include <QList>
+#include <QObject>
+#include <QQueue>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <qtmetamacros.h>
+
+#include "audio/wav_reader.h"
+#include "fingerprint/streaming_fingerprinter.h"
+#include "shazam/shazam.h"
+#include "tracklist_scanner.h"
+
+// Lookups allowed in flight at once, so a big batch doesn't hammer Shazam
+#define BATCH_DEFAULT_MAX_REQUESTS 4
+
+// A window is looked up every this many seconds of each recording
+#define BATCH_DEFAULT_SEGMENT_INTERVAL_SECONDS 60
+
+// In tracklist mode windows overlap by half, so every song has at least
+// one window entirely inside it
+#define TRACKLIST_DEFAULT_WINDOW_STEP_SECONDS 6
+
+// Shorter windows (at the end of a file) aren't worth looking up
+#define BATCH_MIN_SEGMENT_SECONDS 3
+
+// Windows fingerprinted by each task, long recordings are split into
+// several tasks so they are fingerprinted on all cores
+#define BATCH_WINDOWS_PER_TASK 16
+
+/*
+ * Identifies the music in a batch of audio files without the tray UI.
+ *
+ * Each file is cut into windows, one every `interval` seconds, which are
+ * read in blocks and fingerprinted on a private thread pool with one
+ * worker per core. Window lookups are queued and at most `maxRequests` go
+ * to Shazam at once (see LookupScheduler).
+ *
+ * By default every window is looked up and written out as one line of
+ * JSON, in the order the lookups were queued. In tracklist mode a
+ * TracklistScanner picks which windows to look up, and each file's
+ * tracklist is written out once it is complete, one line per track.
+ */
+class BatchIdentifier : public QObject {
+    Q_OBJECT
+
+    public:
+        BatchIdentifier(QObject* parent);
+        ~BatchIdentifier();
+
+        void    setMaxRequests(int maxRequests);
+        void    setSegmentInterval(int seconds);
+        void    setTracklistMode(bool enabled);
+
+        /*
+         * See Shazam::openLocalIndex()
+         */
+        bool    openLocalIndex(const QString& path);
+
+        /*
+         * Identifies every WAV file in `paths`, directories are searched
+         * recursively. finished() is raised once everything is done.
+         */
+        void    start(const QStringList& paths);
+
+        /*
+         * Every WAV file in `paths`, directories are searched recursively
+         */
+        static QStringList  findFiles(const QStringList& paths);
+
+        /*
+         * Feeds the next `frameCount` frames of `reader` (or up to the end)
+         * into `fingerprinter`, a block at a time. Returns false on a read
+         * error.
+         */
+        static bool         feedFrames(WavReader& reader, qint64 frameCount, StreamingFingerprinter& fingerprinter);
+
+    signals:
+        void    finished(int exitCode);
+
+    private slots:
+        void    onDetectionComplete(quint64 requestId, const ShazamResponse& response);
+
+    private:
+        struct Window {
+            QString     uri;
+            int         lengthInSeconds = 0;
+        };
+
+        struct WindowsResult {
+            QString         error;
+            QList<Window>   windows;
+        };
+
+        struct FileState {
+            QString             path;
+            double              lengthInSeconds = 0.0;
+            QList<Window>       windows;
+            int                 tasksPending = 0;
+            int                 lookupsPending = 0;
+            QString             error;
+            TracklistScanner    scanner;
+        };
+
+        struct Lookup {
+            int         fileId = 0;
+            int         window = 0;
+        };
+
+        static WindowsResult    fingerprintWindows(const QString& path, int interval, int firstWindow, int windowCount);
+
+        void    addFile(const QString& path);
+        void    onWindowsFingerprinted(int fileId, int firstWindow, const WindowsResult& result);
+        void    queueNextTracklistLookup(int fileId);
+        void    finishFileIfDone(int fileId);
+        void    writeTracklist(const FileState& file);
+        void    sendLookups();
+        void    writeError(const QString& path, const QString& error);
+        void    writeLine(const QJsonObject& line);
+        void    finishIfDone();
+
+        QThreadPool             m_threadPool;
+        Shazam                  m_shazam;
+        QFile                   m_output;
+
+        int                     m_interval = BATCH_DEFAULT_SEGMENT_INTERVAL_SECONDS;
+        bool                    m_tracklistMode = false;
+
+        int                     m_nextFileId = 0;
+        QHash<int, FileState>   m_files;
+        bool                    m_failed = false;
+        QQueue<Lookup>          m_queue;
+        QHash<quint64, Lookup>  m_inFlight;
+};
@@ -0,0 +1,105 @@
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include "audio/wav_reader.h"
+#include "batch_identifier.h"
+#include "fingerprint/streaming_fingerprinter.h"
+#include "index_builder.h"
+
+bool IndexBuilder::build(const QString& indexPath, const QStringList& paths) {
+    const auto files = BatchIdentifier::findFiles(paths);
+    if (files.isEmpty()) {
+        qWarning() << "No WAV files found";
+        return false;
+    }
+
+    // Runs are spilled next to the index rather than to a /tmp that may be in memory
+    LocalIndexWriter writer(QFileInfo(indexPath).absolutePath());
+    bool failed = false;
+
+    for (qsizetype first = 0; first < files.size(); first += INDEX_BUILDER_FILES_PER_BATCH) {
+        const auto batch = files.mid(first, INDEX_BUILDER_FILES_PER_BATCH);
+        const QList<IndexedFile> indexed = QtConcurrent::blockingMapped<QList<IndexedFile>>(batch, &IndexBuilder::fingerprintFile);
+
+        // In file order, so the same files always give the same index
+        for (const auto& file : indexed) {
+            if (!file.error.isEmpty()) {
+                qWarning() << "Failed to index" << file.path << file.error;
+                failed = true;
+                continue;
+            }
+
+            if (!writer.addTrack(trackInfoFromPath(file.path), file.signature)) {
+                return false;
+            }
+        }
+
+        qInfo() << "Indexed" << writer.getTrackCount() << "of" << files.size() << "files";
+    }
+
+    if (writer.getTrackCount() == 0 || !writer.write(indexPath)) {
+        return false;
+    }
+
+    return !failed;
+}
+
+LocalIndexTrackInfo IndexBuilder::trackInfoFromPath(const QString& path) {
+    static const QRegularExpression trackNumber(QStringLiteral("^(\\d{1,3})(\\s*[.-]\\s*|\\s+)"));
+
+    const QFileInfo info(path);
+    const QDir album = info.absoluteDir();
+
+    LocalIndexTrackInfo track;
+    QString name = info.completeBaseName();
+
+    // "01 Title", "01. Title" or "01 - Artist - Title", but "50 Cent - Title"
+    // is an artist
+    const auto number = trackNumber.match(name);
+    if (number.hasMatch() && (!number.captured(2).trimmed().isEmpty() || !name.contains(QStringLiteral(" - ")))) {
+        track.trackNumber = number.captured(1).toInt();
+        name = name.mid(number.capturedLength());
+    }
+
+    const qsizetype separator = name.indexOf(QStringLiteral(" - "));
+    if (separator > 0) {
+        track.artist = name.left(separator).trimmed();
+        track.title = name.mid(separator + 3).trimmed();
+    } else {
+        track.title = name.trimmed();
+        track.artist = QFileInfo(album.absolutePath()).dir().dirName();
+    }
+
+    track.album = album.dirName();
+    return track;
+}
+
+/*******************************************************
+ * Private methods
+ *******************************************************/
+
+IndexBuilder::IndexedFile IndexBuilder::fingerprintFile(const QString& path) {
+    IndexedFile file;
+    file.path = path;
+
+    WavReader reader;
+    if (!reader.open(path)) {
+        file.error = reader.getErrorString();
+        return file;
+    }
+
+    // The whole track, not just the 12 seconds Shazam gets
+    StreamingFingerprinter fingerprinter;
+    fingerprinter.setMaxLengthInSeconds(0);
+
+    if (!BatchIdentifier::feedFrames(reader, reader.getFrameCount(), fingerprinter)) {
+        file.error = reader.getErrorString();
+        return file;
+    }
+
+    file.signature = fingerprinter.getSignature();
+    return file;
+}
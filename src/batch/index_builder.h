@@ -0,0 +1,41 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+
+#include "index/local_index_writer.h"
+
+// Files fingerprinted at a time, each batch is added to the index before
+// the next one is read so only a few whole-track signatures are in memory
+#define INDEX_BUILDER_FILES_PER_BATCH 64
+
+/*
+ * Builds a local fingerprint index (see LocalIndex) from WAV files.
+ *
+ * Each file is fingerprinted whole, on all cores, and becomes one track.
+ * WAV files rarely carry tags, so the track is described by its path:
+ * "Artist/Album/01 Title.wav", or "Artist - Title.wav" anywhere. The
+ * track number is taken from the start of the file name, the album from
+ * the directory and the artist from the directory above that, unless the
+ * file name names it.
+ */
+class IndexBuilder {
+    public:
+        /*
+         * Indexes every WAV file in `paths`, directories are searched
+         * recursively, and writes the index to `indexPath`. Returns false
+         * if any file couldn't be read or the index couldn't be written.
+         */
+        static bool     build(const QString& indexPath, const QStringList& paths);
+
+        static LocalIndexTrackInfo  trackInfoFromPath(const QString& path);
+
+    private:
+        struct IndexedFile {
+            QString     path;
+            QString     error;
+            Signature   signature;
+        };
+
+        static IndexedFile  fingerprintFile(const QString& path);
+};
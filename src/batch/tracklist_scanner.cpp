@@ -0,0 +1,127 @@
+#include <algorithm>
+
+#include "tracklist_scanner.h"
+
+TracklistScanner::TracklistScanner(int windowCount, int windowStepInSeconds) :
+    m_windowCount(windowCount) {
+        const int step = std::max(1, windowStepInSeconds);
+        m_minSkip = std::max(1, TRACKLIST_MIN_SKIP_SECONDS / step);
+        m_maxSkip = std::max(m_minSkip, TRACKLIST_MAX_SKIP_SECONDS / step);
+        m_maxGap = TRACKLIST_MAX_GAP_SECONDS / step;
+        m_boundary = std::max(1, TRACKLIST_BOUNDARY_SECONDS / step);
+
+        advance();
+}
+
+int TracklistScanner::nextWindow() const {
+    return m_next;
+}
+
+void TracklistScanner::addResult(int window, const ShazamResponse& response) {
+    m_results.insert(window, response);
+    advance();
+}
+
+/*
+ * Getters
+ */
+
+QList<TracklistEntry> TracklistScanner::getEntries() const {
+    return m_entries;
+}
+
+int TracklistScanner::getLookupCount() const {
+    return static_cast<int>(m_results.size());
+}
+
+/*******************************************************
+ * Private methods
+ *******************************************************/
+
+void TracklistScanner::advance() {
+    while (true) {
+        if (!m_inTrack) {
+            if (m_cursor >= m_windowCount) {
+                m_next = -1;
+                return;
+            }
+
+            const auto result = m_results.constFind(m_cursor);
+            if (result == m_results.constEnd()) {
+                m_next = m_cursor;
+                return;
+            }
+
+            if (!result->getFound()) {
+                m_cursor++;
+                continue;
+            }
+
+            m_inTrack = true;
+            m_track = *result;
+            m_first = m_cursor;
+            m_last = m_cursor;
+            m_upper = -1;
+            m_skip = m_minSkip;
+            continue;
+        }
+
+        int probe;
+        if (m_upper < 0) {
+            // Gallop ahead while the track keeps going
+            if (m_last + 1 >= m_windowCount) {
+                closeTrack();
+                m_cursor = m_windowCount;
+                continue;
+            }
+
+            probe = std::min(m_last + m_skip, m_windowCount - 1);
+        } else {
+            // Bisect back to where it ended
+            if (m_upper - m_last <= m_boundary) {
+                closeTrack();
+                m_cursor = m_upper;
+                continue;
+            }
+
+            probe = (m_last + m_upper) / 2;
+        }
+
+        const auto result = m_results.constFind(probe);
+        if (result == m_results.constEnd()) {
+            m_next = probe;
+            return;
+        }
+
+        if (isSameTrack(*result, m_track)) {
+            m_last = probe;
+            if (m_upper < 0) {
+                m_skip = std::min(m_skip * 2, m_maxSkip);
+            }
+        } else {
+            m_upper = probe;
+        }
+    }
+}
+
+void TracklistScanner::closeTrack() {
+    m_inTrack = false;
+
+    if (!m_entries.isEmpty()) {
+        auto& previous = m_entries.last();
+        if (isSameTrack(previous.response, m_track) && m_first - previous.lastWindow <= m_maxGap + 1) {
+            previous.lastWindow = m_last;
+            return;
+        }
+    }
+
+    TracklistEntry entry;
+    entry.firstWindow = m_first;
+    entry.lastWindow = m_last;
+    entry.response = m_track;
+    m_entries.append(entry);
+}
+
+bool TracklistScanner::isSameTrack(const ShazamResponse& left, const ShazamResponse& right) {
+    return left.getTitle() == right.getTitle() && left.getArtist() == right.getArtist();
+}
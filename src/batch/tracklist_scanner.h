@@ -0,0 +1,81 @@
+#pragma once
+
+#include <QHash>
+#include <QList>
+
+#include "shazam/shazam_response.h"
+
+// Once a track is confirmed the scan skips ahead this far, doubling up to
+// the maximum while the track keeps being confirmed. The maximum bounds
+// how short a song can be and still not be stepped over.
+#define TRACKLIST_MIN_SKIP_SECONDS 30
+#define TRACKLIST_MAX_SKIP_SECONDS 120
+
+// Track changes are only narrowed down to this, finer is more lookups
+#define TRACKLIST_BOUNDARY_SECONDS 12
+
+// Two stretches of the same track this close together are one entry, a
+// window that wasn't recognised in the middle of a song doesn't split it
+#define TRACKLIST_MAX_GAP_SECONDS 30
+
+struct TracklistEntry {
+    int             firstWindow = 0;
+    int             lastWindow = 0;
+    ShazamResponse  response;
+};
+
+/*
+ * Decides which windows of a long recording to look up to build its
+ * tracklist, and merges the results into one entry per track.
+ *
+ * Windows are looked up one at a time until a track is found. From there
+ * the scan gallops ahead, skipping further each time the same track is
+ * confirmed, and when a probe hears something else it bisects back to the
+ * last window of the track. That keeps the number of lookups close to
+ * the number of distinct songs rather than the length of the recording.
+ */
+class TracklistScanner {
+    public:
+        TracklistScanner(int windowCount = 0, int windowStepInSeconds = 1);
+
+        /*
+         * Window to look up next, or -1 once the scan is done
+         */
+        int         nextWindow() const;
+
+        void        addResult(int window, const ShazamResponse& response);
+
+        /*
+         * Getters
+         */
+        QList<TracklistEntry>   getEntries() const;
+        int                     getLookupCount() const;
+
+    private:
+        void        advance();
+        void        closeTrack();
+
+        static bool isSameTrack(const ShazamResponse& left, const ShazamResponse& right);
+
+        int         m_windowCount;
+        int         m_minSkip;
+        int         m_maxSkip;
+        int         m_maxGap;
+        int         m_boundary;
+
+        QHash<int, ShazamResponse>  m_results;
+        QList<TracklistEntry>       m_entries;
+        int         m_next = -1;
+
+        // Next window to look at while not in a track
+        int         m_cursor = 0;
+
+        // Track being followed, confirmed from m_first to m_last. When
+        // m_upper is set it is the first window known to be something else.
+        bool            m_inTrack = false;
+        ShazamResponse  m_track;
+        int             m_first = 0;
+        int             m_last = 0;
+        int             m_upper = -1;
+        int             m_skip = 0;
+};
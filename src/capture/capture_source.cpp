@@ -0,0 +1,427 @@
+#include <QDebug>
+
+#include <algorithm>
+
+#include "capture_source.h"
+#include "latency_stats.h"
+#include "trace.h"
+
+CaptureSource::CaptureSource(QObject* parent) :
+    QObject(parent) {
+        const AudioFormat format = getFormat();
+        m_minBufferSize = format.sampleRate * format.bytesPerFrame() * m_bufferLengthInSeconds;
+        m_drainBuffer.resize(AUDIO_DRAIN_BLOCK_SIZE);
+
+        m_drainTimer.setInterval(AUDIO_RING_BUFFER_DRAIN_INTERVAL_MS);
+        connect(&m_drainTimer, &QTimer::timeout, this, &CaptureSource::onDrainRingBuffer);
+}
+
+/*******************************************************
+ * Public APIs
+ *******************************************************/
+
+void CaptureSource::startCapture(int minDurationInSeconds) {
+    qDebug() << "Starting capture";
+
+    m_captureTimer.start();
+
+    if (m_continuousCapture) {
+        if (m_suspended) {
+            // Nothing but silence for a while, so nothing to look up.
+            // Callers expect the answer after startCapture() has returned.
+            QMetaObject::invokeMethod(this, &CaptureSource::captureSilent, Qt::QueuedConnection);
+            return;
+        }
+
+        // Answer from the pre-roll window, either right now or as
+        // soon as it holds enough audio
+        m_capturePending = true;
+
+        if (!m_isCapturing) {
+            // The input has ended, the window is all there will ever be
+            m_capturePending = false;
+            completeFromPrerollWindow(m_minBufferSize);
+            return;
+        }
+
+        onDrainRingBuffer();
+        return;
+    }
+
+    restartStream();
+}
+
+void CaptureSource::setContinuousCapture(bool enabled, int windowLengthInSeconds) {
+    m_windowLengthInSeconds = windowLengthInSeconds;
+    m_capturePending = false;
+    m_noveltyDetector.setSettleSeconds(std::min(m_bufferLengthInSeconds, windowLengthInSeconds));
+
+    if (enabled == m_continuousCapture) {
+        // The window is resized on the next drain if the length changed
+        return;
+    }
+
+    m_continuousCapture = enabled;
+
+    if (enabled) {
+        qDebug() << "Starting continuous capture with a" << windowLengthInSeconds << "second window";
+        restartStream();
+    } else {
+        qDebug() << "Stopping continuous capture";
+        onStopCapture();
+        m_prerollWindow.setCapacity(0);
+    }
+}
+
+bool CaptureSource::isContinuousCapture() {
+    return m_continuousCapture;
+}
+
+void CaptureSource::setSilenceGate(bool enabled) {
+    m_silenceGateEnabled = enabled;
+
+    if (!enabled) {
+        m_waitingForMusic = false;
+        m_suspended = false;
+    }
+}
+
+bool CaptureSource::isSuspended() const {
+    return m_suspended;
+}
+
+void CaptureSource::setTrackChangeDetection(bool enabled) {
+    if (enabled && !m_trackChangeDetection) {
+        // Whatever is playing now counts as a new track
+        m_noveltyDetector.reset();
+    }
+
+    m_trackChangeDetection = enabled;
+}
+
+/***********************************************
+ * Getters
+ ***********************************************/
+
+int CaptureSource::getBufferLengthInSeconds() {
+    if (m_continuousCapture) {
+        return std::min(m_bufferLengthInSeconds, m_windowLengthInSeconds);
+    }
+
+    return m_bufferLengthInSeconds;
+}
+
+AudioFormat CaptureSource::getFormat() {
+    return AudioDecimator::outputFormat();
+}
+
+uint64_t CaptureSource::getOverruns() {
+    return m_ringBuffer.getOverruns();
+}
+
+quint64 CaptureSource::getBufferAllocations() const {
+    return m_bufferPool.getAllocations();
+}
+
+/*
+ * Slots
+ */
+void CaptureSource::onStopCapture() {
+    qDebug() << "Stopping capture";
+
+    m_isCapturing = false;
+    m_drainTimer.stop();
+    stopStream();
+}
+
+void CaptureSource::onDrainRingBuffer() {
+    TraceSpan span("drain", "capture");
+
+    const auto overruns = m_ringBuffer.getOverruns();
+    if (overruns != m_reportedOverruns) {
+        qWarning() << "Audio ring buffer overrun, dropped" << overruns - m_reportedOverruns << "writes";
+        m_reportedOverruns = overruns;
+    }
+
+    if (!m_isCapturing) {
+        return;
+    }
+
+    fillRingBuffer();
+
+    // The backend may have run out of audio while filling
+    if (!m_isCapturing) {
+        return;
+    }
+
+    if (m_continuousCapture) {
+        if (m_suspended) {
+            watchForSound();
+        } else {
+            drainIntoPrerollWindow();
+        }
+        return;
+    }
+
+    const auto oldSize = m_audioBuffer.size();
+    const auto bytesAdded = drainAndDecimate(m_audioBuffer);
+    if (bytesAdded == 0) {
+        return;
+    }
+
+    if (m_waitingForMusic) {
+        if (!m_silenceGate.isOpen()) {
+            // Hold off until the music starts, rather than capture silence
+            m_silentBytes += bytesAdded;
+            m_audioBuffer.resize(oldSize);
+
+            if (m_silentBytes >= qint64(SILENCE_GATE_MAX_WAIT_SECONDS) * DECIMATED_SAMPLE_RATE * qint64(sizeof(int16_t))) {
+                qInfo() << "No music after" << SILENCE_GATE_MAX_WAIT_SECONDS << "seconds, giving up";
+                onStopCapture();
+                captureSilent();
+            }
+            return;
+        }
+
+        m_waitingForMusic = false;
+    }
+
+    chunkCaptured(QByteArray(m_audioBuffer.constData() + oldSize, bytesAdded));
+
+    if (m_audioBuffer.size() < m_minBufferSize) {
+        return;
+    }
+
+    onStopCapture();
+    completeCapture(m_audioBuffer);
+}
+
+/*******************************************************
+ * Protected methods
+ *******************************************************/
+
+void CaptureSource::fillRingBuffer() {
+}
+
+void CaptureSource::endOfInput() {
+    if (!m_isCapturing) {
+        return;
+    }
+
+    qDebug() << "End of capture input";
+
+    // Whatever is still in the ring buffer is part of the capture
+    if (m_continuousCapture) {
+        drainIntoPrerollWindow();
+    } else {
+        const auto oldSize = m_audioBuffer.size();
+        const auto bytesAdded = drainAndDecimate(m_audioBuffer);
+        if (bytesAdded > 0) {
+            chunkCaptured(QByteArray(m_audioBuffer.constData() + oldSize, bytesAdded));
+        }
+    }
+
+    onStopCapture();
+
+    // Always answer, even if there is no audio at all, so nobody is left
+    // waiting for a capture that will never finish
+    if (!m_continuousCapture) {
+        completeCapture(m_audioBuffer);
+    } else if (m_capturePending) {
+        m_capturePending = false;
+        completeFromPrerollWindow(m_minBufferSize);
+    }
+}
+
+void CaptureSource::setDrainInterval(int milliseconds) {
+    m_drainTimer.setInterval(milliseconds);
+}
+
+bool CaptureSource::isCapturing() const {
+    return m_isCapturing.load(std::memory_order_relaxed);
+}
+
+/*******************************************************
+ * Private methods
+ *******************************************************/
+
+bool CaptureSource::restartStream() {
+    // Stop anything already running. The last capture may still be being
+    // fingerprinted, the pool only hands it out again once it isn't.
+    onStopCapture();
+    m_bufferPool.recycle(std::move(m_audioBuffer));
+    m_audioBuffer = QByteArray();
+
+    if (!m_continuousCapture) {
+        // The last drain usually goes a little past the capture length
+        const AudioFormat format = getFormat();
+        m_audioBuffer = m_bufferPool.acquire(m_minBufferSize + qsizetype(format.sampleRate) * format.bytesPerFrame());
+    }
+
+    m_prerollWindow.clear();
+    m_ringBuffer.discard();
+    m_decimator.reset();
+    m_started = false;
+    m_silenceGate.reset();
+    m_noveltyDetector.reset();
+    m_waitingForMusic = m_silenceGateEnabled && !m_continuousCapture;
+    m_silentBytes = 0;
+    m_suspended = false;
+    m_isCapturing = true;
+    m_drainTimer.start();
+
+    if (!startStream()) {
+        m_isCapturing = false;
+        m_drainTimer.stop();
+        return false;
+    }
+
+    return true;
+}
+
+void CaptureSource::drainIntoPrerollWindow() {
+    const AudioFormat format = getFormat();
+    const qsizetype windowSize = qsizetype(format.sampleRate) * format.bytesPerFrame() * m_windowLengthInSeconds;
+
+    // Only reallocates when the window length changes
+    if (m_prerollWindow.getCapacity() != windowSize) {
+        m_prerollWindow.setCapacity(windowSize);
+    }
+
+    // Keeps its capacity, so this only allocates on the first drain
+    m_decimatedChunk.resize(0);
+    drainAndDecimate(m_decimatedChunk);
+    m_prerollWindow.append(m_decimatedChunk.constData(), m_decimatedChunk.size());
+
+    if (m_silenceGateEnabled && m_silenceGate.getSilentSeconds() >= SILENCE_GATE_SUSPEND_SECONDS) {
+        qInfo() << "Silent for" << SILENCE_GATE_SUSPEND_SECONDS << "seconds, suspending capture";
+        m_suspended = true;
+        m_prerollWindow.clear();
+
+        if (m_capturePending) {
+            m_capturePending = false;
+            captureSilent();
+        }
+        return;
+    }
+
+    if (m_trackChangeDetection && m_noveltyDetector.process(
+            reinterpret_cast<const int16_t*>(m_decimatedChunk.constData()),
+            m_decimatedChunk.size() / qsizetype(sizeof(int16_t)))) {
+        qInfo() << "The track has changed";
+        trackChanged();
+    }
+
+    const qsizetype captureSize = std::min<qsizetype>(windowSize, m_minBufferSize);
+    if (m_capturePending && captureSize > 0 && m_prerollWindow.getSize() >= captureSize) {
+        m_capturePending = false;
+        completeFromPrerollWindow(captureSize);
+    }
+}
+
+qsizetype CaptureSource::drainAndDecimate(QByteArray& destination) {
+    const AudioFormat streamFormat = getStreamFormat();
+    const qsizetype bytesPerFrame = streamFormat.bytesPerFrame();
+    const qsizetype blockSize = AUDIO_DRAIN_BLOCK_SIZE - AUDIO_DRAIN_BLOCK_SIZE % bytesPerFrame;
+    const qsizetype oldSize = destination.size();
+
+    // Redesigns the filter if the stream was renegotiated
+    m_decimator.configure(streamFormat);
+
+    while (m_ringBuffer.getAvailable() > 0) {
+        const auto bytesRead = static_cast<qsizetype>(
+            m_ringBuffer.read(m_drainBuffer.data(), static_cast<size_t>(blockSize)));
+
+        if (bytesRead == 0) {
+            break;
+        }
+
+        const qsizetype size = destination.size();
+        destination.resize(size + m_decimator.getMaxOutputSamples(bytesRead) * qsizetype(sizeof(int16_t)));
+
+        const qsizetype samples = m_decimator.process(
+            m_drainBuffer.constData(), bytesRead, reinterpret_cast<int16_t*>(destination.data() + size));
+        destination.resize(size + samples * qsizetype(sizeof(int16_t)));
+    }
+
+    const qsizetype bytesAdded = destination.size() - oldSize;
+
+    if (m_silenceGateEnabled) {
+        m_silenceGate.process(reinterpret_cast<const int16_t*>(destination.constData() + oldSize),
+            bytesAdded / qsizetype(sizeof(int16_t)));
+    }
+
+    if (bytesAdded > 0 && !m_started) {
+        m_started = true;
+        m_firstAudioAt = m_captureTimer.isValid() ? m_captureTimer.nsecsElapsed() : 0;
+
+        // In continuous mode the stream started long before the capture
+        if (!m_continuousCapture) {
+            recordLatency(LatencyStage::CaptureStart, m_firstAudioAt);
+            qInfo() << "Capture started after" << m_firstAudioAt / 1000000 << "ms";
+        }
+
+        started();
+    }
+
+    return bytesAdded;
+}
+
+void CaptureSource::completeCapture(const QByteArray& buffer) {
+    if (m_captureTimer.isValid()) {
+        // A continuous capture is filled from the moment it is asked for
+        const qint64 fillStart = m_continuousCapture ? 0 : m_firstAudioAt;
+        recordLatency(LatencyStage::BufferFill, m_captureTimer.nsecsElapsed() - fillStart);
+        m_captureTimer.invalidate();
+    }
+
+    if (m_silenceGateEnabled) {
+        const double activity = SilenceGate::measureActivity(
+            reinterpret_cast<const int16_t*>(buffer.constData()), buffer.size() / qsizetype(sizeof(int16_t)));
+
+        if (activity < SILENCE_GATE_MIN_ACTIVITY) {
+            qInfo() << "Capture is" << qRound(activity * 100) << "% music, not worth looking up";
+            captureSilent();
+            return;
+        }
+    }
+
+    captureCompleted(buffer);
+}
+
+void CaptureSource::completeFromPrerollWindow(qsizetype size) {
+    // Handed out shared, and back to the pool once everyone is done with it
+    QByteArray buffer = m_bufferPool.acquire(size);
+    m_prerollWindow.snapshot(size, buffer);
+    completeCapture(buffer);
+    m_bufferPool.recycle(std::move(buffer));
+}
+
+void CaptureSource::watchForSound() {
+    // Only the level is checked, nothing is decimated until sound is back
+    const AudioFormat streamFormat = getStreamFormat();
+    const qsizetype blockSize = AUDIO_DRAIN_BLOCK_SIZE - AUDIO_DRAIN_BLOCK_SIZE % streamFormat.bytesPerFrame();
+    bool soundIsBack = false;
+
+    while (m_ringBuffer.getAvailable() > 0) {
+        const auto bytesRead = static_cast<qsizetype>(
+            m_ringBuffer.read(m_drainBuffer.data(), static_cast<size_t>(blockSize)));
+
+        if (bytesRead == 0) {
+            break;
+        }
+
+        soundIsBack = soundIsBack || SilenceGate::peakLevel(m_drainBuffer.constData(), bytesRead,
+            streamFormat.bitsPerSample, streamFormat.channels, streamFormat.floatingPoint) > SILENCE_GATE_RESUME_PEAK;
+    }
+
+    if (soundIsBack) {
+        qInfo() << "Sound is back, resuming capture";
+        m_suspended = false;
+        m_silenceGate.reset();
+        m_decimator.reset();
+
+        // Most likely something else is playing after that long
+        m_noveltyDetector.reset();
+    }
+}
@@ -0,0 +1,219 @@
+#pragma once
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QObject>
+#include <QTimer>
+#include <atomic>
+#include <cstdint>
+#include <qtmetamacros.h>
+
+#include "audio/audio_format.h"
+#include "audio/buffer_pool.h"
+#include "audio/decimator.h"
+#include "audio/novelty_detector.h"
+#include "audio/ring_buffer.h"
+#include "audio/rolling_window.h"
+#include "audio/silence_gate.h"
+
+// Big enough for well over a second of 8 channel F32 audio at 48kHz,
+// which gives the consumer plenty of slack between drains.
+#define AUDIO_RING_BUFFER_CAPACITY (2 * 1024 * 1024)
+#define AUDIO_RING_BUFFER_DRAIN_INTERVAL_MS 20
+
+// Raw audio is pulled out of the ring buffer and decimated in blocks of
+// (at most) this many bytes
+#define AUDIO_DRAIN_BLOCK_SIZE (64 * 1024)
+
+#define DEFAULT_CAPTURE_LENGTH_IN_SECONDS 15
+
+// How long a capture waits for music to start before giving up, and
+// how little of a finished capture can be music before it isn't worth
+// looking up
+#define SILENCE_GATE_MAX_WAIT_SECONDS 10
+#define SILENCE_GATE_MIN_ACTIVITY 0.1
+
+// Continuous capture stops decimating after this much silence, and
+// starts again once the raw audio peaks above SILENCE_GATE_RESUME_PEAK
+// (about -55dBFS)
+#define SILENCE_GATE_SUSPEND_SECONDS 10
+#define SILENCE_GATE_RESUME_PEAK 0.0018f
+
+/*
+ * Somewhere audio is captured from.
+ *
+ * A backend only has to get raw audio into the ring buffer, either from
+ * its own thread (PipeWireMonitor) or from fillRingBuffer(), which runs on
+ * the main thread before every drain. Everything after that, decimating to
+ * 16kHz mono, collecting a capture and continuous capture, is shared, so
+ * every backend behaves exactly like the live one.
+ *
+ * With the silence gate on (the default) a capture only starts once music
+ * does, and a capture with (next to) no music in it is reported with
+ * captureSilent() rather than captureCompleted(). Continuous capture
+ * suspends itself through long silences.
+ *
+ * Continuous capture can also watch for the track changing (see
+ * NoveltyDetector), so a new track can be identified without polling.
+ */
+class CaptureSource : public QObject {
+    Q_OBJECT
+
+    public:
+        CaptureSource(QObject* parent = nullptr);
+
+        void    startCapture(int minDurationInSeconds);
+
+        /*
+         * In continuous mode the stream stays running and the last
+         * `windowLengthInSeconds` of audio is kept in a fixed size window,
+         * so startCapture() can answer straight away from the pre-roll.
+         */
+        void    setContinuousCapture(bool enabled, int windowLengthInSeconds);
+        bool    isContinuousCapture();
+
+        void    setSilenceGate(bool enabled);
+
+        /*
+         * True while continuous capture is suspended for silence
+         */
+        bool    isSuspended() const;
+
+        /*
+         * In continuous mode, raises trackChanged() once a new track has
+         * filled a capture
+         */
+        void    setTrackChangeDetection(bool enabled);
+
+        /*
+         * Getters. getFormat() is the format of the audio handed out by
+         * captureCompleted() and chunkCaptured(), which is always
+         * decimated to 16kHz mono 16-bit.
+         */
+        int         getBufferLengthInSeconds();
+        AudioFormat getFormat();
+
+        // Number of writes dropped because the ring buffer was full
+        uint64_t    getOverruns();
+
+        // Capture buffers allocated so far, see AudioBufferPool
+        quint64     getBufferAllocations() const;
+
+    signals:
+
+        /*
+         * Raised when the first audio of a capture arrives
+         */
+        void started();
+
+        /*
+         * Raised when the source has read at least `minDurationInSeconds`
+         * of data, or less if the input ended first.
+         */
+        void captureCompleted(QByteArray buffer);
+
+        /*
+         * Raised for every piece of audio as it arrives during a capture,
+         * before captureCompleted(). Not raised in continuous mode.
+         */
+        void chunkCaptured(QByteArray chunk);
+
+        /*
+         * Raised instead of captureCompleted() when there was no music
+         * to capture
+         */
+        void captureSilent();
+
+        /*
+         * Raised in continuous mode, with track change detection on, when
+         * the pre-roll window holds a full capture of a new track
+         */
+        void trackChanged();
+
+    public slots:
+        void    onStopCapture();
+
+    protected:
+        /*
+         * Backend hooks. startStream() and stopStream() start and stop
+         * the flow of audio into the ring buffer, getStreamFormat() is the
+         * format of that audio.
+         */
+        virtual bool        startStream() = 0;
+        virtual void        stopStream() = 0;
+        virtual AudioFormat getStreamFormat() = 0;
+
+        /*
+         * For backends without a thread of their own, called on the main
+         * thread before each drain
+         */
+        virtual void        fillRingBuffer();
+
+        /*
+         * Finishes the capture in progress early, with whatever has been
+         * captured, once a backend has run out of audio
+         */
+        void                endOfInput();
+
+        void                setDrainInterval(int milliseconds);
+        bool                isCapturing() const;
+
+        // Written by the backend, drained by onDrainRingBuffer() on the
+        // main thread
+        AudioRingBuffer     m_ringBuffer{AUDIO_RING_BUFFER_CAPACITY};
+
+    private slots:
+        void    onDrainRingBuffer();
+
+    private:
+        bool                restartStream();
+        void                drainIntoPrerollWindow();
+        qsizetype           drainAndDecimate(QByteArray& destination);
+        void                completeCapture(const QByteArray& buffer);
+        void                completeFromPrerollWindow(qsizetype size);
+        void                watchForSound();
+
+        // Makes sure that we don't keep modifying m_audioBuffer
+        // once we have enough data. Read by backend threads.
+        std::atomic<bool>   m_isCapturing{false};
+        bool                m_started = false;
+
+        // Since startCapture(), for the latency stats
+        QElapsedTimer       m_captureTimer;
+        qint64              m_firstAudioAt = 0;
+
+        QTimer              m_drainTimer;
+        uint64_t            m_reportedOverruns = 0;
+
+        // Turns the raw stream audio into 16kHz mono as it is drained, so
+        // nothing downstream ever holds the full rate audio
+        AudioDecimator      m_decimator;
+        QByteArray          m_drainBuffer;
+        QByteArray          m_decimatedChunk;
+
+        // Stores the captured audio, decimated, in PCM format. Taken from
+        // the pool with room for the whole capture (and a second more), so
+        // appending never reallocates.
+        QByteArray          m_audioBuffer;
+        AudioBufferPool     m_bufferPool;
+
+        // Continuous capture state
+        RollingAudioWindow  m_prerollWindow;
+        bool                m_continuousCapture = false;
+        bool                m_capturePending = false;
+        int                 m_windowLengthInSeconds = 15;
+
+        // Silence gate state
+        SilenceGate         m_silenceGate;
+        bool                m_silenceGateEnabled = true;
+        bool                m_waitingForMusic = false;
+        qint64              m_silentBytes = 0;
+        bool                m_suspended = false;
+
+        // Track change detection, continuous mode only
+        NoveltyDetector     m_noveltyDetector;
+        bool                m_trackChangeDetection = false;
+
+        int                 m_bufferLengthInSeconds = DEFAULT_CAPTURE_LENGTH_IN_SECONDS;
+        int                 m_minBufferSize = 0; // Decimated bytes in m_bufferLengthInSeconds
+};
@@ -0,0 +1,85 @@
+#include <QStringList>
+
+#include "capture_sources.h"
+#include "pipewire/pipewire_monitor.h"
+#include "stdin_capture_source.h"
+#include "synthetic_capture_source.h"
+#include "wav_capture_source.h"
+
+static PacedCaptureSource* createPacedSource(const QString& type, const QString& argument, QString& errorString) {
+    if (type == "wav") {
+        auto* source = new WavCaptureSource();
+        if (!source->open(argument)) {
+            errorString = "Failed to open " + argument + ": " + source->getErrorString();
+            delete source;
+            return nullptr;
+        }
+
+        return source;
+    }
+
+    if (type == "stdin") {
+        const QStringList fields = argument.split(':');
+        AudioFormat format;
+        bool rateValid = false;
+        bool channelsValid = false;
+
+        if (fields.size() == 3) {
+            format.sampleRate = fields[0].toInt(&rateValid);
+            format.channels = fields[1].toInt(&channelsValid);
+        }
+
+        if (!rateValid || !channelsValid || format.sampleRate <= 0 || format.channels <= 0 ||
+            !StdinCaptureSource::parseSampleFormat(fields[2], format)) {
+            errorString = "Expected stdin:RATE:CHANNELS:FORMAT, e.g. stdin:48000:2:f32";
+            return nullptr;
+        }
+
+        return new StdinCaptureSource(format);
+    }
+
+    if (type == "synthetic") {
+        SyntheticSignal signal;
+        if (!SyntheticCaptureSource::parseSignal(argument, signal)) {
+            errorString = "Unknown synthetic signal: " + argument;
+            return nullptr;
+        }
+
+        return new SyntheticCaptureSource(signal);
+    }
+
+    errorString = "Unknown capture source: " + type;
+    return nullptr;
+}
+
+CaptureSource* createCaptureSource(const QString& spec, QString& applicationName, double speed,
+                                   QString& errorString, QObject* parent) {
+    if (spec.isEmpty() || spec == CAPTURE_SOURCE_PIPEWIRE) {
+        auto* source = new PipeWireMonitor(applicationName, parent);
+        source->setObjectName(CAPTURE_SOURCE_PIPEWIRE);
+        return source;
+    }
+
+    const qsizetype separator = spec.indexOf(':');
+    const QString type = spec.left(separator);
+    QString argument = separator < 0 ? QString() : spec.mid(separator + 1);
+
+    if (type == CAPTURE_SOURCE_PIPEWIRE) {
+        auto* source = new PipeWireMonitor(applicationName, &argument, parent);
+        source->setObjectName(spec);
+        return source;
+    }
+
+    auto* source = createPacedSource(type, argument, errorString);
+    if (source == nullptr) {
+        return nullptr;
+    }
+
+    if (speed != CAPTURE_SPEED_DEFAULT) {
+        source->setSpeed(speed);
+    }
+
+    source->setParent(parent);
+    source->setObjectName(spec);
+    return source;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+
+#include "capture_source.h"
+
+#define CAPTURE_SOURCE_PIPEWIRE QStringLiteral("pipewire")
+
+// Leaves each source at its own default speed
+#define CAPTURE_SPEED_DEFAULT -1.0
+
+/*
+ * Creates the capture source described by `spec`:
+ *
+ *   pipewire                       the default sink (the default)
+ *   pipewire:NODE                  the sink (or other node) named NODE
+ *   wav:PATH                       replays a WAV file
+ *   stdin:RATE:CHANNELS:FORMAT     raw PCM from standard input, FORMAT is
+ *                                  s16, s24, s32 or f32
+ *   synthetic:SIGNAL               silence, tone, noise or notes
+ *
+ * `speed` paces everything but PipeWire, see PacedCaptureSource. The
+ * source is named after its spec (see QObject::objectName()), which is
+ * how its results are told apart from other sources'. Returns nullptr and
+ * sets `errorString` if the spec is invalid.
+ */
+CaptureSource*  createCaptureSource(const QString& spec, QString& applicationName, double speed,
+                                    QString& errorString, QObject* parent = nullptr);
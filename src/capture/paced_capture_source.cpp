@@ -0,0 +1,70 @@
+#include <algorithm>
+
+#include "paced_capture_source.h"
+
+PacedCaptureSource::PacedCaptureSource(QObject* parent) :
+    CaptureSource(parent) {
+        m_block.resize(AUDIO_DRAIN_BLOCK_SIZE);
+}
+
+void PacedCaptureSource::setSpeed(double speed) {
+    m_speed = std::max(speed, 0.0);
+
+    // Unlimited sources drain as often as the event loop allows, unless
+    // that would only spin waiting for input
+    setDrainInterval(m_speed > 0 || !isAlwaysReady() ? AUDIO_RING_BUFFER_DRAIN_INTERVAL_MS : 0);
+}
+
+double PacedCaptureSource::getSpeed() const {
+    return m_speed;
+}
+
+/*******************************************************
+ * Stream hooks
+ *******************************************************/
+
+bool PacedCaptureSource::isAlwaysReady() const {
+    return true;
+}
+
+bool PacedCaptureSource::startStream() {
+    m_clock.start();
+    m_framesProduced = 0;
+    return true;
+}
+
+void PacedCaptureSource::stopStream() {
+    m_clock.invalidate();
+}
+
+void PacedCaptureSource::fillRingBuffer() {
+    const AudioFormat format = getStreamFormat();
+    const qsizetype bytesPerFrame = format.bytesPerFrame();
+
+    // Never write more than fits, so nothing is ever dropped
+    qsizetype budget = static_cast<qsizetype>(m_ringBuffer.getCapacity() - m_ringBuffer.getAvailable());
+
+    if (m_speed > 0) {
+        const auto framesDue = static_cast<qint64>(m_clock.nsecsElapsed() * 1e-9 * format.sampleRate * m_speed);
+        budget = std::min<qsizetype>(budget, (framesDue - m_framesProduced) * bytesPerFrame);
+    }
+
+    const qsizetype blockSize = m_block.size() - m_block.size() % bytesPerFrame;
+
+    while (budget >= bytesPerFrame) {
+        const qsizetype bytesRead = readAudio(m_block.data(), std::min(budget, blockSize));
+
+        if (bytesRead < 0) {
+            endOfInput();
+            return;
+        }
+
+        if (bytesRead == 0) {
+            return;
+        }
+
+        m_ringBuffer.write(m_block.constData(), static_cast<size_t>(bytesRead));
+        m_framesProduced += bytesRead / bytesPerFrame;
+        budget -= bytesRead;
+    }
+}
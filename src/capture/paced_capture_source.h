@@ -0,0 +1,59 @@
+#pragma once
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QObject>
+#include <qtmetamacros.h>
+
+#include "capture_source.h"
+
+#define CAPTURE_SPEED_REAL_TIME 1.0
+#define CAPTURE_SPEED_UNLIMITED 0.0
+
+/*
+ * Base for backends that make their audio on demand (files, stdin,
+ * synthetic signals) rather than having it pushed at them.
+ *
+ * Audio is pulled on the main thread before each drain, paced to the
+ * wall clock so a capture takes as long as it would live. A speed of 2
+ * plays twice as fast and CAPTURE_SPEED_UNLIMITED as fast as the ring
+ * buffer is drained, which makes throughput tests quick. Unpaced sources
+ * that always have audio are drained as often as the event loop allows.
+ */
+class PacedCaptureSource : public CaptureSource {
+    Q_OBJECT
+
+    public:
+        PacedCaptureSource(QObject* parent = nullptr);
+
+        void    setSpeed(double speed);
+        double  getSpeed() const;
+
+    protected:
+        /*
+         * Reads up to `maxSize` bytes of audio in the stream format, always
+         * a whole number of frames. Returns the number of bytes read, 0 if
+         * nothing is available right now or -1 once the input has ended.
+         */
+        virtual qsizetype   readAudio(char* data, qsizetype maxSize) = 0;
+
+        /*
+         * False for sources that wait for their audio to arrive, which are
+         * still drained on the usual timer when unpaced, rather than
+         * polled in a busy loop
+         */
+        virtual bool        isAlwaysReady() const;
+
+        bool                startStream() override;
+        void                stopStream() override;
+        void                fillRingBuffer() override;
+
+    private:
+        double              m_speed = CAPTURE_SPEED_REAL_TIME;
+
+        // Frames handed to the ring buffer since the stream started
+        QElapsedTimer       m_clock;
+        qint64              m_framesProduced = 0;
+
+        QByteArray          m_block;
+};
@@ -0,0 +1,83 @@
+#include <QDebug>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "stdin_capture_source.h"
+
+StdinCaptureSource::StdinCaptureSource(const AudioFormat& format, QObject* parent) :
+    PacedCaptureSource(parent),
+    m_format(format) {
+        // Reads must never block the event loop
+        const int flags = fcntl(STDIN_FILENO, F_GETFL);
+        if (flags < 0 || fcntl(STDIN_FILENO, F_SETFL, flags | O_NONBLOCK) < 0) {
+            qWarning() << "Failed to make standard input non-blocking:" << strerror(errno);
+        }
+
+        setSpeed(CAPTURE_SPEED_UNLIMITED);
+}
+
+bool StdinCaptureSource::parseSampleFormat(const QString& name, AudioFormat& format) {
+    if (name == "s16") {
+        format.bitsPerSample = 16;
+        format.floatingPoint = false;
+    } else if (name == "s24") {
+        format.bitsPerSample = 24;
+        format.floatingPoint = false;
+    } else if (name == "s32") {
+        format.bitsPerSample = 32;
+        format.floatingPoint = false;
+    } else if (name == "f32") {
+        format.bitsPerSample = 32;
+        format.floatingPoint = true;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+/*******************************************************
+ * Stream hooks
+ *******************************************************/
+
+qsizetype StdinCaptureSource::readAudio(char* data, qsizetype maxSize) {
+    if (m_endOfInput) {
+        return -1;
+    }
+
+    const qsizetype bytesPerFrame = m_format.bytesPerFrame();
+    const qsizetype partialSize = m_partialFrame.size();
+    memcpy(data, m_partialFrame.constData(), partialSize);
+
+    const ssize_t bytesRead = ::read(STDIN_FILENO, data + partialSize, maxSize - partialSize);
+
+    if (bytesRead < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return 0;
+        }
+
+        qWarning() << "Failed to read standard input:" << strerror(errno);
+    }
+
+    if (bytesRead <= 0) {
+        m_endOfInput = true;
+        return -1;
+    }
+
+    // Hold back any incomplete frame until the rest of it arrives
+    const qsizetype size = partialSize + bytesRead;
+    const qsizetype wholeFrames = size - size % bytesPerFrame;
+    m_partialFrame = QByteArray(data + wholeFrames, size - wholeFrames);
+
+    return wholeFrames;
+}
+
+AudioFormat StdinCaptureSource::getStreamFormat() {
+    return m_format;
+}
+
+bool StdinCaptureSource::isAlwaysReady() const {
+    return false;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+#include <qtmetamacros.h>
+
+#include "paced_capture_source.h"
+
+/*
+ * Reads raw interleaved PCM from standard input, e.g.
+ *
+ *   ffmpeg -re -i song.flac -f f32le -ac 2 -ar 48000 - | SongDetectorDaemon --source stdin:48000:2:f32
+ *
+ * Unpaced by default, the audio is taken as fast as it arrives, so pace
+ * it on the writing side. The pipe is still only read every drain
+ * interval, as an idle pipe would otherwise keep the main thread busy. Nothing is read between captures, so outside of
+ * continuous capture the audio waits in the pipe. Once standard input is
+ * closed every capture completes straight away with what is left.
+ */
+class StdinCaptureSource : public PacedCaptureSource {
+    Q_OBJECT
+
+    public:
+        StdinCaptureSource(const AudioFormat& format, QObject* parent = nullptr);
+
+        /*
+         * Parses a sample format, one of s16, s24, s32 or f32 (all little
+         * endian), into `format`
+         */
+        static bool parseSampleFormat(const QString& name, AudioFormat& format);
+
+    protected:
+        qsizetype   readAudio(char* data, qsizetype maxSize) override;
+        AudioFormat getStreamFormat() override;
+        bool        isAlwaysReady() const override;
+
+    private:
+        const AudioFormat   m_format;
+
+        // The start of a frame that was split across reads
+        QByteArray          m_partialFrame;
+        bool                m_endOfInput = false;
+};
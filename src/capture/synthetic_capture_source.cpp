@@ -0,0 +1,93 @@
+#include <cmath>
+#include <numbers>
+
+#include "synthetic_capture_source.h"
+
+#define SYNTHETIC_AMPLITUDE 0.4
+#define SYNTHETIC_TONE_FREQUENCY 440.0
+#define SYNTHETIC_NOTE_LENGTH_IN_FRAMES (SYNTHETIC_SAMPLE_RATE / 4)
+
+SyntheticCaptureSource::SyntheticCaptureSource(SyntheticSignal signal, QObject* parent) :
+    PacedCaptureSource(parent),
+    m_signal(signal) {
+}
+
+bool SyntheticCaptureSource::parseSignal(const QString& name, SyntheticSignal& signal) {
+    if (name == "silence") {
+        signal = SyntheticSignal::Silence;
+    } else if (name == "tone") {
+        signal = SyntheticSignal::Tone;
+    } else if (name == "noise") {
+        signal = SyntheticSignal::Noise;
+    } else if (name == "notes") {
+        signal = SyntheticSignal::Notes;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+/*******************************************************
+ * Stream hooks
+ *******************************************************/
+
+qsizetype SyntheticCaptureSource::readAudio(char* data, qsizetype maxSize) {
+    const qsizetype frames = maxSize / getStreamFormat().bytesPerFrame();
+    auto* samples = reinterpret_cast<float*>(data);
+
+    for (qsizetype frame = 0; frame < frames; frame++) {
+        const float sample = nextSample();
+
+        for (int channel = 0; channel < SYNTHETIC_CHANNELS; channel++) {
+            *samples++ = sample;
+        }
+    }
+
+    return frames * getStreamFormat().bytesPerFrame();
+}
+
+AudioFormat SyntheticCaptureSource::getStreamFormat() {
+    AudioFormat format;
+    format.sampleRate = SYNTHETIC_SAMPLE_RATE;
+    format.bitsPerSample = 32;
+    format.channels = SYNTHETIC_CHANNELS;
+    format.floatingPoint = true;
+    return format;
+}
+
+/*******************************************************
+ * Private methods
+ *******************************************************/
+
+float SyntheticCaptureSource::nextSample() {
+    const qint64 frame = m_frame++;
+
+    switch (m_signal) {
+        case SyntheticSignal::Silence:
+            return 0.0f;
+
+        case SyntheticSignal::Tone: {
+            const double time = static_cast<double>(frame) / SYNTHETIC_SAMPLE_RATE;
+            return static_cast<float>(SYNTHETIC_AMPLITUDE * std::sin(2 * std::numbers::pi * SYNTHETIC_TONE_FREQUENCY * time));
+        }
+
+        case SyntheticSignal::Noise: {
+            std::uniform_real_distribution<float> noise(-SYNTHETIC_AMPLITUDE, SYNTHETIC_AMPLITUDE);
+            return noise(m_random);
+        }
+
+        case SyntheticSignal::Notes: {
+            if (frame - m_noteStart >= SYNTHETIC_NOTE_LENGTH_IN_FRAMES) {
+                std::uniform_real_distribution<double> pitch(200.0, 4000.0);
+                m_frequency = pitch(m_random);
+                m_noteStart = frame;
+            }
+
+            const double time = static_cast<double>(frame - m_noteStart) / SYNTHETIC_SAMPLE_RATE;
+            return static_cast<float>(SYNTHETIC_AMPLITUDE * std::exp(-6.0 * time) * std::sin(2 * std::numbers::pi * m_frequency * time));
+        }
+    }
+
+    return 0.0f;
+}
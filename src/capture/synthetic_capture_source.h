@@ -0,0 +1,50 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <qtmetamacros.h>
+#include <random>
+
+#include "paced_capture_source.h"
+
+#define SYNTHETIC_SAMPLE_RATE 48000
+#define SYNTHETIC_CHANNELS 2
+
+enum class SyntheticSignal {
+    Silence,
+    Tone,       // 440Hz sine
+    Noise,      // White noise
+    Notes       // Decaying notes at random pitches, gives the fingerprinter peaks to find
+};
+
+/*
+ * Generates a test signal, as 48kHz stereo F32 like a typical PipeWire
+ * sink, so it goes through the same decimation as live audio. Random
+ * signals are seeded, so every run generates the same audio.
+ */
+class SyntheticCaptureSource : public PacedCaptureSource {
+    Q_OBJECT
+
+    public:
+        SyntheticCaptureSource(SyntheticSignal signal, QObject* parent = nullptr);
+
+        /*
+         * Parses a signal name: silence, tone, noise or notes
+         */
+        static bool parseSignal(const QString& name, SyntheticSignal& signal);
+
+    protected:
+        qsizetype   readAudio(char* data, qsizetype maxSize) override;
+        AudioFormat getStreamFormat() override;
+
+    private:
+        float       nextSample();
+
+        const SyntheticSignal   m_signal;
+        std::mt19937            m_random{1234};
+
+        // Frames generated so far, and where the current note started
+        qint64                  m_frame = 0;
+        qint64                  m_noteStart = 0;
+        double                  m_frequency = 440.0;
+};
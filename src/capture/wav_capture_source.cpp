@@ -0,0 +1,50 @@
+#include <QDebug>
+
+#include "wav_capture_source.h"
+
+WavCaptureSource::WavCaptureSource(QObject* parent) :
+    PacedCaptureSource(parent) {
+}
+
+bool WavCaptureSource::open(const QString& path) {
+    if (!m_reader.open(path)) {
+        return false;
+    }
+
+    if (m_reader.getFrameCount() == 0) {
+        m_reader.close();
+        return false;
+    }
+
+    qInfo() << "Capturing from" << path;
+    return true;
+}
+
+QString WavCaptureSource::getErrorString() const {
+    if (m_reader.getErrorString().isEmpty()) {
+        return "No audio in file";
+    }
+
+    return m_reader.getErrorString();
+}
+
+/*******************************************************
+ * Stream hooks
+ *******************************************************/
+
+qsizetype WavCaptureSource::readAudio(char* data, qsizetype maxSize) {
+    qsizetype bytesRead = m_reader.read(data, maxSize);
+
+    if (bytesRead == 0) {
+        // Loop back to the start
+        m_reader.seek(0);
+        bytesRead = m_reader.read(data, maxSize);
+    }
+
+    // Don't loop over a file that can't be read
+    return bytesRead > 0 ? bytesRead : -1;
+}
+
+AudioFormat WavCaptureSource::getStreamFormat() {
+    return m_reader.getFormat();
+}
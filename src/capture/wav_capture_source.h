@@ -0,0 +1,32 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <qtmetamacros.h>
+
+#include "audio/wav_reader.h"
+#include "paced_capture_source.h"
+
+/*
+ * Plays a WAV file as if it were coming out of the speakers.
+ *
+ * The file only advances while capturing, so every run over the same file
+ * hears exactly the same audio, and it loops at the end, so it can answer
+ * any number of captures.
+ */
+class WavCaptureSource : public PacedCaptureSource {
+    Q_OBJECT
+
+    public:
+        WavCaptureSource(QObject* parent = nullptr);
+
+        bool        open(const QString& path);
+        QString     getErrorString() const;
+
+    protected:
+        qsizetype   readAudio(char* data, qsizetype maxSize) override;
+        AudioFormat getStreamFormat() override;
+
+    private:
+        WavReader   m_reader;
+};
@@ -0,0 +1,174 @@
+#include <QDebug>
+#include <QDir>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QStandardPaths>
+
+#include "control_server.h"
+#include "latency_stats.h"
+#include "process_stats.h"
+#include "trace.h"
+
+// A client that sends this much without a newline is dropped
+#define CONTROL_MAX_LINE_LENGTH 1024
+
+ControlServer::ControlServer(SongIdentifier* identifier, QObject* parent) :
+    QObject(parent),
+    m_identifier(identifier),
+    m_server(this) {
+        // Only the user running the daemon may control it
+        m_server.setSocketOptions(QLocalServer::UserAccessOption);
+
+        connect(&m_server, &QLocalServer::newConnection, this, &ControlServer::onNewConnection);
+        connect(m_identifier, &SongIdentifier::identified, this, &ControlServer::onIdentified);
+        connect(m_identifier, &SongIdentifier::notIdentified, this, &ControlServer::onNotIdentified);
+        connect(m_identifier, &SongIdentifier::trackChanged, this, &ControlServer::onTrackChanged);
+}
+
+bool ControlServer::listen(const QString& path) {
+    // Clear up after a daemon that didn't exit cleanly
+    QLocalServer::removeServer(path);
+
+    if (!m_server.listen(path)) {
+        qWarning() << "Failed to listen on" << path << m_server.errorString();
+        return false;
+    }
+
+    qInfo() << "Listening on" << m_server.fullServerName();
+    return true;
+}
+
+void ControlServer::setStartupTime(qint64 milliseconds) {
+    m_startupTime = milliseconds;
+}
+
+QString ControlServer::defaultPath() {
+    QString directory = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+    if (directory.isEmpty()) {
+        directory = QDir::tempPath();
+    }
+
+    return QDir(directory).filePath(CONTROL_SOCKET_NAME);
+}
+
+/*
+ * Slots
+ */
+void ControlServer::onNewConnection() {
+    while (auto* client = m_server.nextPendingConnection()) {
+        m_clients.append(client);
+
+        connect(client, &QLocalSocket::disconnected, this, [this, client] {
+            m_clients.removeOne(client);
+            client->deleteLater();
+        });
+
+        connect(client, &QLocalSocket::readyRead, this, [this, client] {
+            while (client->canReadLine()) {
+                handleCommand(client, client->readLine().trimmed());
+            }
+
+            if (client->bytesAvailable() > CONTROL_MAX_LINE_LENGTH) {
+                client->abort();
+            }
+        });
+    }
+}
+
+void ControlServer::onIdentified(const ShazamResponse& response, const QString& source) {
+    QJsonObject message;
+    message["event"] = "identified";
+    message["source"] = source;
+    message["title"] = response.getTitle();
+    message["artist"] = response.getArtist();
+    message["album"] = response.getAlbum();
+    message["track"] = response.getTrack();
+    message["key"] = response.getKey();
+    message["released"] = response.getReleaseDate();
+
+    // Only Shazam knows where in the track the match was
+    if (response.getOffset() >= 0) {
+        message["offset"] = response.getOffset();
+    }
+
+    broadcast(message);
+}
+
+void ControlServer::onNotIdentified(const QString& source) {
+    broadcast({ { "event", "notIdentified" }, { "source", source } });
+}
+
+void ControlServer::onTrackChanged(const QString& source) {
+    broadcast({ { "event", "trackChanged" }, { "source", source } });
+}
+
+/*******************************************************
+ * Private methods
+ *******************************************************/
+
+void ControlServer::handleCommand(QLocalSocket* client, const QByteArray& command) {
+    if (command.isEmpty()) {
+        return;
+    }
+
+    if (command == "identify") {
+        m_identifier->identify();
+        broadcast({ { "event", "identifying" } });
+    } else if (command.startsWith("identify ")) {
+        const auto source = QString::fromUtf8(command.mid(9));
+        if (!m_identifier->identify(source)) {
+            send(client, { { "event", "error" }, { "message", "Unknown capture source: " + source } });
+        } else {
+            broadcast({ { "event", "identifying" }, { "source", source } });
+        }
+    } else if (command == "start") {
+        m_identifier->setContinuousCapture(true);
+        broadcast({ { "event", "listening" } });
+    } else if (command == "stop") {
+        m_identifier->stop();
+        m_identifier->setContinuousCapture(false);
+        broadcast({ { "event", "stopped" } });
+    } else if (command == "status") {
+        QJsonObject message;
+        message["event"] = "status";
+        message["continuous"] = m_identifier->isContinuousCapture();
+        message["suspended"] = m_identifier->isCaptureSuspended();
+        message["autoIdentify"] = m_identifier->isAutoIdentify();
+        message["sources"] = QJsonArray::fromStringList(m_identifier->getSources());
+        message["bufferAllocations"] = static_cast<qint64>(m_identifier->getBufferAllocations());
+        message["clients"] = static_cast<int>(m_clients.size());
+        message["startupMs"] = m_startupTime;
+        message["rssKiB"] = residentSetSizeInKiB();
+        message["peakRssKiB"] = peakResidentSetSizeInKiB();
+        send(client, message);
+    } else if (command == "stats") {
+        const auto& shazam = m_identifier->getShazam();
+
+        QJsonObject lookups;
+        lookups["cacheHits"] = static_cast<qint64>(shazam.getCacheHits());
+        lookups["cacheMisses"] = static_cast<qint64>(shazam.getCacheMisses());
+        lookups["hedged"] = static_cast<qint64>(shazam.getHedged());
+        lookups["hedgeWins"] = static_cast<qint64>(shazam.getHedgeWins());
+
+        send(client, { { "event", "stats" }, { "stages", latencyStatsToJson() }, { "lookups", lookups } });
+    } else if (command == "trace") {
+        if (!isTracing()) {
+            send(client, { { "event", "error" }, { "message", "Not tracing, set " TRACE_ENVIRONMENT_VARIABLE } });
+        } else {
+            send(client, { { "event", "trace" }, { "written", writeTrace() } });
+        }
+    } else {
+        send(client, { { "event", "error" }, { "message", "Unknown command: " + QString::fromUtf8(command) } });
+    }
+}
+
+void ControlServer::send(QLocalSocket* client, const QJsonObject& message) {
+    client->write(QJsonDocument(message).toJson(QJsonDocument::Compact));
+    client->write("\n");
+}
+
+void ControlServer::broadcast(const QJsonObject& message) {
+    for (auto* client : m_clients) {
+        send(client, message);
+    }
+}
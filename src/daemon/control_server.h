@@ -0,0 +1,67 @@
+#pragma once
+
+#include <QJsonObject>
+#include <QList>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QObject>
+#include <QString>
+#include <qtmetamacros.h>
+
+#include "song_identifier.h"
+
+#define CONTROL_SOCKET_NAME QStringLiteral("SongDetector.sock")
+
+/*
+ * Unix domain socket for controlling the daemon.
+ *
+ * Clients send one command per line:
+ *
+ *   identify    identify what is playing, on every capture source or
+ *               just the one named after it ("identify pipewire")
+ *   start       keep listening in the background (continuous capture)
+ *   stop        stop listening and abandon any identification
+ *   status      report the daemon's state and footprint
+ *   stats       report the latency of each identification stage
+ *   trace       write out the trace so far, when tracing (see trace.h)
+ *
+ * Every reply and result is a line of JSON with an "event" field. Results
+ * are sent to every connected client, so a client can just stay connected
+ * to follow them. With auto identify on, a "trackChanged" event comes
+ * before each result that wasn't asked for. Results and track changes
+ * carry the name of the capture source they came from in "source".
+ */
+class ControlServer : public QObject {
+    Q_OBJECT
+
+    public:
+        ControlServer(SongIdentifier* identifier, QObject* parent);
+
+        bool    listen(const QString& path);
+
+        /*
+         * Reported by the status command
+         */
+        void    setStartupTime(qint64 milliseconds);
+
+        /*
+         * Default socket path, in the user's runtime directory
+         */
+        static QString  defaultPath();
+
+    private slots:
+        void    onNewConnection();
+        void    onIdentified(const ShazamResponse& response, const QString& source);
+        void    onNotIdentified(const QString& source);
+        void    onTrackChanged(const QString& source);
+
+    private:
+        void    handleCommand(QLocalSocket* client, const QByteArray& command);
+        void    send(QLocalSocket* client, const QJsonObject& message);
+        void    broadcast(const QJsonObject& message);
+
+        SongIdentifier*         m_identifier;
+        QLocalServer            m_server;
+        QList<QLocalSocket*>    m_clients;
+        qint64                  m_startupTime = -1;
+};
@@ -0,0 +1,118 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QList>
+#include <QLockFile>
+#include <QSettings>
+#include <QTimer>
+
+#include "capture/capture_sources.h"
+#include "control_server.h"
+#include "metrics_server.h"
+#include "process_stats.h"
+#include "song_identifier.h"
+#include "trace.h"
+
+#define APPLICATION_NAME QStringLiteral("SongDetector")
+
+/*
+ * SongDetectorDaemon, the headless build. Only links QtCore, QtNetwork
+ * and PipeWire, and is controlled over a Unix domain socket (see
+ * ControlServer).
+ */
+int main(int argc, char *argv[])
+{
+    QElapsedTimer startup;
+    startup.start();
+
+    QCoreApplication app(argc, argv);
+
+    // Same name as the tray app, so they share their settings
+    QCoreApplication::setOrganizationName(APPLICATION_NAME);
+    QCoreApplication::setApplicationName(APPLICATION_NAME);
+    startTracingFromEnvironment();
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless SongDetector, controlled over a Unix domain socket");
+    parser.addHelpOption();
+    parser.addOption({ "socket", "Path of the control socket.", "path", ControlServer::defaultPath() });
+    parser.addOption({ "source", "Where to capture audio from: pipewire, pipewire:NODE, wav:PATH, "
+                                 "stdin:RATE:CHANNELS:FORMAT or synthetic:SIGNAL. Repeat to identify from several "
+                                 "sources at once (default: the captureSources setting, or pipewire).", "spec" });
+    parser.addOption({ "capture-speed", "How fast to play anything but PipeWire, 1 is real time and 0 "
+                                        "as fast as possible.", "factor" });
+    parser.addOption({ "metrics-port", "Serve latency histograms for Prometheus on this localhost port.", "port" });
+    parser.process(app);
+
+    double speed = CAPTURE_SPEED_DEFAULT;
+    if (parser.isSet("capture-speed")) {
+        bool valid = false;
+        speed = parser.value("capture-speed").toDouble(&valid);
+
+        if (!valid || speed < 0) {
+            qWarning() << "Invalid capture speed:" << parser.value("capture-speed");
+            return 1;
+        }
+    }
+
+    quint16 metricsPort = 0;
+    if (parser.isSet("metrics-port")) {
+        bool valid = false;
+        metricsPort = parser.value("metrics-port").toUShort(&valid);
+
+        if (!valid || metricsPort == 0) {
+            qWarning() << "Invalid metrics port:" << parser.value("metrics-port");
+            return 1;
+        }
+    }
+
+    // Only one daemon at a time
+    QLockFile lockFile(QDir::temp().absoluteFilePath(APPLICATION_NAME + "Daemon.lock"));
+    if (!lockFile.tryLock(100)) {
+        qWarning() << "SongDetectorDaemon is already running";
+        return 1;
+    }
+
+    QString applicationName = APPLICATION_NAME;
+    QList<CaptureSource*> captureSources;
+    for (const auto& spec : parser.values("source")) {
+        QString errorString;
+        auto* captureSource = createCaptureSource(spec, applicationName, speed, errorString);
+        if (captureSource == nullptr) {
+            qWarning() << errorString;
+            qDeleteAll(captureSources);
+            return 1;
+        }
+
+        captureSources.append(captureSource);
+    }
+
+    // Without --source the settings say where to capture from
+    QSettings settings;
+    SongIdentifier identifier(APPLICATION_NAME, &settings, &app, captureSources.value(0));
+    for (qsizetype i = 1; i < captureSources.size(); i++) {
+        identifier.addCaptureSource(captureSources[i]);
+    }
+    ControlServer server(&identifier, &app);
+
+    if (!server.listen(parser.value("socket"))) {
+        return 1;
+    }
+
+    MetricsServer metricsServer(&app);
+    if (parser.isSet("metrics-port") && !metricsServer.listen(metricsPort)) {
+        return 1;
+    }
+
+    // Report once the event loop is up, which is when commands are served
+    QTimer::singleShot(0, &app, [&server, &startup] {
+        server.setStartupTime(startup.elapsed());
+        qInfo() << "Started in" << startup.elapsed() << "ms," << residentSetSizeInKiB() << "KiB resident";
+    });
+
+    const int result = app.exec();
+    writeTrace();
+    return result;
+}
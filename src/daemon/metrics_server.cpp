@@ -0,0 +1,55 @@
+#include <QDebug>
+#include <QHostAddress>
+#include <QTcpSocket>
+
+#include "latency_stats.h"
+#include "metrics_server.h"
+
+// A client that sends this much without finishing its request is dropped
+#define METRICS_MAX_REQUEST_SIZE 8192
+
+MetricsServer::MetricsServer(QObject* parent) :
+    QObject(parent),
+    m_server(this) {
+        connect(&m_server, &QTcpServer::newConnection, this, &MetricsServer::onNewConnection);
+}
+
+bool MetricsServer::listen(quint16 port) {
+    if (!m_server.listen(QHostAddress::LocalHost, port)) {
+        qWarning() << "Failed to serve metrics on port" << port << m_server.errorString();
+        return false;
+    }
+
+    qInfo().noquote() << QStringLiteral("Serving metrics on http://localhost:%1/metrics").arg(m_server.serverPort());
+    return true;
+}
+
+/*
+ * Slots
+ */
+void MetricsServer::onNewConnection() {
+    while (auto* client = m_server.nextPendingConnection()) {
+        connect(client, &QTcpSocket::disconnected, client, &QObject::deleteLater);
+
+        connect(client, &QTcpSocket::readyRead, this, [client] {
+            // Wait for the end of the request headers, the request
+            // itself doesn't matter
+            if (!client->peek(METRICS_MAX_REQUEST_SIZE).contains("\r\n\r\n")) {
+                if (client->bytesAvailable() >= METRICS_MAX_REQUEST_SIZE) {
+                    client->abort();
+                }
+                return;
+            }
+
+            client->readAll();
+
+            const QByteArray body = latencyStatsToPrometheus();
+            client->write("HTTP/1.1 200 OK\r\n"
+                          "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                          "Connection: close\r\n"
+                          "Content-Length: " + QByteArray::number(body.size()) + "\r\n\r\n");
+            client->write(body);
+            client->disconnectFromHost();
+        });
+    }
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <QObject>
+#include <QTcpServer>
+#include <qtmetamacros.h>
+
+/*
+ * Minimal HTTP endpoint for Prometheus to scrape. Every request, whatever
+ * its path, gets the latency histograms (see latency_stats.h) in the text
+ * exposition format. Only listens on the loopback interface.
+ */
+class MetricsServer : public QObject {
+    Q_OBJECT
+
+    public:
+        MetricsServer(QObject* parent);
+
+        bool    listen(quint16 port);
+
+    private slots:
+        void    onNewConnection();
+
+    private:
+        QTcpServer  m_server;
+};
@@ -0,0 +1,122 @@
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numbers>
+
+#include "fft_plan.h"
+
+/*
+ * Plain complex multiply. std::complex's operator* goes through a slow
+ * library call to handle infinities and NaNs, which can't occur here.
+ */
+static inline std::complex<float> multiply(const std::complex<float>& a, const std::complex<float>& b) {
+    return std::complex<float>(
+        a.real() * b.real() - a.imag() * b.imag(),
+        a.real() * b.imag() + a.imag() * b.real());
+}
+
+/*
+ * A real FFT of size N is computed as a complex FFT of size N/2 over the
+ * even/odd sample pairs, followed by a split step that untangles the two
+ * interleaved spectra.
+ */
+RealFftPlan::RealFftPlan(size_t size) :
+    m_size(size),
+    m_halfSize(size / 2),
+    m_bitReversal(size / 2),
+    m_twiddles(size / 4),
+    m_realTwiddles(size / 2 + 1) {
+        const size_t n = m_halfSize;
+
+        int bits = 0;
+        while ((size_t(1) << bits) < n) {
+            bits++;
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            uint32_t reversed = 0;
+            for (int bit = 0; bit < bits; bit++) {
+                if (i & (size_t(1) << bit)) {
+                    reversed |= 1u << (bits - 1 - bit);
+                }
+            }
+            m_bitReversal[i] = reversed;
+        }
+
+        // Calculated in double precision, then stored as float
+        for (size_t i = 0; i < n / 2; i++) {
+            const double angle = -2.0 * std::numbers::pi * static_cast<double>(i) / static_cast<double>(n);
+            m_twiddles[i] = std::complex<float>(std::cos(angle), std::sin(angle));
+        }
+
+        for (size_t k = 0; k <= n; k++) {
+            const double angle = -2.0 * std::numbers::pi * static_cast<double>(k) / static_cast<double>(size);
+            m_realTwiddles[k] = std::complex<float>(std::cos(angle), std::sin(angle));
+        }
+}
+
+void RealFftPlan::forward(const float* input, std::complex<float>* output, std::complex<float>* scratch) const {
+    const size_t n = m_halfSize;
+
+    // Pack pairs of real samples into complex values, in bit reversed order
+    for (size_t i = 0; i < n; i++) {
+        const uint32_t j = m_bitReversal[i];
+        scratch[j] = std::complex<float>(input[2 * i], input[2 * i + 1]);
+    }
+
+    complexForward(scratch);
+
+    // Split into the spectrum of the real input
+    for (size_t k = 0; k <= n; k++) {
+        const auto z = scratch[k % n];
+        const auto zMirror = std::conj(scratch[(n - k) % n]);
+
+        const auto even = 0.5f * (z + zMirror);
+        const auto difference = z - zMirror;
+
+        // -i/2 * difference
+        const auto odd = std::complex<float>(0.5f * difference.imag(), -0.5f * difference.real());
+        output[k] = even + multiply(m_realTwiddles[k], odd);
+    }
+}
+
+size_t RealFftPlan::getSize() const {
+    return m_size;
+}
+
+const RealFftPlan& RealFftPlan::forSize(size_t size) {
+    static std::mutex mutex;
+    static std::map<size_t, std::unique_ptr<RealFftPlan>> plans;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& plan = plans[size];
+    if (!plan) {
+        plan = std::make_unique<RealFftPlan>(size);
+    }
+
+    return *plan;
+}
+
+/*******************************************************
+ * Private methods
+ *******************************************************/
+
+void RealFftPlan::complexForward(std::complex<float>* data) const {
+    const size_t n = m_halfSize;
+
+    // Input is already in bit reversed order
+    for (size_t length = 2; length <= n; length <<= 1) {
+        const size_t half = length / 2;
+        const size_t twiddleStride = n / length;
+
+        for (size_t i = 0; i < n; i += length) {
+            for (size_t j = 0; j < half; j++) {
+                const auto even = data[i + j];
+                const auto odd = multiply(data[i + j + half], m_twiddles[j * twiddleStride]);
+                data[i + j] = even + odd;
+                data[i + j + half] = even - odd;
+            }
+        }
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Precomputed plan for a forward FFT of real input.
+ *
+ * All of the twiddle factors and the bit reversal permutation are worked
+ * out once in the constructor. A plan is immutable after construction, so
+ * one plan can be shared by any number of threads. Each caller provides its
+ * own scratch buffer.
+ */
+class RealFftPlan {
+    public:
+        explicit RealFftPlan(size_t size);
+
+        /*
+         * Transforms `size` real samples into `size / 2 + 1` complex bins.
+         * `scratch` must hold at least `size / 2` values.
+         */
+        void    forward(const float* input, std::complex<float>* output, std::complex<float>* scratch) const;
+
+        size_t  getSize() const;
+
+        /*
+         * Shared plan for a given size, created on first use
+         */
+        static const RealFftPlan&   forSize(size_t size);
+
+    private:
+        void    complexForward(std::complex<float>* data) const;
+
+        const size_t                        m_size;
+        const size_t                        m_halfSize;
+        std::vector<uint32_t>               m_bitReversal;
+        std::vector<std::complex<float>>    m_twiddles;
+        std::vector<std::complex<float>>    m_realTwiddles;
+};
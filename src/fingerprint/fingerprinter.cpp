@@ -0,0 +1,201 @@
+#include <QDebug>
+#include <QFutureWatcher>
+#include <QtGlobal>
+#include <QThread>
+#include <QtConcurrent/QtConcurrentRun>
+#include <vibra.h>
+
+#include "fingerprinter.h"
+#include "trace.h"
+
+Fingerprinter::Fingerprinter(QObject* parent) : QObject(parent) {
+    m_threadPool.setMaxThreadCount(QThread::idealThreadCount());
+
+    // Every new thread claims another trace buffer, keep the idle ones
+    if (isTracing()) {
+        m_threadPool.setExpiryTimeout(-1);
+    }
+
+    m_streamContext.moveToThread(&m_streamThread);
+    m_streamThread.setObjectName("Fingerprinter");
+    m_streamThread.start();
+}
+
+Fingerprinter::~Fingerprinter() {
+    // Don't let a worker outlive the object it reports back to
+    m_streamThread.quit();
+    m_streamThread.wait();
+    m_threadPool.waitForDone();
+}
+
+void Fingerprinter::fingerprint(const QByteArray& audioBuffer, const AudioFormat& format, int lengthInSeconds, int source, quint64 generation) {
+    auto* watcher = new QFutureWatcher<FingerprintResult>(this);
+
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher] {
+        TraceSpan span("fingerprintReady", "fingerprint");
+        fingerprintReady(watcher->result());
+        watcher->deleteLater();
+    });
+
+    const auto traceId = traceNextId();
+    traceFlowBegin("fingerprint", traceId);
+
+    watcher->setFuture(QtConcurrent::run(&m_threadPool, [audioBuffer, format, lengthInSeconds, source, generation, engine = m_engine, traceId] {
+        TraceSpan span("fingerprint", "fingerprint");
+        traceFlowEnd("fingerprint", traceId);
+
+        auto result = generate(audioBuffer, format, lengthInSeconds, engine);
+        result.source = source;
+        result.generation = generation;
+        return result;
+    }));
+}
+
+void Fingerprinter::setEngine(FingerprintEngine engine) {
+    m_engine = engine;
+}
+
+FingerprintResult Fingerprinter::generate(const QByteArray& audioBuffer, const AudioFormat& format, int lengthInSeconds, FingerprintEngine engine) {
+    FingerprintResult result;
+    result.lengthInSeconds = lengthInSeconds;
+
+    if (engine == FingerprintEngine::Native) {
+        result.uri = generateNative(audioBuffer, format);
+    } else {
+        result.uri = generateWithVibra(audioBuffer, format);
+    }
+
+    // Conformance check, run both engines and compare their signatures
+    if (qEnvironmentVariableIsSet("SONGDETECTOR_ENGINE_CHECK")) {
+        const auto otherUri = engine == FingerprintEngine::Native ?
+            generateWithVibra(audioBuffer, format) :
+            generateNative(audioBuffer, format);
+
+        if (otherUri != result.uri) {
+            qWarning() << "Native and vibra signatures differ:" << result.uri.size() << "vs" << otherUri.size() << "characters";
+        } else {
+            qInfo() << "Native and vibra signatures match";
+        }
+    }
+
+    return result;
+}
+
+QString Fingerprinter::generateWithVibra(const QByteArray& audioBuffer, const AudioFormat& format) {
+    const auto fp = vibra_get_fingerprint_from_signed_pcm(
+        audioBuffer.constData(),
+        audioBuffer.size(),
+        format.sampleRate,
+        format.bitsPerSample,
+        format.channels
+    );
+
+    return QString::fromUtf8(vibra_get_uri_from_fingerprint(fp));
+}
+
+QString Fingerprinter::generateNative(const QByteArray& audioBuffer, const AudioFormat& format) {
+    // One generator per worker thread, so its spectrum history is
+    // allocated once rather than for every capture
+    thread_local StreamingFingerprinter fingerprinter;
+
+    fingerprinter.reset();
+    fingerprinter.feed(audioBuffer.constData(), audioBuffer.size(), format);
+    return fingerprinter.getSignature().encodeToUri();
+}
+
+/*******************************************************
+ * Chunked API
+ *******************************************************/
+
+void Fingerprinter::startStream(int source, quint64 generation, const QList<int>& checkpointsInSeconds) {
+    QMetaObject::invokeMethod(&m_streamContext, [this, source, generation, checkpointsInSeconds, engine = m_engine] {
+        TraceSpan span("startStream", "fingerprint");
+
+        // A source's stream is kept from one capture to the next, so its
+        // spectrum history (or audio) is only allocated once
+        auto& stream = m_streams[source];
+        stream.engine = engine;
+        stream.fingerprinter.reset();
+        stream.audio.clear();
+        stream.checkpoints = checkpointsInSeconds;
+        stream.generation = generation;
+    }, Qt::QueuedConnection);
+}
+
+void Fingerprinter::feedStream(int source, const QByteArray& chunk, const AudioFormat& format) {
+    const auto traceId = traceNextId();
+    traceFlowBegin("feedStream", traceId);
+
+    QMetaObject::invokeMethod(&m_streamContext, [this, source, chunk, format, traceId] {
+        TraceSpan span("feedStream", "fingerprint");
+        traceFlowEnd("feedStream", traceId);
+
+        auto& stream = m_streams[source];
+        if (stream.engine == FingerprintEngine::Native) {
+            stream.fingerprinter.feed(chunk.constData(), chunk.size(), format);
+        } else {
+            stream.audio.append(chunk);
+            stream.format = format;
+        }
+
+        if (stream.checkpoints.isEmpty() ||
+            stream.lengthInMilliseconds() < stream.checkpoints.first() * 1000) {
+            return;
+        }
+
+        FingerprintResult result;
+        result.uri = stream.encodeToUri();
+        result.lengthInSeconds = stream.checkpoints.takeFirst();
+        result.partial = true;
+        result.source = source;
+        result.generation = stream.generation;
+        streamReady(result);
+    }, Qt::QueuedConnection);
+}
+
+void Fingerprinter::finishStream(int source, int lengthInSeconds) {
+    const auto traceId = traceNextId();
+    traceFlowBegin("finishStream", traceId);
+
+    QMetaObject::invokeMethod(&m_streamContext, [this, source, lengthInSeconds, traceId] {
+        TraceSpan span("finishStream", "fingerprint");
+        traceFlowEnd("finishStream", traceId);
+
+        const auto& stream = m_streams[source];
+
+        FingerprintResult result;
+        result.uri = stream.encodeToUri();
+        result.lengthInSeconds = lengthInSeconds;
+        result.source = source;
+        result.generation = stream.generation;
+        streamReady(result);
+    }, Qt::QueuedConnection);
+}
+
+qint64 Fingerprinter::Stream::lengthInMilliseconds() const {
+    if (engine == FingerprintEngine::Native) {
+        return fingerprinter.getSignature().getLengthInMilliseconds();
+    }
+
+    return format.bytesPerFrame() > 0 ? audio.size() / format.bytesPerFrame() * 1000 / format.sampleRate : 0;
+}
+
+QString Fingerprinter::Stream::encodeToUri() const {
+    if (engine == FingerprintEngine::Native) {
+        return fingerprinter.getSignature().encodeToUri();
+    }
+
+    return generateWithVibra(audio, format);
+}
+
+void Fingerprinter::streamReady(const FingerprintResult& result) {
+    // Hop back to our own thread to report the result
+    const auto readyTraceId = traceNextId();
+    traceFlowBegin("fingerprintReady", readyTraceId);
+
+    QMetaObject::invokeMethod(this, [this, result, readyTraceId] {
+        TraceSpan span("fingerprintReady", "fingerprint");
+        traceFlowEnd("fingerprintReady", readyTraceId);
+        fingerprintReady(result);
+    }, Qt::QueuedConnection);
+}
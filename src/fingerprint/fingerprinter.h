@@ -0,0 +1,125 @@
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QThread>
+#include <QThreadPool>
+#include <qtmetamacros.h>
+#include <unordered_map>
+
+#include "audio/audio_format.h"
+#include "streaming_fingerprinter.h"
+
+struct FingerprintResult {
+    // Shazam signature in data URI form
+    QString     uri;
+
+    // Length of the audio the signature was generated from
+    int         lengthInSeconds = 0;
+
+    // True for the early signatures sent by progressive identification,
+    // while the capture is still running
+    bool        partial = false;
+
+    // Capture source the audio came from, and the identification it was
+    // captured for, as passed to the Fingerprinter. A result can still be
+    // on its way when the next identification starts, the generation
+    // tells the two apart.
+    int         source = 0;
+    quint64     generation = 0;
+};
+
+enum class FingerprintEngine {
+    // The external vibra library
+    Vibra,
+
+    // The in-tree SignatureGenerator
+    Native
+};
+
+/*
+ * Fingerprinting stage of the identification pipeline.
+ *
+ * The FFTs over a full capture take long enough to freeze the tray menu,
+ * so the work is done on a private thread pool and the result is delivered
+ * back on the thread that owns the Fingerprinter via fingerprintReady().
+ *
+ * There are two ways in: fingerprint() takes a complete capture in one go,
+ * while the stream functions take the audio chunk by chunk as it is
+ * captured. The native engine fingerprints each chunk as it arrives, so
+ * the signature is ready moments after the last chunk. Vibra can only
+ * fingerprint audio in one go, so the stream keeps the audio and runs
+ * vibra over all of it at each checkpoint and at the end.
+ *
+ * One Fingerprinter serves any number of capture sources, each with its
+ * own stream. Every result carries the source it was generated for.
+ */
+class Fingerprinter : public QObject {
+    Q_OBJECT
+
+    public:
+        Fingerprinter(QObject* parent);
+        ~Fingerprinter();
+
+        void    fingerprint(const QByteArray& audioBuffer, const AudioFormat& format, int lengthInSeconds, int source = 0, quint64 generation = 0);
+
+        /*
+         * Engine used by fingerprint(), and by streams started after this
+         */
+        void    setEngine(FingerprintEngine engine);
+
+        /*
+         * Chunked API
+         *
+         * A partial fingerprint is reported as the stream passes each of
+         * `checkpointsInSeconds`, without waiting for finishStream(). Every
+         * result until the next startStream() carries `generation`.
+         */
+        void    startStream(int source, quint64 generation, const QList<int>& checkpointsInSeconds = {});
+        void    feedStream(int source, const QByteArray& chunk, const AudioFormat& format);
+        void    finishStream(int source, int lengthInSeconds);
+
+    signals:
+        void    fingerprintReady(const FingerprintResult& result);
+
+    private:
+        QThreadPool         m_threadPool;
+        FingerprintEngine   m_engine = FingerprintEngine::Vibra;
+
+        struct Stream {
+            FingerprintEngine       engine = FingerprintEngine::Native;
+            StreamingFingerprinter  fingerprinter;
+
+            // Everything fed in so far, vibra only
+            QByteArray              audio;
+            AudioFormat             format;
+
+            QList<int>              checkpoints;
+            quint64                 generation = 0;
+
+            qint64                  lengthInMilliseconds() const;
+            QString                 encodeToUri() const;
+        };
+
+        // Streaming fingerprints are generated in order on their own thread,
+        // which every source shares. m_streamContext lives on m_streamThread
+        // and is only used to queue work onto it, and m_streams (source ->
+        // stream) is only used from there.
+        QThread                             m_streamThread;
+        QObject                             m_streamContext;
+        std::unordered_map<int, Stream>     m_streams;
+
+        /*
+         * Called on m_streamThread, raises fingerprintReady() on ours
+         */
+        void    streamReady(const FingerprintResult& result);
+
+        /*
+         * Runs on a worker thread
+         */
+        static FingerprintResult    generate(const QByteArray& audioBuffer, const AudioFormat& format, int lengthInSeconds, FingerprintEngine engine);
+        static QString              generateWithVibra(const QByteArray& audioBuffer, const AudioFormat& format);
+        static QString              generateNative(const QByteArray& audioBuffer, const AudioFormat& format);
+};
@@ -0,0 +1,84 @@
+#include <algorithm>
+
+#include "landmarks.h"
+
+std::vector<Landmark> extractLandmarks(const Signature& signature) {
+    std::vector<FrequencyPeak> peaks;
+    peaks.reserve(signature.getPeakCount());
+
+    for (int band = 0; band < SIGNATURE_BAND_COUNT; band++) {
+        const auto& bandPeaks = signature.getPeaks(static_cast<FrequencyBand>(band));
+        peaks.insert(peaks.end(), bandPeaks.begin(), bandPeaks.end());
+    }
+
+    const auto byTime = [](const FrequencyPeak& first, const FrequencyPeak& second) {
+        return first.fftPassNumber < second.fftPassNumber;
+    };
+
+    // Each band is already in time order, so this is just a merge
+    std::stable_sort(peaks.begin(), peaks.end(), byTime);
+
+    // Only pair up the loudest peaks in each block. The quiet ones are the
+    // first to come and go with background noise, and every one that does
+    // changes which pairs its neighbours end up in.
+    size_t kept = 0;
+    for (size_t blockStart = 0; blockStart < peaks.size();) {
+        const uint32_t blockEnd = peaks[blockStart].fftPassNumber / LANDMARK_BLOCK_LENGTH * LANDMARK_BLOCK_LENGTH + LANDMARK_BLOCK_LENGTH;
+
+        size_t next = blockStart;
+        while (next < peaks.size() && peaks[next].fftPassNumber < blockEnd) {
+            next++;
+        }
+
+        const size_t blockSize = std::min<size_t>(next - blockStart, LANDMARK_PEAKS_PER_BLOCK);
+        std::partial_sort(peaks.begin() + blockStart, peaks.begin() + blockStart + blockSize, peaks.begin() + next,
+            [](const FrequencyPeak& first, const FrequencyPeak& second) {
+                return first.peakMagnitude > second.peakMagnitude;
+            });
+        std::sort(peaks.begin() + blockStart, peaks.begin() + blockStart + blockSize, byTime);
+
+        std::move(peaks.begin() + blockStart, peaks.begin() + blockStart + blockSize, peaks.begin() + kept);
+        kept += blockSize;
+        blockStart = next;
+    }
+    peaks.resize(kept);
+
+    std::vector<Landmark> landmarks;
+    landmarks.reserve(peaks.size() * LANDMARK_FAN_OUT);
+
+    for (size_t anchor = 0; anchor < peaks.size(); anchor++) {
+        const FrequencyPeak& first = peaks[anchor];
+        int paired = 0;
+
+        for (size_t target = anchor + 1; target < peaks.size() && paired < LANDMARK_FAN_OUT; target++) {
+            const FrequencyPeak& second = peaks[target];
+            const uint32_t delta = second.fftPassNumber - first.fftPassNumber;
+
+            if (delta == 0) {
+                continue;
+            }
+
+            if (delta > LANDMARK_MAX_DELTA) {
+                break;
+            }
+
+            // Captures that start part way through a hop move peaks by a
+            // pass or a bin, so only keep as much precision as survives that
+            landmarks.push_back({
+                landmarkHash(
+                    first.correctedPeakFrequencyBin >> LANDMARK_FREQUENCY_SHIFT,
+                    second.correctedPeakFrequencyBin >> LANDMARK_FREQUENCY_SHIFT,
+                    (delta + (1 << LANDMARK_DELTA_SHIFT) / 2) >> LANDMARK_DELTA_SHIFT),
+                first.fftPassNumber
+            });
+            paired++;
+        }
+    }
+
+    return landmarks;
+}
+
+uint32_t landmarkHash(uint32_t firstBin, uint32_t secondBin, uint32_t delta) {
+    // 10 bits per frequency and 6 bits of delta, 26 bits in total
+    return ((firstBin & 0x3ff) << 16) | ((secondBin & 0x3ff) << 6) | (delta & 0x3f);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "signature.h"
+
+// Peaks are thinned out to the loudest few in every block of FFT passes
+// (125 passes is one second)
+#define LANDMARK_BLOCK_LENGTH 125
+#define LANDMARK_PEAKS_PER_BLOCK 20
+
+// Each peak is paired with up to this many of the peaks that follow it
+#define LANDMARK_FAN_OUT 5
+
+// Furthest apart (in FFT passes, 8ms each) two peaks of a pair can be
+#define LANDMARK_MAX_DELTA 63
+
+// Precision kept in the hash. Frequencies are whole FFT bins (the peaks
+// store 1/64ths of a bin), deltas are rounded to 4 passes.
+#define LANDMARK_FREQUENCY_SHIFT 6
+#define LANDMARK_DELTA_SHIFT 2
+
+// Number of significant bits in a landmark hash
+#define LANDMARK_HASH_BITS 26
+
+/*
+ * A pair of spectral peaks, the usual unit of audio fingerprint matching.
+ *
+ * The hash only depends on the two frequencies and the time between them,
+ * so the same piece of music gives the same hashes wherever it starts in
+ * a capture. `time` is the FFT pass of the first peak.
+ */
+struct Landmark {
+    uint32_t    hash;
+    uint32_t    time;
+};
+
+/*
+ * Pairs up the peaks of every band, in time order
+ */
+std::vector<Landmark> extractLandmarks(const Signature& signature);
+
+/*
+ * Builds a landmark hash from its parts, after they have been coarsened.
+ * Frequencies are FFT bins (0-1024).
+ */
+uint32_t landmarkHash(uint32_t firstBin, uint32_t secondBin, uint32_t delta);
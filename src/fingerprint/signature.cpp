@@ -0,0 +1,250 @@
+#include <QtEndian>
+
+#include "signature.h"
+
+#define SIGNATURE_URI_PREFIX QStringLiteral("data:audio/vnd.shazam.sig;base64,")
+
+#define SIGNATURE_MAGIC_1           0xcafe2580u
+#define SIGNATURE_MAGIC_2           0x94119c00u
+#define SIGNATURE_FIXED_VALUE       ((15u << 19) + 0x40000u)
+#define SIGNATURE_CONTENTS_MAGIC    0x40000000u
+#define SIGNATURE_BAND_MAGIC        0x60030040u
+#define SIGNATURE_HEADER_SIZE       48
+
+// Shazam's id for 16kHz audio, stored in the top 5 bits of the header field
+#define SIGNATURE_SAMPLE_RATE_ID    3u
+
+/*
+ * Standard (IEEE 802.3) CRC-32, as used by zlib
+ */
+static uint32_t signatureCrc32(const char* data, qsizetype size) {
+    static const auto table = [] {
+        std::array<uint32_t, 256> table;
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; bit++) {
+                value = (value & 1) ? (0xedb88320u ^ (value >> 1)) : (value >> 1);
+            }
+            table[i] = value;
+        }
+        return table;
+    }();
+
+    uint32_t crc = 0xffffffffu;
+    for (qsizetype i = 0; i < size; i++) {
+        crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xff] ^ (crc >> 8);
+    }
+    return crc ^ 0xffffffffu;
+}
+
+static void appendUInt8(QByteArray& buffer, uint8_t value) {
+    buffer.append(static_cast<char>(value));
+}
+
+static void appendUInt16(QByteArray& buffer, uint16_t value) {
+    char bytes[sizeof(value)];
+    qToLittleEndian(value, bytes);
+    buffer.append(bytes, sizeof(bytes));
+}
+
+static void appendUInt32(QByteArray& buffer, uint32_t value) {
+    char bytes[sizeof(value)];
+    qToLittleEndian(value, bytes);
+    buffer.append(bytes, sizeof(bytes));
+}
+
+static uint32_t readUInt32(const char* data) {
+    return qFromLittleEndian<uint32_t>(data);
+}
+
+static uint16_t readUInt16(const char* data) {
+    return qFromLittleEndian<uint16_t>(data);
+}
+
+Signature::Signature() {
+}
+
+void Signature::addPeak(FrequencyBand band, const FrequencyPeak& peak) {
+    m_peaks[static_cast<int>(band)].push_back(peak);
+}
+
+void Signature::addSamples(uint32_t numberOfSamples) {
+    m_numberOfSamples += numberOfSamples;
+}
+
+void Signature::clear() {
+    m_numberOfSamples = 0;
+    for (auto& peaks : m_peaks) {
+        peaks.clear();
+    }
+}
+
+QByteArray Signature::encodeToBinary() const {
+    QByteArray buffer;
+    buffer.reserve(SIGNATURE_HEADER_SIZE + 8 + getPeakCount() * 5 + SIGNATURE_BAND_COUNT * 12);
+
+    // Header, the CRC and sizes are patched in at the end
+    appendUInt32(buffer, SIGNATURE_MAGIC_1);
+    appendUInt32(buffer, 0);    // CRC-32
+    appendUInt32(buffer, 0);    // Size minus header
+    appendUInt32(buffer, SIGNATURE_MAGIC_2);
+    appendUInt32(buffer, 0);
+    appendUInt32(buffer, 0);
+    appendUInt32(buffer, 0);
+    appendUInt32(buffer, SIGNATURE_SAMPLE_RATE_ID << 27);
+    appendUInt32(buffer, 0);
+    appendUInt32(buffer, 0);
+    appendUInt32(buffer, m_numberOfSamples + static_cast<uint32_t>(SIGNATURE_SAMPLE_RATE * 0.24));
+    appendUInt32(buffer, SIGNATURE_FIXED_VALUE);
+
+    appendUInt32(buffer, SIGNATURE_CONTENTS_MAGIC);
+    appendUInt32(buffer, 0);    // Size minus header
+
+    for (int band = 0; band < SIGNATURE_BAND_COUNT; band++) {
+        const auto& peaks = m_peaks[band];
+        if (peaks.empty()) {
+            continue;
+        }
+
+        QByteArray peaksBuffer;
+        peaksBuffer.reserve(peaks.size() * 5);
+        uint32_t fftPassNumber = 0;
+
+        for (const auto& peak : peaks) {
+            // Pass numbers are delta encoded, with an escape for big jumps
+            if (peak.fftPassNumber - fftPassNumber >= 255) {
+                appendUInt8(peaksBuffer, 0xff);
+                appendUInt32(peaksBuffer, peak.fftPassNumber);
+                fftPassNumber = peak.fftPassNumber;
+            }
+
+            appendUInt8(peaksBuffer, static_cast<uint8_t>(peak.fftPassNumber - fftPassNumber));
+            appendUInt16(peaksBuffer, peak.peakMagnitude);
+            appendUInt16(peaksBuffer, peak.correctedPeakFrequencyBin);
+            fftPassNumber = peak.fftPassNumber;
+        }
+
+        appendUInt32(buffer, SIGNATURE_BAND_MAGIC + band);
+        appendUInt32(buffer, peaksBuffer.size());
+        buffer.append(peaksBuffer);
+
+        // Each band is padded to a multiple of 4 bytes
+        buffer.append((4 - peaksBuffer.size() % 4) % 4, '\0');
+    }
+
+    const uint32_t sizeMinusHeader = buffer.size() - SIGNATURE_HEADER_SIZE;
+    qToLittleEndian(sizeMinusHeader, buffer.data() + 8);
+    qToLittleEndian(sizeMinusHeader, buffer.data() + SIGNATURE_HEADER_SIZE + 4);
+    qToLittleEndian(signatureCrc32(buffer.constData() + 8, buffer.size() - 8), buffer.data() + 4);
+
+    return buffer;
+}
+
+QString Signature::encodeToUri() const {
+    return SIGNATURE_URI_PREFIX + QString::fromLatin1(encodeToBinary().toBase64());
+}
+
+bool Signature::decodeFromBinary(const QByteArray& data, Signature& signature) {
+    signature.clear();
+
+    const char* bytes = data.constData();
+    const qsizetype size = data.size();
+
+    if (size < SIGNATURE_HEADER_SIZE + 8 ||
+        readUInt32(bytes) != SIGNATURE_MAGIC_1 ||
+        readUInt32(bytes + 12) != SIGNATURE_MAGIC_2 ||
+        readUInt32(bytes + SIGNATURE_HEADER_SIZE) != SIGNATURE_CONTENTS_MAGIC) {
+        return false;
+    }
+
+    if (readUInt32(bytes + 4) != signatureCrc32(bytes + 8, size - 8)) {
+        return false;
+    }
+
+    // The header includes 0.24 seconds that were never actually sampled
+    const uint32_t numberOfSamples = readUInt32(bytes + 40);
+    const auto padding = static_cast<uint32_t>(SIGNATURE_SAMPLE_RATE * 0.24);
+    signature.addSamples(numberOfSamples > padding ? numberOfSamples - padding : 0);
+
+    qsizetype offset = SIGNATURE_HEADER_SIZE + 8;
+    while (offset + 8 <= size) {
+        const uint32_t band = readUInt32(bytes + offset) - SIGNATURE_BAND_MAGIC;
+        const qsizetype bandSize = readUInt32(bytes + offset + 4);
+        offset += 8;
+
+        if (band >= SIGNATURE_BAND_COUNT || bandSize > size - offset) {
+            signature.clear();
+            return false;
+        }
+
+        const qsizetype bandEnd = offset + bandSize;
+        uint32_t fftPassNumber = 0;
+
+        while (offset < bandEnd) {
+            const auto delta = static_cast<uint8_t>(bytes[offset++]);
+
+            if (delta == 0xff) {
+                if (offset + 4 > bandEnd) {
+                    break;
+                }
+
+                fftPassNumber = readUInt32(bytes + offset);
+                offset += 4;
+                continue;
+            }
+
+            if (offset + 4 > bandEnd) {
+                break;
+            }
+
+            fftPassNumber += delta;
+
+            FrequencyPeak peak;
+            peak.fftPassNumber = fftPassNumber;
+            peak.peakMagnitude = readUInt16(bytes + offset);
+            peak.correctedPeakFrequencyBin = readUInt16(bytes + offset + 2);
+            offset += 4;
+
+            signature.addPeak(static_cast<FrequencyBand>(band), peak);
+        }
+
+        // Skip the padding to the next multiple of 4 bytes
+        offset = bandEnd + (4 - bandSize % 4) % 4;
+    }
+
+    return true;
+}
+
+bool Signature::decodeFromUri(const QString& uri, Signature& signature) {
+    if (!uri.startsWith(SIGNATURE_URI_PREFIX)) {
+        signature.clear();
+        return false;
+    }
+
+    const auto base64 = QStringView(uri).mid(SIGNATURE_URI_PREFIX.size()).toLatin1();
+    return decodeFromBinary(QByteArray::fromBase64(base64), signature);
+}
+
+/*
+ * Getters
+ */
+
+uint32_t Signature::getNumberOfSamples() const {
+    return m_numberOfSamples;
+}
+
+int Signature::getLengthInMilliseconds() const {
+    return static_cast<int>(static_cast<int64_t>(m_numberOfSamples) * 1000 / SIGNATURE_SAMPLE_RATE);
+}
+
+int Signature::getPeakCount() const {
+    int count = 0;
+    for (const auto& peaks : m_peaks) {
+        count += static_cast<int>(peaks.size());
+    }
+    return count;
+}
+
+const std::vector<FrequencyPeak>& Signature::getPeaks(FrequencyBand band) const {
+    return m_peaks[static_cast<int>(band)];
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#define SIGNATURE_SAMPLE_RATE 16000
+#define SIGNATURE_BAND_COUNT 4
+
+/*
+ * Shazam splits peaks into four frequency bands
+ */
+enum class FrequencyBand {
+    Band250To520    = 0,
+    Band520To1450   = 1,
+    Band1450To3500  = 2,
+    Band3500To5500  = 3
+};
+
+struct FrequencyPeak {
+    // Index of the FFT pass (one every 128 samples) the peak was found in
+    uint32_t    fftPassNumber;
+    uint16_t    peakMagnitude;
+    uint16_t    correctedPeakFrequencyBin;
+};
+
+/*
+ * A decoded Shazam signature: the spectral peaks found in a piece of
+ * 16kHz mono audio, grouped by frequency band.
+ */
+class Signature {
+    public:
+        Signature();
+
+        void        addPeak(FrequencyBand band, const FrequencyPeak& peak);
+        void        addSamples(uint32_t numberOfSamples);
+        void        clear();
+
+        /*
+         * Encodes the signature in Shazam's binary format
+         */
+        QByteArray  encodeToBinary() const;
+
+        /*
+         * Encodes the signature as a data URI, ready to be sent to Shazam
+         */
+        QString     encodeToUri() const;
+
+        /*
+         * Decodes a signature produced by encodeToBinary() (or vibra).
+         * Returns false, leaving `signature` cleared, if it is malformed.
+         */
+        static bool decodeFromBinary(const QByteArray& data, Signature& signature);
+        static bool decodeFromUri(const QString& uri, Signature& signature);
+
+        /*
+         * Getters
+         */
+        uint32_t    getNumberOfSamples() const;
+        int         getLengthInMilliseconds() const;
+        int         getPeakCount() const;
+        const std::vector<FrequencyPeak>& getPeaks(FrequencyBand band) const;
+
+    private:
+        uint32_t    m_numberOfSamples = 0;
+        std::array<std::vector<FrequencyPeak>, SIGNATURE_BAND_COUNT> m_peaks;
+};
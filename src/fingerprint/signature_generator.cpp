@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+#include "signature_generator.h"
+
+// Spectra are compared 46 (and 49) FFT passes back, so that there are
+// enough passes either side of the candidate to spread peaks over
+#define PEAK_RECOGNITION_DELAY 46
+
+// Bin range that is searched for peaks
+#define PEAK_FIRST_BIN 10
+#define PEAK_LAST_BIN 1015
+
+// Neighbouring passes (relative to the newest) a peak must be louder than
+static const int TIME_NEIGHBOURS[] = { -53, -45, 165, 172, 179, 186, 193, 200, 214, 221, 228, 235, 242, 249 };
+
+static float peakMagnitude(float value) {
+    return std::log(std::max(1.0f / 64.0f, value)) * 1477.3f + 6144.0f;
+}
+
+SignatureGenerator::SignatureGenerator() :
+    m_fftOutputs(SIGNATURE_HISTORY_SIZE * SIGNATURE_ROW_STRIDE),
+    m_spreadOutputs(SIGNATURE_HISTORY_SIZE * SIGNATURE_ROW_STRIDE),
+    m_fftPlan(RealFftPlan::forSize(SIGNATURE_FFT_SIZE)),
+    m_kernels(spectralKernels()) {
+        // Hanning window, numpy.hanning(2050)[1:-1]
+        for (int i = 0; i < SIGNATURE_FFT_SIZE; i++) {
+            m_window[i] = static_cast<float>(
+                0.5 - 0.5 * std::cos(2.0 * std::numbers::pi * (i + 1) / (SIGNATURE_FFT_SIZE + 1)));
+        }
+
+        reset();
+}
+
+void SignatureGenerator::reset() {
+    m_samples.fill(0);
+    m_samplesIndex = 0;
+    m_pendingCount = 0;
+    std::fill(m_fftOutputs.begin(), m_fftOutputs.end(), 0.0f);
+    std::fill(m_spreadOutputs.begin(), m_spreadOutputs.end(), 0.0f);
+    m_historyIndex = 0;
+    m_historyWritten = 0;
+    m_signature.clear();
+}
+
+void SignatureGenerator::feed(const int16_t* samples, size_t count) {
+    while (count > 0 && !isFull()) {
+        // Fast path, process straight from the caller's buffer
+        if (m_pendingCount == 0 && count >= SIGNATURE_HOP_SIZE) {
+            processHop(samples);
+            samples += SIGNATURE_HOP_SIZE;
+            count -= SIGNATURE_HOP_SIZE;
+            continue;
+        }
+
+        const size_t toCopy = std::min(SIGNATURE_HOP_SIZE - m_pendingCount, count);
+        std::copy(samples, samples + toCopy, m_pending.begin() + m_pendingCount);
+        m_pendingCount += toCopy;
+        samples += toCopy;
+        count -= toCopy;
+
+        if (m_pendingCount == SIGNATURE_HOP_SIZE) {
+            processHop(m_pending.data());
+            m_pendingCount = 0;
+        }
+    }
+}
+
+const Signature& SignatureGenerator::getSignature() const {
+    return m_signature;
+}
+
+bool SignatureGenerator::isFull() const {
+    return m_maxSamples != 0 && m_signature.getNumberOfSamples() >= m_maxSamples;
+}
+
+void SignatureGenerator::setMaxLengthInSeconds(int seconds) {
+    m_maxSamples = static_cast<uint32_t>(seconds) * SIGNATURE_SAMPLE_RATE;
+}
+
+/*******************************************************
+ * Private methods
+ *******************************************************/
+
+float* SignatureGenerator::fftOutput(int offset) {
+    const size_t index = (m_historyIndex + 2 * SIGNATURE_HISTORY_SIZE + offset) % SIGNATURE_HISTORY_SIZE;
+    return m_fftOutputs.data() + index * SIGNATURE_ROW_STRIDE;
+}
+
+float* SignatureGenerator::spreadOutput(int offset) {
+    const size_t index = (m_historyIndex + 2 * SIGNATURE_HISTORY_SIZE + offset) % SIGNATURE_HISTORY_SIZE;
+    return m_spreadOutputs.data() + index * SIGNATURE_ROW_STRIDE;
+}
+
+void SignatureGenerator::processHop(const int16_t* samples) {
+    m_signature.addSamples(SIGNATURE_HOP_SIZE);
+
+    doFft(samples);
+    doPeakSpreading();
+
+    if (m_historyWritten >= PEAK_RECOGNITION_DELAY) {
+        doPeakRecognition();
+    }
+}
+
+void SignatureGenerator::doFft(const int16_t* samples) {
+    std::copy(samples, samples + SIGNATURE_HOP_SIZE, m_samples.begin() + m_samplesIndex);
+    m_samplesIndex = (m_samplesIndex + SIGNATURE_HOP_SIZE) % SIGNATURE_FFT_SIZE;
+
+    // Oldest sample first, in two straight runs rather than a modulo per sample
+    const size_t firstPart = SIGNATURE_FFT_SIZE - m_samplesIndex;
+    for (size_t i = 0; i < firstPart; i++) {
+        m_fftInput[i] = m_window[i] * m_samples[m_samplesIndex + i];
+    }
+    for (size_t i = firstPart; i < SIGNATURE_FFT_SIZE; i++) {
+        m_fftInput[i] = m_window[i] * m_samples[i - firstPart];
+    }
+
+    m_fftPlan.forward(m_fftInput.data(), m_fftOutput.data(), m_fftScratch.data());
+    m_kernels.powerSpectrum(m_fftOutput.data(), fftOutput(0), SIGNATURE_FFT_BINS);
+}
+
+void SignatureGenerator::doPeakSpreading() {
+    const float* fft = fftOutput(0);
+    float* spread = spreadOutput(0);
+
+    // Frequency domain spreading
+    m_kernels.spreadFrequency(fft, spread, SIGNATURE_FFT_BINS);
+
+    // Time domain spreading into earlier passes
+    for (int former : { -1, -3, -6 }) {
+        m_kernels.maxInPlace(spreadOutput(former), spread, SIGNATURE_FFT_BINS);
+    }
+
+    m_historyIndex = (m_historyIndex + 1) % SIGNATURE_HISTORY_SIZE;
+    m_historyWritten++;
+}
+
+void SignatureGenerator::doPeakRecognition() {
+    const float* fftMinus46 = fftOutput(-PEAK_RECOGNITION_DELAY);
+    const float* spreadMinus49 = spreadOutput(-PEAK_RECOGNITION_DELAY - 3);
+
+    // Bins that are large enough and louder than their frequency neighbours
+    const size_t candidateCount = m_kernels.findPeakCandidates(
+        fftMinus46, spreadMinus49, PEAK_FIRST_BIN, PEAK_LAST_BIN, m_peakCandidates.data());
+
+    for (size_t candidate = 0; candidate < candidateCount; candidate++) {
+        const int bin = m_peakCandidates[candidate];
+        const float value = fftMinus46[bin];
+
+        // Ensure that it is a time domain local maximum
+        float maxNeighbour = 0.0f;
+        for (const int offset : PEAK_FREQUENCY_NEIGHBOURS) {
+            maxNeighbour = std::max(maxNeighbour, spreadMinus49[bin + offset]);
+        }
+
+        for (const int offset : TIME_NEIGHBOURS) {
+            maxNeighbour = std::max(maxNeighbour, spreadOutput(offset)[bin - 1]);
+        }
+
+        if (value <= maxNeighbour) {
+            continue;
+        }
+
+        // Refine the peak frequency by interpolating between its neighbours
+        const float magnitude = peakMagnitude(value);
+        const float magnitudeBefore = peakMagnitude(fftMinus46[bin - 1]);
+        const float magnitudeAfter = peakMagnitude(fftMinus46[bin + 1]);
+
+        const float variation1 = magnitude * 2 - magnitudeBefore - magnitudeAfter;
+        const float variation2 = (magnitudeAfter - magnitudeBefore) * 32 / variation1;
+
+        // The reference truncates the corrected bin before working out its
+        // frequency, and bands on the whole number of Hz, so a peak just
+        // above 5500Hz is still kept
+        const auto correctedBin = static_cast<uint16_t>(bin * 64 + variation2);
+        const float frequency = correctedBin * (SIGNATURE_SAMPLE_RATE / 2.0f / 1024.0f / 64.0f);
+        const int wholeFrequency = static_cast<int>(frequency);
+
+        FrequencyBand band;
+        if (wholeFrequency < 250) {
+            continue;
+        } else if (wholeFrequency < 520) {
+            band = FrequencyBand::Band250To520;
+        } else if (wholeFrequency < 1450) {
+            band = FrequencyBand::Band520To1450;
+        } else if (wholeFrequency < 3500) {
+            band = FrequencyBand::Band1450To3500;
+        } else if (wholeFrequency <= 5500) {
+            band = FrequencyBand::Band3500To5500;
+        } else {
+            continue;
+        }
+
+        FrequencyPeak peak;
+        peak.fftPassNumber = m_historyWritten - PEAK_RECOGNITION_DELAY;
+        peak.peakMagnitude = static_cast<uint16_t>(magnitude);
+        peak.correctedPeakFrequencyBin = correctedBin;
+        m_signature.addPeak(band, peak);
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <array>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "fft_plan.h"
+#include "signature.h"
+#include "spectral_kernels.h"
+
+#define SIGNATURE_FFT_SIZE          2048
+#define SIGNATURE_FFT_BINS          (SIGNATURE_FFT_SIZE / 2 + 1)
+#define SIGNATURE_HOP_SIZE          128
+#define SIGNATURE_HISTORY_SIZE      256
+#define SIGNATURE_MAX_SECONDS       12
+
+// Spectra are stored with a little padding, so that every row starts on
+// a 64 byte boundary relative to the first one
+#define SIGNATURE_ROW_STRIDE        1040
+
+/*
+ * Incremental Shazam signature generator.
+ *
+ * This is the same algorithm vibra (and SongRec, which it is based on)
+ * uses, but structured so that audio can be fed in as it is captured.
+ * All of the STFT and peak picking state lives in the generator, so the
+ * signature is complete as soon as the last chunk has been fed in.
+ *
+ * Input must be 16kHz mono signed 16-bit PCM.
+ */
+class SignatureGenerator {
+    public:
+        SignatureGenerator();
+
+        /*
+         * Feeds any number of samples. Samples that don't make up a whole
+         * hop are held back until the next call. Anything past the
+         * maximum length is ignored.
+         */
+        void                feed(const int16_t* samples, size_t count);
+
+        /*
+         * Signature over everything fed so far
+         */
+        const Signature&    getSignature() const;
+
+        /*
+         * True once the maximum length of audio has been processed
+         */
+        bool                isFull() const;
+
+        /*
+         * Shazam only wants SIGNATURE_MAX_SECONDS, which is the default.
+         * Indexing whole tracks needs more, 0 means no limit.
+         */
+        void                setMaxLengthInSeconds(int seconds);
+
+        void                reset();
+
+    private:
+        void                processHop(const int16_t* samples);
+        void                doFft(const int16_t* samples);
+        void                doPeakSpreading();
+        void                doPeakRecognition();
+
+        float*              fftOutput(int offset);
+        float*              spreadOutput(int offset);
+
+        // Last SIGNATURE_FFT_SIZE samples
+        std::array<int16_t, SIGNATURE_FFT_SIZE>     m_samples;
+        size_t                                      m_samplesIndex = 0;
+
+        // Samples waiting for a complete hop
+        std::array<int16_t, SIGNATURE_HOP_SIZE>     m_pending;
+        size_t                                      m_pendingCount = 0;
+
+        // Ring buffers of SIGNATURE_HISTORY_SIZE spectra, each
+        // SIGNATURE_ROW_STRIDE wide and stored back to back
+        std::vector<float>  m_fftOutputs;
+        std::vector<float>  m_spreadOutputs;
+        size_t              m_historyIndex = 0;
+        uint32_t            m_historyWritten = 0;
+
+        // Shared FFT plan and the kernels picked for this CPU
+        const RealFftPlan&      m_fftPlan;
+        const SpectralKernels&  m_kernels;
+
+        // Per generator FFT working buffers
+        std::array<float, SIGNATURE_FFT_SIZE>                   m_fftInput;
+        std::array<std::complex<float>, SIGNATURE_FFT_BINS>     m_fftOutput;
+        std::array<std::complex<float>, SIGNATURE_FFT_SIZE / 2> m_fftScratch;
+        std::array<uint16_t, SIGNATURE_FFT_BINS>                m_peakCandidates;
+
+        std::array<float, SIGNATURE_FFT_SIZE> m_window;
+
+        Signature           m_signature;
+        uint32_t            m_maxSamples = SIGNATURE_MAX_SECONDS * SIGNATURE_SAMPLE_RATE;
+};
@@ -0,0 +1,71 @@
+#include <algorithm>
+
+#include "landmarks.h"
+#include "signature_sketch.h"
+
+static uint64_t splitMix64(uint64_t value) {
+    value += 0x9e3779b97f4a7c15ull;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+    return value ^ (value >> 31);
+}
+
+/*
+ * One multiply-shift hash function per sketch value. The seeds are fixed,
+ * so sketches are comparable between runs.
+ */
+struct SketchHashFunctions {
+    std::array<uint64_t, SKETCH_HASH_COUNT> multipliers;
+    std::array<uint64_t, SKETCH_HASH_COUNT> increments;
+
+    SketchHashFunctions() {
+        for (int i = 0; i < SKETCH_HASH_COUNT; i++) {
+            multipliers[i] = splitMix64(2 * i) | 1;
+            increments[i] = splitMix64(2 * i + 1);
+        }
+    }
+};
+
+SignatureSketch::SignatureSketch() {
+    m_values.fill(UINT32_MAX);
+}
+
+SignatureSketch SignatureSketch::fromSignature(const Signature& signature) {
+    static const SketchHashFunctions functions;
+
+    SignatureSketch sketch;
+
+    for (const Landmark& landmark : extractLandmarks(signature)) {
+        const uint64_t mixed = splitMix64(landmark.hash);
+
+        for (int i = 0; i < SKETCH_HASH_COUNT; i++) {
+            const auto value = static_cast<uint32_t>((functions.multipliers[i] * mixed + functions.increments[i]) >> 32);
+            sketch.m_values[i] = std::min(sketch.m_values[i], value);
+        }
+
+        sketch.m_empty = false;
+    }
+
+    return sketch;
+}
+
+double SignatureSketch::similarity(const SignatureSketch& other) const {
+    if (m_empty || other.m_empty) {
+        return 0.0;
+    }
+
+    int matches = 0;
+    for (int i = 0; i < SKETCH_HASH_COUNT; i++) {
+        matches += m_values[i] == other.m_values[i];
+    }
+
+    return static_cast<double>(matches) / SKETCH_HASH_COUNT;
+}
+
+bool SignatureSketch::isEmpty() const {
+    return m_empty;
+}
+
+uint32_t SignatureSketch::getValue(int index) const {
+    return m_values[index];
+}
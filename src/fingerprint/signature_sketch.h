@@ -0,0 +1,37 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "signature.h"
+
+// Number of MinHash values kept per signature
+#define SKETCH_HASH_COUNT 128
+
+/*
+ * MinHash sketch of the landmarks in a signature.
+ *
+ * Two sketches agree in roughly the same proportion of their values as
+ * the two landmark sets overlap (their Jaccard similarity), so captures
+ * of the same song can be spotted without comparing whole signatures.
+ * Captures taken a few seconds apart still share most of their landmarks
+ * because landmarks don't depend on where the audio starts.
+ */
+class SignatureSketch {
+    public:
+        SignatureSketch();
+
+        static SignatureSketch fromSignature(const Signature& signature);
+
+        /*
+         * Estimated Jaccard similarity, between 0 and 1
+         */
+        double      similarity(const SignatureSketch& other) const;
+
+        bool        isEmpty() const;
+        uint32_t    getValue(int index) const;
+
+    private:
+        std::array<uint32_t, SKETCH_HASH_COUNT> m_values;
+        bool        m_empty = true;
+};
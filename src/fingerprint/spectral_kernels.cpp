@@ -0,0 +1,80 @@
+#include <QDebug>
+#include <QtGlobal>
+#include <algorithm>
+
+#include "spectral_kernels.h"
+
+// Power is scaled down by 2^17, multiplying by the reciprocal is exact
+#define POWER_SCALE (1.0f / 131072.0f)
+#define POWER_FLOOR 0.0000000001f
+
+static void powerSpectrumScalar(const std::complex<float>* fft, float* power, size_t bins) {
+    for (size_t i = 0; i < bins; i++) {
+        const float real = fft[i].real();
+        const float imag = fft[i].imag();
+        power[i] = std::max((real * real + imag * imag) * POWER_SCALE, POWER_FLOOR);
+    }
+}
+
+static void spreadFrequencyScalar(const float* input, float* output, size_t bins) {
+    for (size_t i = 0; i + 2 < bins; i++) {
+        output[i] = std::max(std::max(input[i], input[i + 1]), input[i + 2]);
+    }
+
+    output[bins - 2] = input[bins - 2];
+    output[bins - 1] = input[bins - 1];
+}
+
+static void maxInPlaceScalar(float* destination, const float* source, size_t bins) {
+    for (size_t i = 0; i < bins; i++) {
+        destination[i] = std::max(destination[i], source[i]);
+    }
+}
+
+static size_t findPeakCandidatesScalar(const float* fft, const float* spread, int firstBin, int lastBin, uint16_t* candidates) {
+    size_t count = 0;
+
+    for (int bin = firstBin; bin < lastBin; bin++) {
+        const float value = fft[bin];
+
+        if (value < PEAK_MINIMUM_VALUE || value < spread[bin - 1]) {
+            continue;
+        }
+
+        float maxNeighbour = 0.0f;
+        for (const int offset : PEAK_FREQUENCY_NEIGHBOURS) {
+            maxNeighbour = std::max(maxNeighbour, spread[bin + offset]);
+        }
+
+        if (value > maxNeighbour) {
+            candidates[count++] = static_cast<uint16_t>(bin);
+        }
+    }
+
+    return count;
+}
+
+const SpectralKernels& scalarSpectralKernels() {
+    static const SpectralKernels kernels = {
+        "scalar",
+        powerSpectrumScalar,
+        spreadFrequencyScalar,
+        maxInPlaceScalar,
+        findPeakCandidatesScalar
+    };
+
+    return kernels;
+}
+
+const SpectralKernels& spectralKernels() {
+    static const SpectralKernels& kernels = [] () -> const SpectralKernels& {
+        const auto* avx2 = avx2SpectralKernels();
+        const bool forceScalar = qEnvironmentVariable("SONGDETECTOR_SIMD") == QStringLiteral("scalar");
+
+        const auto& selected = (avx2 != nullptr && !forceScalar) ? *avx2 : scalarSpectralKernels();
+        qInfo() << "Using" << selected.name << "spectral kernels";
+        return selected;
+    }();
+
+    return kernels;
+}
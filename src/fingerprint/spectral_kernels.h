@@ -0,0 +1,57 @@
+#pragma once
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+
+// Neighbouring bins (in the same FFT pass) a peak must be louder than
+inline constexpr int PEAK_FREQUENCY_NEIGHBOURS[] = { -10, -7, -4, -3, 1, 2, 5, 8 };
+
+// Smallest value a bin can have to be considered as a peak
+inline constexpr float PEAK_MINIMUM_VALUE = 1.0f / 64.0f;
+
+/*
+ * The inner loops of the signature generator, one implementation per
+ * instruction set. Every implementation must give bit-identical results,
+ * which is why they only use operations that are exact or correctly
+ * rounded in both scalar and vector form.
+ */
+struct SpectralKernels {
+    const char* name;
+
+    /*
+     * power[i] = max(|fft[i]|^2 / 2^17, 1e-10)
+     */
+    void        (*powerSpectrum)(const std::complex<float>* fft, float* power, size_t bins);
+
+    /*
+     * output[i] = max(input[i], input[i + 1], input[i + 2]), the last two
+     * bins are copied as-is
+     */
+    void        (*spreadFrequency)(const float* input, float* output, size_t bins);
+
+    /*
+     * destination[i] = max(destination[i], source[i])
+     */
+    void        (*maxInPlace)(float* destination, const float* source, size_t bins);
+
+    /*
+     * Writes every bin in [firstBin, lastBin) of `fft` that passes the
+     * magnitude and frequency neighbour checks against `spread` to
+     * `candidates`, and returns how many there are.
+     */
+    size_t      (*findPeakCandidates)(const float* fft, const float* spread, int firstBin, int lastBin, uint16_t* candidates);
+};
+
+/*
+ * The fastest kernels the CPU supports, picked on first use. Setting
+ * SONGDETECTOR_SIMD=scalar in the environment forces the scalar kernels.
+ */
+const SpectralKernels&  spectralKernels();
+
+const SpectralKernels&  scalarSpectralKernels();
+
+/*
+ * nullptr if AVX2 isn't compiled in or the CPU doesn't support it
+ */
+const SpectralKernels*  avx2SpectralKernels();
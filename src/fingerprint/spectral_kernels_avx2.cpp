@@ -0,0 +1,115 @@
+#include "spectral_kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+/*
+ * The functions in here are compiled for AVX2 with a target attribute
+ * rather than a compiler flag, so that the rest of the binary still runs on
+ * any x86-64 CPU. They are only ever called after checking the CPU.
+ */
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+
+#define POWER_SCALE (1.0f / 131072.0f)
+#define POWER_FLOOR 0.0000000001f
+
+AVX2_FUNCTION
+static void powerSpectrumAvx2(const std::complex<float>* fft, float* power, size_t bins) {
+    const float* values = reinterpret_cast<const float*>(fft);
+    const __m256 scale = _mm256_set1_ps(POWER_SCALE);
+    const __m256 floor = _mm256_set1_ps(POWER_FLOOR);
+
+    size_t i = 0;
+    for (; i + 8 <= bins; i += 8) {
+        // Two registers of four interleaved (real, imag) pairs each
+        const __m256 first = _mm256_loadu_ps(values + 2 * i);
+        const __m256 second = _mm256_loadu_ps(values + 2 * i + 8);
+
+        // hadd gives pairs 0, 1, 4, 5 | 2, 3, 6, 7, so put them back in order
+        const __m256 sums = _mm256_hadd_ps(_mm256_mul_ps(first, first), _mm256_mul_ps(second, second));
+        const __m256 ordered = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(sums), _MM_SHUFFLE(3, 1, 2, 0)));
+
+        _mm256_storeu_ps(power + i, _mm256_max_ps(_mm256_mul_ps(ordered, scale), floor));
+    }
+
+    scalarSpectralKernels().powerSpectrum(fft + i, power + i, bins - i);
+}
+
+AVX2_FUNCTION
+static void spreadFrequencyAvx2(const float* input, float* output, size_t bins) {
+    size_t i = 0;
+    for (; i + 8 + 2 <= bins; i += 8) {
+        const __m256 maximum = _mm256_max_ps(
+            _mm256_max_ps(_mm256_loadu_ps(input + i), _mm256_loadu_ps(input + i + 1)),
+            _mm256_loadu_ps(input + i + 2));
+        _mm256_storeu_ps(output + i, maximum);
+    }
+
+    scalarSpectralKernels().spreadFrequency(input + i, output + i, bins - i);
+}
+
+AVX2_FUNCTION
+static void maxInPlaceAvx2(float* destination, const float* source, size_t bins) {
+    size_t i = 0;
+    for (; i + 8 <= bins; i += 8) {
+        _mm256_storeu_ps(destination + i, _mm256_max_ps(_mm256_loadu_ps(destination + i), _mm256_loadu_ps(source + i)));
+    }
+
+    scalarSpectralKernels().maxInPlace(destination + i, source + i, bins - i);
+}
+
+AVX2_FUNCTION
+static size_t findPeakCandidatesAvx2(const float* fft, const float* spread, int firstBin, int lastBin, uint16_t* candidates) {
+    const __m256 minimum = _mm256_set1_ps(PEAK_MINIMUM_VALUE);
+    size_t count = 0;
+
+    int bin = firstBin;
+    for (; bin + 8 <= lastBin; bin += 8) {
+        const __m256 value = _mm256_loadu_ps(fft + bin);
+
+        __m256 passed = _mm256_and_ps(
+            _mm256_cmp_ps(value, minimum, _CMP_GE_OQ),
+            _mm256_cmp_ps(value, _mm256_loadu_ps(spread + bin - 1), _CMP_GE_OQ));
+
+        // Skip the neighbour search when nothing in this block is loud enough
+        if (_mm256_movemask_ps(passed) == 0) {
+            continue;
+        }
+
+        __m256 maxNeighbour = _mm256_setzero_ps();
+        for (const int offset : PEAK_FREQUENCY_NEIGHBOURS) {
+            maxNeighbour = _mm256_max_ps(maxNeighbour, _mm256_loadu_ps(spread + bin + offset));
+        }
+
+        passed = _mm256_and_ps(passed, _mm256_cmp_ps(value, maxNeighbour, _CMP_GT_OQ));
+
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(passed));
+        while (mask != 0) {
+            candidates[count++] = static_cast<uint16_t>(bin + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+
+    return count + scalarSpectralKernels().findPeakCandidates(fft, spread, bin, lastBin, candidates + count);
+}
+
+const SpectralKernels* avx2SpectralKernels() {
+    static const SpectralKernels kernels = {
+        "AVX2",
+        powerSpectrumAvx2,
+        spreadFrequencyAvx2,
+        maxInPlaceAvx2,
+        findPeakCandidatesAvx2
+    };
+
+    return __builtin_cpu_supports("avx2") ? &kernels : nullptr;
+}
+
+#else
+
+const SpectralKernels* avx2SpectralKernels() {
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,31 @@
+#include "streaming_fingerprinter.h"
+
+StreamingFingerprinter::StreamingFingerprinter() {
+}
+
+void StreamingFingerprinter::reset() {
+    m_generator.reset();
+    m_decimator.reset();
+}
+
+void StreamingFingerprinter::feed(const char* data, qsizetype size, const AudioFormat& format) {
+    m_decimator.configure(format);
+
+    // Already in the generator's format, no need to copy it
+    if (m_decimator.isPassThrough()) {
+        m_generator.feed(reinterpret_cast<const int16_t*>(data), static_cast<size_t>(size) / sizeof(int16_t));
+        return;
+    }
+
+    m_converted.resize(m_decimator.getMaxOutputSamples(size));
+    const qsizetype count = m_decimator.process(data, size, m_converted.data());
+    m_generator.feed(m_converted.data(), static_cast<size_t>(count));
+}
+
+void StreamingFingerprinter::setMaxLengthInSeconds(int seconds) {
+    m_generator.setMaxLengthInSeconds(seconds);
+}
+
+const Signature& StreamingFingerprinter::getSignature() const {
+    return m_generator.getSignature();
+}
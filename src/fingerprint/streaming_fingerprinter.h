@@ -0,0 +1,38 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <vector>
+
+#include "audio/audio_format.h"
+#include "audio/decimator.h"
+#include "signature_generator.h"
+
+/*
+ * Feeds captured audio, chunk by chunk, into a SignatureGenerator.
+ *
+ * Each chunk is downmixed to mono and resampled to 16kHz on the way in
+ * (audio that is already 16kHz mono 16-bit goes straight through), so by
+ * the time the last chunk arrives the signature is (almost) ready.
+ * Not thread safe, but it may be used from any one thread at a time.
+ */
+class StreamingFingerprinter {
+    public:
+        StreamingFingerprinter();
+
+        void        reset();
+        void        feed(const char* data, qsizetype size, const AudioFormat& format);
+
+        /*
+         * See SignatureGenerator::setMaxLengthInSeconds()
+         */
+        void        setMaxLengthInSeconds(int seconds);
+
+        const Signature&    getSignature() const;
+
+    private:
+        SignatureGenerator      m_generator;
+        AudioDecimator          m_decimator;
+
+        std::vector<int16_t>    m_converted;
+};
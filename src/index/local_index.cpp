@@ -0,0 +1,282 @@
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrent>
+#include <algorithm>
+#include <cstring>
+#include <sys/mman.h>
+#include <unordered_map>
+
+#include "fingerprint/landmarks.h"
+#include "local_index.h"
+
+// Length of one FFT pass
+#define FFT_PASS_SECONDS (128.0 / SIGNATURE_SAMPLE_RATE)
+
+// (track id << 32) | offset bin -> number of votes
+using VoteMap = std::unordered_map<uint64_t, uint32_t>;
+
+static uint64_t voteKey(uint32_t trackId, int32_t offsetBin) {
+    return (static_cast<uint64_t>(trackId) << 32) | static_cast<uint32_t>(offsetBin);
+}
+
+static int32_t offsetBin(int64_t offset) {
+    // Round towards minus infinity, so bins are the same width either side of 0
+    return static_cast<int32_t>(offset >= 0 ? offset / LOCAL_INDEX_OFFSET_BIN : (offset - LOCAL_INDEX_OFFSET_BIN + 1) / LOCAL_INDEX_OFFSET_BIN);
+}
+
+/*
+ * Whether `count` items of `itemSize` bytes starting at `offset` end by
+ * `end`, without overflowing whatever a corrupt header holds
+ */
+static bool fitsBefore(uint64_t offset, uint64_t count, uint64_t itemSize, uint64_t end) {
+    return offset <= end && count <= (end - offset) / itemSize;
+}
+
+LocalIndex::LocalIndex() {
+}
+
+LocalIndex::~LocalIndex() {
+    close();
+}
+
+bool LocalIndex::open(const QString& path) {
+    close();
+
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to open local index" << path << m_file.errorString();
+        return false;
+    }
+
+    const qint64 size = m_file.size();
+    if (size < static_cast<qint64>(sizeof(LocalIndexHeader))) {
+        qWarning() << "Local index" << path << "is too small";
+        close();
+        return false;
+    }
+
+    m_data = m_file.map(0, size);
+    if (m_data == nullptr) {
+        qWarning() << "Failed to map local index" << path << m_file.errorString();
+        close();
+        return false;
+    }
+
+    // Lookups jump all over the file, read-ahead would only waste memory
+    madvise(const_cast<uchar*>(m_data), static_cast<size_t>(size), MADV_RANDOM);
+
+    const auto* header = reinterpret_cast<const LocalIndexHeader*>(m_data);
+    const auto fileSize = static_cast<uint64_t>(size);
+    const uint64_t directoryEntries = (1ull << std::min<uint32_t>(header->directoryBits, 63)) + 1;
+
+    const bool valid =
+        header->magic == LOCAL_INDEX_MAGIC &&
+        header->version == LOCAL_INDEX_VERSION &&
+        header->fileSize == fileSize &&
+        header->directoryBits >= LOCAL_INDEX_MIN_DIRECTORY_BITS &&
+        header->directoryBits <= LOCAL_INDEX_MAX_DIRECTORY_BITS &&
+        header->directoryOffset % 8 == 0 &&
+        header->postingsOffset % 8 == 0 &&
+        header->tracksOffset % 8 == 0 &&
+        fitsBefore(header->directoryOffset, directoryEntries, sizeof(uint64_t), header->postingsOffset) &&
+        fitsBefore(header->postingsOffset, header->postingCount, sizeof(LocalIndexPosting), header->tracksOffset) &&
+        fitsBefore(header->tracksOffset, header->trackCount, sizeof(LocalIndexTrack), header->stringsOffset) &&
+        header->stringsOffset <= fileSize;
+
+    if (!valid) {
+        qWarning() << "Local index" << path << "is not a valid index file";
+        close();
+        return false;
+    }
+
+    m_header = header;
+    m_directory = reinterpret_cast<const uint64_t*>(m_data + header->directoryOffset);
+    m_postings = reinterpret_cast<const LocalIndexPosting*>(m_data + header->postingsOffset);
+    m_tracks = reinterpret_cast<const LocalIndexTrack*>(m_data + header->tracksOffset);
+    m_strings = reinterpret_cast<const char*>(m_data + header->stringsOffset);
+
+    // Only the ends of the directory are checked here, walking all of it
+    // would read in up to 512 MiB. match() checks each run it uses.
+    if (m_directory[0] != 0 || m_directory[directoryEntries - 1] != header->postingCount) {
+        qWarning() << "Local index" << path << "has a corrupt directory";
+        close();
+        return false;
+    }
+
+    qInfo() << "Opened local index" << path << "with" << header->trackCount << "tracks";
+    return true;
+}
+
+void LocalIndex::close() {
+    if (m_data != nullptr) {
+        m_file.unmap(const_cast<uchar*>(m_data));
+    }
+
+    m_file.close();
+    m_data = nullptr;
+    m_header = nullptr;
+    m_directory = nullptr;
+    m_postings = nullptr;
+    m_tracks = nullptr;
+    m_strings = nullptr;
+}
+
+bool LocalIndex::isOpen() const {
+    return m_header != nullptr;
+}
+
+ShazamResponse LocalIndex::match(const Signature& signature) const {
+    if (!isOpen()) {
+        return ShazamResponse();
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    const std::vector<Landmark> landmarks = extractLandmarks(signature);
+    const uint32_t remainderBits = LANDMARK_HASH_BITS - m_header->directoryBits;
+    const uint32_t remainderMask = (1u << remainderBits) - 1;
+    const uint32_t trackCount = m_header->trackCount;
+    const uint64_t postingCount = m_header->postingCount;
+
+    const auto vote = [&](std::pair<size_t, size_t> range) {
+        VoteMap votes;
+
+        for (size_t i = range.first; i < range.second; i++) {
+            const Landmark& landmark = landmarks[i];
+            const uint32_t remainder = landmark.hash & remainderMask;
+            const uint64_t firstIndex = m_directory[landmark.hash >> remainderBits];
+            const uint64_t lastIndex = m_directory[(landmark.hash >> remainderBits) + 1];
+
+            // The directory isn't checked when the index is opened either,
+            // a run that doesn't lie within the postings is skipped
+            if (firstIndex > lastIndex || lastIndex > postingCount) {
+                continue;
+            }
+
+            const LocalIndexPosting* first = m_postings + firstIndex;
+            const LocalIndexPosting* last = m_postings + lastIndex;
+
+            // Postings are sorted by hash, so the ones for this hash are a single run
+            const auto run = std::equal_range(first, last, remainder, [](const auto& left, const auto& right) {
+                if constexpr (std::is_same_v<std::decay_t<decltype(left)>, LocalIndexPosting>) {
+                    return (left.hashAndTime >> LOCAL_INDEX_TIME_BITS) < right;
+                } else {
+                    return left < (right.hashAndTime >> LOCAL_INDEX_TIME_BITS);
+                }
+            });
+
+            for (const LocalIndexPosting* posting = run.first; posting != run.second; posting++) {
+                // Postings aren't checked when the index is opened, that
+                // would read in the whole file
+                if (posting->trackId >= trackCount) {
+                    continue;
+                }
+
+                const int64_t offset = static_cast<int64_t>(posting->hashAndTime & LOCAL_INDEX_TIME_MASK) - landmark.time;
+                votes[voteKey(posting->trackId, offsetBin(offset))]++;
+            }
+        }
+
+        return votes;
+    };
+
+    VoteMap votes;
+
+    if (landmarks.size() < LOCAL_INDEX_PARALLEL_THRESHOLD) {
+        votes = vote({ 0, landmarks.size() });
+    } else {
+        const size_t chunkCount = std::max(1, QThreadPool::globalInstance()->maxThreadCount());
+        const size_t chunkSize = (landmarks.size() + chunkCount - 1) / chunkCount;
+
+        QList<std::pair<size_t, size_t>> chunks;
+        for (size_t start = 0; start < landmarks.size(); start += chunkSize) {
+            chunks.append({ start, std::min(start + chunkSize, landmarks.size()) });
+        }
+
+        votes = QtConcurrent::blockingMappedReduced<VoteMap>(
+            QThreadPool::globalInstance(),
+            chunks,
+            vote,
+            [](VoteMap& result, const VoteMap& partial) {
+                for (const auto& [key, count] : partial) {
+                    result[key] += count;
+                }
+            });
+    }
+
+    // A landmark a pass either side of a bin edge lands in the next bin,
+    // so score each bin together with the one after it
+    struct TrackScore {
+        uint32_t    votes = 0;
+        int32_t     offsetBin = 0;
+    };
+    std::unordered_map<uint32_t, TrackScore> scores;
+
+    for (const auto& [key, count] : votes) {
+        const auto trackId = static_cast<uint32_t>(key >> 32);
+        const auto bin = static_cast<int32_t>(static_cast<uint32_t>(key));
+        const auto next = votes.find(voteKey(trackId, bin + 1));
+        const uint32_t total = count + (next != votes.end() ? next->second : 0);
+
+        TrackScore& score = scores[trackId];
+        if (total > score.votes) {
+            score.votes = total;
+            score.offsetBin = bin;
+        }
+    }
+
+    uint32_t bestTrack = 0;
+    TrackScore best;
+    uint32_t runnerUpVotes = 0;
+
+    for (const auto& [trackId, score] : scores) {
+        if (score.votes > best.votes) {
+            runnerUpVotes = best.votes;
+            bestTrack = trackId;
+            best = score;
+        } else {
+            runnerUpVotes = std::max(runnerUpVotes, score.votes);
+        }
+    }
+
+    // Also make sure it clearly beats every other track
+    if (best.votes < LOCAL_INDEX_MIN_VOTES || best.votes < 2 * runnerUpVotes || bestTrack >= m_header->trackCount) {
+        qDebug() << "No local match," << best.votes << "votes in" << timer.nsecsElapsed() / 1000 << "us";
+        return ShazamResponse();
+    }
+
+    const LocalIndexTrack& track = m_tracks[bestTrack];
+    qDebug() << "Local match with" << best.votes << "votes at"
+             << best.offsetBin * LOCAL_INDEX_OFFSET_BIN * FFT_PASS_SECONDS << "seconds in"
+             << timer.nsecsElapsed() / 1000 << "us";
+
+    return ShazamResponse::fromTrack(getString(track.title), getString(track.artist), getString(track.album), track.trackNumber);
+}
+
+/*
+ * Getters
+ */
+
+quint32 LocalIndex::getTrackCount() const {
+    return isOpen() ? m_header->trackCount : 0;
+}
+
+quint64 LocalIndex::getPostingCount() const {
+    return isOpen() ? m_header->postingCount : 0;
+}
+
+/*******************************************************
+ * Private methods
+ *******************************************************/
+
+QString LocalIndex::getString(uint32_t offset) const {
+    const uint64_t available = m_header->fileSize - m_header->stringsOffset;
+    if (offset >= available) {
+        return QString();
+    }
+
+    const char* string = m_strings + offset;
+    return QString::fromUtf8(string, static_cast<qsizetype>(strnlen(string, available - offset)));
+}
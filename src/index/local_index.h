@@ -0,0 +1,62 @@
+#pragma once
+
+#include <QFile>
+#include <QString>
+
+#include "fingerprint/signature.h"
+#include "local_index_format.h"
+#include "shazam/shazam_response.h"
+
+// Landmarks that must agree on one track at one time offset for a match
+#define LOCAL_INDEX_MIN_VOTES 15
+
+// Offsets are voted on in bins of this many FFT passes
+#define LOCAL_INDEX_OFFSET_BIN 4
+
+// Below this many landmarks (about 40 seconds of audio) the voting isn't
+// worth splitting across cores
+#define LOCAL_INDEX_PARALLEL_THRESHOLD 4096
+
+/*
+ * Matches signatures against a local, memory-mapped fingerprint index.
+ *
+ * Each landmark of the signature is looked up in the inverted index, and
+ * every posting for it is a vote for a track at a time offset (where in
+ * the track the capture would have started). A real match piles its votes
+ * up on a single offset while chance collisions are spread out. The
+ * voting is split across the global thread pool for larger signatures.
+ *
+ * The index is read-only once open and safe to match from several threads.
+ */
+class LocalIndex {
+    public:
+        LocalIndex();
+        ~LocalIndex();
+
+        bool        open(const QString& path);
+        void        close();
+        bool        isOpen() const;
+
+        /*
+         * Returns the best matching track, or a response with found set
+         * to false if nothing scored at least LOCAL_INDEX_MIN_VOTES
+         */
+        ShazamResponse  match(const Signature& signature) const;
+
+        /*
+         * Getters
+         */
+        quint32     getTrackCount() const;
+        quint64     getPostingCount() const;
+
+    private:
+        QString     getString(uint32_t offset) const;
+
+        QFile                       m_file;
+        const uchar*                m_data = nullptr;
+        const LocalIndexHeader*     m_header = nullptr;
+        const uint64_t*             m_directory = nullptr;
+        const LocalIndexPosting*    m_postings = nullptr;
+        const LocalIndexTrack*      m_tracks = nullptr;
+        const char*                 m_strings = nullptr;
+};
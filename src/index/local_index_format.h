@@ -0,0 +1,68 @@
+#pragma once
+
+#include <QtGlobal>
+#include <cstdint>
+
+#include "fingerprint/landmarks.h"
+
+/*
+ * On-disk layout of a local fingerprint index.
+ *
+ * The file is memory-mapped and read in place, so everything is stored in
+ * the machine's (little-endian) byte order and 8 byte aligned:
+ *
+ *   LocalIndexHeader
+ *   Directory   (1 << directoryBits) + 1 uint64_t, where postings
+ *               [directory[i], directory[i + 1]) are for the landmark hashes
+ *               whose top directoryBits bits are i
+ *   Postings    postingCount LocalIndexPosting, sorted by hash then track
+ *   Tracks      trackCount LocalIndexTrack
+ *   Strings     NUL terminated UTF-8, referenced by offset from the tracks
+ *
+ * Looking up a landmark only touches one directory entry and one run of
+ * postings, so only the pages that are actually needed are ever read in.
+ */
+
+#define LOCAL_INDEX_MAGIC   0x58494453u     // "SDIX"
+#define LOCAL_INDEX_VERSION 1
+
+// Bits of a posting used for the time of its landmark (in FFT passes,
+// 8ms each), which allows tracks of up to 35 minutes
+#define LOCAL_INDEX_TIME_BITS 18
+#define LOCAL_INDEX_TIME_MASK ((1u << LOCAL_INDEX_TIME_BITS) - 1)
+
+// Directory size limits. The rest of each hash (up to 14 bits) is kept in
+// its postings to tell apart the hashes that share a directory entry.
+#define LOCAL_INDEX_MIN_DIRECTORY_BITS 12
+#define LOCAL_INDEX_MAX_DIRECTORY_BITS LANDMARK_HASH_BITS
+
+static_assert(LANDMARK_HASH_BITS - LOCAL_INDEX_MIN_DIRECTORY_BITS + LOCAL_INDEX_TIME_BITS <= 32,
+    "Hash remainder and time must fit in 32 bits");
+static_assert(Q_BYTE_ORDER == Q_LITTLE_ENDIAN, "Local index files are little-endian");
+
+struct LocalIndexHeader {
+    uint32_t    magic;
+    uint32_t    version;
+    uint32_t    trackCount;
+    uint32_t    directoryBits;
+    uint64_t    postingCount;
+    uint64_t    directoryOffset;
+    uint64_t    postingsOffset;
+    uint64_t    tracksOffset;
+    uint64_t    stringsOffset;
+    uint64_t    fileSize;
+};
+
+struct LocalIndexPosting {
+    uint32_t    trackId;
+
+    // Remainder of the hash above LOCAL_INDEX_TIME_BITS bits of time
+    uint32_t    hashAndTime;
+};
+
+struct LocalIndexTrack {
+    uint32_t    title;
+    uint32_t    artist;
+    uint32_t    album;
+    int32_t     trackNumber;
+};
@@ -0,0 +1,294 @@
+#include <QDebug>
+#include <QDir>
+#include <QSaveFile>
+#include <algorithm>
+#include <bit>
+#include <functional>
+#include <queue>
+
+#include "fingerprint/landmarks.h"
+#include "local_index_writer.h"
+
+#define PACKED_TRACK_BITS 20
+
+// Aim for about this many postings behind each directory entry
+#define POSTINGS_PER_DIRECTORY_ENTRY 8
+
+// Landmarks, postings or directory entries read or written at once
+#define WRITER_BLOCK_SIZE (64 * 1024)
+
+namespace {
+    // Reads back a sorted run spilled to disk, a block at a time
+    struct SortedRun {
+        QTemporaryFile*         file;
+        std::vector<uint64_t>   block;
+        size_t                  position = 0;
+
+        bool next(uint64_t& landmark) {
+            if (position == block.size()) {
+                block.resize(WRITER_BLOCK_SIZE);
+                const qint64 read = file->read(reinterpret_cast<char*>(block.data()), block.size() * sizeof(uint64_t));
+                block.resize(read > 0 ? static_cast<size_t>(read) / sizeof(uint64_t) : 0);
+                position = 0;
+
+                if (block.empty()) {
+                    return false;
+                }
+            }
+
+            landmark = block[position++];
+            return true;
+        }
+    };
+}
+
+LocalIndexWriter::LocalIndexWriter(const QString& temporaryDirectory)
+    : m_temporaryDirectory(temporaryDirectory.isEmpty() ? QDir::tempPath() : temporaryDirectory) {
+        // Offset 0 is the empty string
+        m_strings.append('\0');
+}
+
+bool LocalIndexWriter::addTrack(const LocalIndexTrackInfo& track, const Signature& signature) {
+    if (static_cast<uint32_t>(m_tracks.size()) >= LOCAL_INDEX_MAX_TRACKS) {
+        qWarning() << "Local index is full";
+        return false;
+    }
+
+    const auto trackId = static_cast<uint64_t>(m_tracks.size());
+
+    LocalIndexTrack record;
+    record.title = addString(track.title);
+    record.artist = addString(track.artist);
+    record.album = addString(track.album);
+    record.trackNumber = track.trackNumber;
+    m_tracks.append(record);
+
+    for (const Landmark& landmark : extractLandmarks(signature)) {
+        if (landmark.time > LOCAL_INDEX_TIME_MASK) {
+            // Past the longest track the format can describe
+            break;
+        }
+
+        m_landmarks.push_back(
+            (static_cast<uint64_t>(landmark.hash) << (PACKED_TRACK_BITS + LOCAL_INDEX_TIME_BITS)) |
+            (trackId << LOCAL_INDEX_TIME_BITS) |
+            landmark.time);
+        m_landmarkCount++;
+
+        if (m_landmarks.size() >= LOCAL_INDEX_WRITER_RUN_LANDMARKS && !spillRun()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool LocalIndexWriter::write(const QString& path) {
+    // Everything in one run if it fits, otherwise merge the runs on disk
+    if (!m_runs.empty() && !m_landmarks.empty() && !spillRun()) {
+        return false;
+    }
+    std::sort(m_landmarks.begin(), m_landmarks.end());
+
+    // Enough directory entries to keep the runs of postings short
+    const uint64_t wanted = std::max<uint64_t>(1, m_landmarkCount / POSTINGS_PER_DIRECTORY_ENTRY);
+    const auto directoryBits = std::clamp<uint32_t>(
+        static_cast<uint32_t>(std::bit_width(wanted - 1)),
+        LOCAL_INDEX_MIN_DIRECTORY_BITS,
+        LOCAL_INDEX_MAX_DIRECTORY_BITS);
+    const uint32_t remainderBits = LANDMARK_HASH_BITS - directoryBits;
+
+    const uint64_t directoryEntries = (1ull << directoryBits) + 1;
+
+    LocalIndexHeader header = {};
+    header.magic = LOCAL_INDEX_MAGIC;
+    header.version = LOCAL_INDEX_VERSION;
+    header.trackCount = static_cast<uint32_t>(m_tracks.size());
+    header.directoryBits = directoryBits;
+    header.postingCount = m_landmarkCount;
+    header.directoryOffset = sizeof(LocalIndexHeader);
+    header.postingsOffset = header.directoryOffset + directoryEntries * sizeof(uint64_t);
+    header.tracksOffset = header.postingsOffset + header.postingCount * sizeof(LocalIndexPosting);
+    header.stringsOffset = header.tracksOffset + header.trackCount * sizeof(LocalIndexTrack);
+    header.fileSize = header.stringsOffset + m_strings.size();
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to create local index" << path << file.errorString();
+        return false;
+    }
+
+    // The directory is only known once the postings are, so it is collected
+    // in a temporary file and copied in front of them at the end
+    const auto directoryFile = createTemporaryFile();
+    if (!directoryFile) {
+        return false;
+    }
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.seek(static_cast<qint64>(header.postingsOffset));
+
+    // Directory, written as a running count of postings per entry. The
+    // postings come in hash order, so each entry is complete once a
+    // posting past it turns up.
+    std::vector<uint64_t> directory;
+    directory.reserve(WRITER_BLOCK_SIZE);
+    uint64_t nextEntry = 0;
+    uint64_t written = 0;
+
+    const auto addEntriesUpTo = [&](uint64_t entry) {
+        for (; nextEntry <= entry; nextEntry++) {
+            directory.push_back(written);
+
+            if (directory.size() == directory.capacity()) {
+                directoryFile->write(reinterpret_cast<const char*>(directory.data()), directory.size() * sizeof(uint64_t));
+                directory.clear();
+            }
+        }
+    };
+
+    // Postings, in blocks so the whole lot is never copied at once
+    std::vector<LocalIndexPosting> block;
+    block.reserve(WRITER_BLOCK_SIZE);
+
+    const auto addPosting = [&](uint64_t landmark) {
+        const auto hash = static_cast<uint32_t>(landmark >> (PACKED_TRACK_BITS + LOCAL_INDEX_TIME_BITS));
+        addEntriesUpTo(hash >> remainderBits);
+
+        LocalIndexPosting posting;
+        posting.trackId = static_cast<uint32_t>(landmark >> LOCAL_INDEX_TIME_BITS) & (LOCAL_INDEX_MAX_TRACKS - 1);
+        posting.hashAndTime = ((hash & ((1u << remainderBits) - 1)) << LOCAL_INDEX_TIME_BITS) |
+                              (static_cast<uint32_t>(landmark) & LOCAL_INDEX_TIME_MASK);
+        block.push_back(posting);
+        written++;
+
+        if (block.size() == block.capacity()) {
+            file.write(reinterpret_cast<const char*>(block.data()), block.size() * sizeof(LocalIndexPosting));
+            block.clear();
+        }
+    };
+
+    if (m_runs.empty()) {
+        for (const uint64_t landmark : m_landmarks) {
+            addPosting(landmark);
+        }
+    } else {
+        // K-way merge, smallest landmark first
+        std::vector<SortedRun> runs;
+        runs.reserve(m_runs.size());
+        for (const auto& run : m_runs) {
+            run->seek(0);
+            runs.push_back({ run.get() });
+        }
+
+        using Head = std::pair<uint64_t, size_t>;
+        std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+        for (size_t i = 0; i < runs.size(); i++) {
+            uint64_t landmark;
+            if (runs[i].next(landmark)) {
+                heads.push({ landmark, i });
+            }
+        }
+
+        while (!heads.empty()) {
+            const auto [landmark, run] = heads.top();
+            heads.pop();
+            addPosting(landmark);
+
+            uint64_t next;
+            if (runs[run].next(next)) {
+                heads.push({ next, run });
+            }
+        }
+    }
+
+    file.write(reinterpret_cast<const char*>(block.data()), block.size() * sizeof(LocalIndexPosting));
+
+    if (written != header.postingCount) {
+        qWarning() << "Failed to read back local index runs, got" << written << "of" << header.postingCount << "landmarks";
+        file.cancelWriting();
+        return false;
+    }
+
+    // The remaining entries all end at the last posting
+    addEntriesUpTo(directoryEntries - 1);
+    directoryFile->write(reinterpret_cast<const char*>(directory.data()), directory.size() * sizeof(uint64_t));
+
+    file.write(reinterpret_cast<const char*>(m_tracks.constData()), m_tracks.size() * sizeof(LocalIndexTrack));
+    file.write(m_strings);
+
+    file.seek(static_cast<qint64>(header.directoryOffset));
+    directoryFile->seek(0);
+    uint64_t copied = 0;
+    while (!directoryFile->atEnd()) {
+        const QByteArray entries = directoryFile->read(WRITER_BLOCK_SIZE * sizeof(uint64_t));
+        if (entries.isEmpty()) {
+            break;
+        }
+        file.write(entries);
+        copied += entries.size();
+    }
+
+    if (copied != directoryEntries * sizeof(uint64_t)) {
+        qWarning() << "Failed to read back local index directory" << directoryFile->errorString();
+        file.cancelWriting();
+        return false;
+    }
+
+    if (!file.commit()) {
+        qWarning() << "Failed to write local index" << path << file.errorString();
+        return false;
+    }
+
+    qInfo() << "Wrote local index" << path << "with" << header.trackCount << "tracks and" << header.postingCount << "landmarks";
+    return true;
+}
+
+quint32 LocalIndexWriter::getTrackCount() const {
+    return static_cast<quint32>(m_tracks.size());
+}
+
+/*******************************************************
+ * Private methods
+ *******************************************************/
+
+uint32_t LocalIndexWriter::addString(const QString& string) {
+    if (string.isEmpty()) {
+        return 0;
+    }
+
+    const auto offset = static_cast<uint32_t>(m_strings.size());
+    m_strings.append(string.toUtf8());
+    m_strings.append('\0');
+    return offset;
+}
+
+std::unique_ptr<QTemporaryFile> LocalIndexWriter::createTemporaryFile() const {
+    auto file = std::make_unique<QTemporaryFile>(QDir(m_temporaryDirectory).filePath(QStringLiteral("songdetector-index-XXXXXX")));
+    if (!file->open()) {
+        qWarning() << "Failed to create temporary file in" << m_temporaryDirectory << file->errorString();
+        return nullptr;
+    }
+
+    return file;
+}
+
+bool LocalIndexWriter::spillRun() {
+    std::sort(m_landmarks.begin(), m_landmarks.end());
+
+    auto run = createTemporaryFile();
+    if (!run) {
+        return false;
+    }
+
+    const auto size = static_cast<qint64>(m_landmarks.size() * sizeof(uint64_t));
+    if (run->write(reinterpret_cast<const char*>(m_landmarks.data()), size) != size || !run->flush()) {
+        qWarning() << "Failed to spill local index run to" << run->fileName() << run->errorString();
+        return false;
+    }
+
+    // Keeps the capacity, so the next run doesn't grow the vector again
+    m_landmarks.clear();
+    m_runs.push_back(std::move(run));
+    return true;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <QTemporaryFile>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "fingerprint/signature.h"
+#include "local_index_format.h"
+
+// Track ids are packed into 20 bits while the index is built
+#define LOCAL_INDEX_MAX_TRACKS (1u << 20)
+
+// Landmarks sorted in memory before they are spilled to disk, 8 bytes each
+#define LOCAL_INDEX_WRITER_RUN_LANDMARKS (64 * 1024 * 1024)
+
+struct LocalIndexTrackInfo {
+    QString     title;
+    QString     artist;
+    QString     album;
+    int         trackNumber = 0;
+};
+
+/*
+ * Builds a local index file (see local_index_format.h).
+ *
+ * Landmarks are collected in memory, 8 bytes each, and sorted in runs of
+ * at most LOCAL_INDEX_WRITER_RUN_LANDMARKS (512 MiB). Each full run is
+ * spilled to a temporary file in `temporaryDirectory` and the runs are
+ * merged into the inverted index when the file is written, so building
+ * needs about 1 GiB of memory however large the library is, plus about
+ * the size of the finished index again on disk.
+ */
+class LocalIndexWriter {
+    public:
+        explicit LocalIndexWriter(const QString& temporaryDirectory = QString());
+
+        /*
+         * Adds a track. The signature should cover the whole track, see
+         * SignatureGenerator::setMaxLengthInSeconds(). Returns false once
+         * the index is full or a run couldn't be spilled to disk.
+         */
+        bool        addTrack(const LocalIndexTrackInfo& track, const Signature& signature);
+
+        /*
+         * Writes the index, replacing `path` only once it is complete
+         */
+        bool        write(const QString& path);
+
+        quint32     getTrackCount() const;
+
+    private:
+        uint32_t    addString(const QString& string);
+        std::unique_ptr<QTemporaryFile> createTemporaryFile() const;
+        bool        spillRun();
+
+        QString     m_temporaryDirectory;
+        uint64_t    m_landmarkCount = 0;
+
+        // hash << 38 | track id << 18 | time, so sorting them sorts by hash
+        std::vector<uint64_t>           m_landmarks;
+        std::vector<std::unique_ptr<QTemporaryFile>> m_runs;
+        QList<LocalIndexTrack>          m_tracks;
+        QByteArray                      m_strings;
+};
@@ -0,0 +1,179 @@
+#include <QDebug>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+
+#include "latency_stats.h"
+
+// Buckets are spaced evenly on a log scale, LATENCY_BUCKETS_PER_DECADE per
+// decade from 0.1ms to 100s, plus an implicit +Inf bucket. Fine enough to
+// keep the percentile estimates within a few percent.
+#define LATENCY_BUCKETS_PER_DECADE 10
+#define LATENCY_MIN_BUCKET_EXPONENT -1
+#define LATENCY_BUCKET_COUNT (6 * LATENCY_BUCKETS_PER_DECADE + 1)
+
+// Upper bound of each bucket in milliseconds
+static const std::array<double, LATENCY_BUCKET_COUNT>& bucketBounds() {
+    static const auto bounds = [] {
+        std::array<double, LATENCY_BUCKET_COUNT> bounds;
+        for (size_t i = 0; i < bounds.size(); i++) {
+            bounds[i] = std::pow(10.0, LATENCY_MIN_BUCKET_EXPONENT + static_cast<double>(i) / LATENCY_BUCKETS_PER_DECADE);
+        }
+        return bounds;
+    }();
+
+    return bounds;
+}
+
+static constexpr std::array<const char*, static_cast<size_t>(LatencyStage::Count)> LATENCY_STAGE_NAMES = {
+    "stream_connect",
+    "format_negotiation",
+    "capture_start",
+    "buffer_fill",
+    "fingerprint",
+    "http_round_trip",
+    "hedged_lookup",
+    "hedge_saving",
+    "json_parse",
+    "response_decode",
+    "identification",
+};
+
+struct LatencyHistogram {
+    std::array<std::atomic<uint64_t>, LATENCY_BUCKET_COUNT + 1> buckets{};
+    std::atomic<uint64_t>   count{0};
+    std::atomic<uint64_t>   sumNanoseconds{0};
+
+    /*
+     * Estimates the `quantile` (0-1) in milliseconds, interpolating
+     * (on a log scale) within the bucket it falls into
+     */
+    double percentile(double quantile) const {
+        const uint64_t total = count.load(std::memory_order_relaxed);
+        if (total == 0) {
+            return 0;
+        }
+
+        const auto& bounds = bucketBounds();
+        const double rank = quantile * total;
+        uint64_t cumulative = 0;
+
+        for (size_t i = 0; i < buckets.size(); i++) {
+            const uint64_t inBucket = buckets[i].load(std::memory_order_relaxed);
+            if (inBucket > 0 && cumulative + inBucket >= rank) {
+                if (i == 0) {
+                    return bounds[0];
+                }
+
+                if (i == bounds.size()) {
+                    // Nothing to interpolate towards in the +Inf bucket
+                    return bounds.back();
+                }
+
+                const double fraction = (rank - cumulative) / inBucket;
+                return bounds[i - 1] * std::pow(bounds[i] / bounds[i - 1], fraction);
+            }
+
+            cumulative += inBucket;
+        }
+
+        return bounds.back();
+    }
+};
+
+static std::array<LatencyHistogram, static_cast<size_t>(LatencyStage::Count)> g_histograms;
+
+void recordLatency(LatencyStage stage, qint64 nanoseconds) {
+    auto& histogram = g_histograms[static_cast<size_t>(stage)];
+    const double milliseconds = nanoseconds / 1e6;
+    const auto& bounds = bucketBounds();
+
+    // First bucket whose upper bound is at least `milliseconds`
+    const auto bucket = static_cast<size_t>(
+        std::lower_bound(bounds.begin(), bounds.end(), milliseconds) - bounds.begin());
+
+    histogram.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    histogram.count.fetch_add(1, std::memory_order_relaxed);
+    histogram.sumNanoseconds.fetch_add(static_cast<uint64_t>(std::max<qint64>(nanoseconds, 0)), std::memory_order_relaxed);
+}
+
+void recordLatency(LatencyStage stage, const QElapsedTimer& timer) {
+    if (timer.isValid()) {
+        recordLatency(stage, timer.nsecsElapsed());
+    }
+}
+
+quint64 latencyCount(LatencyStage stage) {
+    return g_histograms[static_cast<size_t>(stage)].count.load(std::memory_order_relaxed);
+}
+
+double latencyPercentile(LatencyStage stage, double quantile) {
+    return g_histograms[static_cast<size_t>(stage)].percentile(quantile);
+}
+
+QJsonObject latencyStatsToJson() {
+    QJsonObject stages;
+
+    for (size_t i = 0; i < g_histograms.size(); i++) {
+        const auto& histogram = g_histograms[i];
+        const uint64_t count = histogram.count.load(std::memory_order_relaxed);
+        if (count == 0) {
+            continue;
+        }
+
+        QJsonObject stage;
+        stage["count"] = static_cast<qint64>(count);
+        stage["meanMs"] = histogram.sumNanoseconds.load(std::memory_order_relaxed) / 1e6 / count;
+        stage["p50Ms"] = histogram.percentile(0.50);
+        stage["p95Ms"] = histogram.percentile(0.95);
+        stage["p99Ms"] = histogram.percentile(0.99);
+        stages[LATENCY_STAGE_NAMES[i]] = stage;
+    }
+
+    return stages;
+}
+
+QByteArray latencyStatsToPrometheus() {
+    QByteArray text;
+    text += "# HELP songdetector_stage_latency_seconds Latency of each stage of an identification.\n";
+    text += "# TYPE songdetector_stage_latency_seconds histogram\n";
+
+    for (size_t i = 0; i < g_histograms.size(); i++) {
+        const auto& histogram = g_histograms[i];
+        const auto& bounds = bucketBounds();
+        const QByteArray stage = QByteArray("stage=\"") + LATENCY_STAGE_NAMES[i] + "\"";
+        uint64_t cumulative = 0;
+
+        for (size_t bucket = 0; bucket < histogram.buckets.size(); bucket++) {
+            cumulative += histogram.buckets[bucket].load(std::memory_order_relaxed);
+
+            const QByteArray bound = bucket < bounds.size() ?
+                QByteArray::number(bounds[bucket] / 1000, 'g', 6) : QByteArray("+Inf");
+            text += "songdetector_stage_latency_seconds_bucket{" + stage + ",le=\"" + bound + "\"} " +
+                QByteArray::number(cumulative) + "\n";
+        }
+
+        text += "songdetector_stage_latency_seconds_sum{" + stage + "} " +
+            QByteArray::number(histogram.sumNanoseconds.load(std::memory_order_relaxed) / 1e9, 'g', 9) + "\n";
+        text += "songdetector_stage_latency_seconds_count{" + stage + "} " +
+            QByteArray::number(histogram.count.load(std::memory_order_relaxed)) + "\n";
+    }
+
+    return text;
+}
+
+void logLatencyStats() {
+    const QJsonObject stages = latencyStatsToJson();
+
+    for (auto it = stages.begin(); it != stages.end(); ++it) {
+        const QJsonObject stage = it.value().toObject();
+        qInfo().noquote() << QString("%1: %2 samples, p50 %3 ms, p95 %4 ms, p99 %5 ms")
+            .arg(it.key())
+            .arg(stage["count"].toInteger())
+            .arg(stage["p50Ms"].toDouble(), 0, 'f', 1)
+            .arg(stage["p95Ms"].toDouble(), 0, 'f', 1)
+            .arg(stage["p99Ms"].toDouble(), 0, 'f', 1);
+    }
+}
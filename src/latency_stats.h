@@ -0,0 +1,61 @@
+#pragma once
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QtGlobal>
+
+/*
+ * Latency of each stage of an identification, kept as histograms.
+ *
+ * Recording is a few relaxed atomic increments, so it is safe (and cheap)
+ * from any thread, including the PipeWire real-time thread. Percentiles
+ * are estimated from the buckets, so they are only as precise as the
+ * bucket the percentile falls into.
+ */
+
+enum class LatencyStage {
+    StreamConnect,      // Stream requested (or reactivated) to audio flowing
+    FormatNegotiation,  // Stream connected to format agreed
+    CaptureStart,       // startCapture() to the first audio
+    BufferFill,         // First audio to a full capture
+    Fingerprint,        // Full capture to the final signature
+    HttpRoundTrip,      // Shazam request to response
+    HedgedLookup,       // Shazam request to its hedge's response, for
+                        // lookups the hedge answered first
+    HedgeSaving,        // How much sooner the hedge answered than the
+                        // request it beat, see Shazam::setMeasureHedging()
+    JsonParse,          // Parsing Shazam's response
+    ResponseDecode,     // Picking the song out of the parsed response
+    Identification,     // identify() to the result
+    Count
+};
+
+void        recordLatency(LatencyStage stage, qint64 nanoseconds);
+
+/*
+ * Records the time since `timer` was started, if it was
+ */
+void        recordLatency(LatencyStage stage, const QElapsedTimer& timer);
+
+/*
+ * Samples recorded for `stage`, and its `quantile` (0-1) in milliseconds
+ */
+quint64     latencyCount(LatencyStage stage);
+double      latencyPercentile(LatencyStage stage, double quantile);
+
+/*
+ * Count, mean and p50/p95/p99 (in milliseconds) of every stage with
+ * at least one sample
+ */
+QJsonObject latencyStatsToJson();
+
+/*
+ * Every stage as a Prometheus histogram, in the text exposition format
+ */
+QByteArray  latencyStatsToPrometheus();
+
+/*
+ * Writes a summary of every stage to the log
+ */
+void        logLatencyStats();
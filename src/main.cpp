@@ -1,25 +1,129 @@
 #include <QApplication>
+#include <QCommandLineParser>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QIcon>
 #include <QLocale>
 #include <QLockFile>
 #include <QMenu>
 #include <QSettings>
+#include <QTimer>
 #include <QTranslator>
 #include <qcoreapplication.h>
 
+#include "batch/batch_identifier.h"
+#include "batch/index_builder.h"
+#include "latency_stats.h"
+#include "process_stats.h"
+#include "settings.h"
 #include "song_detector.h"
+#include "trace.h"
 
 #define APPLICATION_NAME QStringLiteral("SongDetector")
 
+static bool isBatchMode(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (qstrcmp(argv[i], "--identify") == 0 || qstrcmp(argv[i], "--tracklist") == 0 ||
+            qstrcmp(argv[i], "--build-index") == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * SongDetector --identify|--tracklist <files/dirs>
+ * SongDetector --build-index <index> <files/dirs>
+ *
+ * Runs without a display or PipeWire, so it gets a QCoreApplication and
+ * no lock file (it can run alongside the tray app).
+ */
+static int runBatchMode(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setOrganizationName(APPLICATION_NAME);
+    QCoreApplication::setApplicationName(APPLICATION_NAME);
+    startTracingFromEnvironment();
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Identifies the music in WAV files, writing the results as lines of JSON");
+    parser.addHelpOption();
+    parser.addOption({ "identify", "Identify files instead of starting the tray app." });
+    parser.addOption({ "tracklist", "Write a timestamped tracklist of each file instead." });
+    parser.addOption({ "max-requests", "Shazam lookups in flight at once.", "count", QString::number(BATCH_DEFAULT_MAX_REQUESTS) });
+    parser.addOption({ "interval", "Seconds between the windows fingerprinted (default 60, or 6 for a tracklist).", "seconds" });
+    parser.addOption({ "index", "Local fingerprint index to check first.", "path" });
+    parser.addOption({ "build-index", "Build a local fingerprint index of the files instead.", "path" });
+    parser.addPositionalArgument("paths", "WAV files, or directories to search for them.", "<files/dirs...>");
+    parser.process(app);
+
+    if (parser.positionalArguments().isEmpty()) {
+        parser.showHelp(1);
+    }
+
+    if (parser.isSet("build-index")) {
+        const bool built = IndexBuilder::build(parser.value("build-index"), parser.positionalArguments());
+        writeTrace();
+        return built ? 0 : 1;
+    }
+
+    int maxRequests = BATCH_DEFAULT_MAX_REQUESTS;
+    if (parser.isSet("max-requests")) {
+        bool valid = false;
+        maxRequests = parser.value("max-requests").toInt(&valid);
+
+        if (!valid || maxRequests < 1) {
+            qWarning() << "Invalid max requests:" << parser.value("max-requests");
+            return 1;
+        }
+    }
+
+    int interval = parser.isSet("tracklist") ? TRACKLIST_DEFAULT_WINDOW_STEP_SECONDS : BATCH_DEFAULT_SEGMENT_INTERVAL_SECONDS;
+    if (parser.isSet("interval")) {
+        bool valid = false;
+        interval = parser.value("interval").toInt(&valid);
+
+        if (!valid || interval < 1) {
+            qWarning() << "Invalid interval:" << parser.value("interval");
+            return 1;
+        }
+    }
+
+    BatchIdentifier identifier(&app);
+    identifier.setMaxRequests(maxRequests);
+    identifier.setTracklistMode(parser.isSet("tracklist"));
+    identifier.setSegmentInterval(interval);
+
+    const QSettings settings;
+    const auto indexPath = parser.isSet("index") ? parser.value("index") : settings.value(LOCAL_INDEX_SETTING).toString();
+    if (!indexPath.isEmpty() && !identifier.openLocalIndex(indexPath)) {
+        return 1;
+    }
+
+    QObject::connect(&identifier, &BatchIdentifier::finished, &app, &QCoreApplication::exit);
+    identifier.start(parser.positionalArguments());
+
+    const int result = app.exec();
+    writeTrace();
+    return result;
+}
+
 int main(int argc, char *argv[])
 {
+    if (isBatchMode(argc, argv)) {
+        return runBatchMode(argc, argv);
+    }
+
+    QElapsedTimer startup;
+    startup.start();
+
     // Create an Qt application...
     QApplication app(argc, argv);
     app.setQuitOnLastWindowClosed(false);
 
     QCoreApplication::setOrganizationName(APPLICATION_NAME);
     QCoreApplication::setApplicationName(APPLICATION_NAME);
+    startTracingFromEnvironment();
 
     // ...but not if its already running...
     QString lockFilePath = QDir::temp().absoluteFilePath(APPLICATION_NAME + ".lock");
@@ -44,6 +148,16 @@ int main(int argc, char *argv[])
 
     SongDetector songDetector(&app);
 
+    // Same measurement as SongDetectorDaemon, to compare the two
+    QTimer::singleShot(0, &app, [&startup] {
+        qInfo() << "Started in" << startup.elapsed() << "ms," << residentSetSizeInKiB() << "KiB resident";
+    });
+
+    // Where the time went, over the whole session
+    QObject::connect(&app, &QCoreApplication::aboutToQuit, &logLatencyStats);
+
     // Launch the app!
-    return app.exec();
+    const int result = app.exec();
+    writeTrace();
+    return result;
 }
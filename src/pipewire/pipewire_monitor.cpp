@@ -2,7 +2,6 @@
 #include <QMetaMethod>
 #include <QObject>
 #include <QStringView>
-#include <QTimer>
 #include <pipewire/core.h>
 #include <pipewire/version.h>
 
@@ -19,27 +18,63 @@ extern "C" {
     #include <spa/utils/type.h>
 }
 
+#include "latency_stats.h"
 #include "pipewire_monitor.h"
-
+#include "trace.h"
 
 /*
- * Constructor
+ * The PipeWire thread loop and core connection, kept for as long as any
+ * monitor uses them
  */
-PipeWireMonitor::PipeWireMonitor(QString& applicationName, QAudioDevice* device, QObject* parent) :
-    QObject(parent),
-    m_useDefaultDevice(device == nullptr) {
-        setApplicationName(applicationName);
+struct PipeWireConnection {
+    pw_thread_loop*     loop = nullptr;
+    pw_context*         context = nullptr;
+    pw_core*            core = nullptr;
 
-        if (!m_useDefaultDevice) {
-            QString deviceId = device->id();
-            setDeviceId(&deviceId);
+    PipeWireConnection(const char* name) {
+        pw_init(nullptr, nullptr);
+
+        loop = pw_thread_loop_new(name, nullptr);
+        context = pw_context_new(pw_thread_loop_get_loop(loop), nullptr, 0);
+        core = pw_context_connect(context, nullptr, 0);
+
+        pw_thread_loop_start(loop);
+    }
+
+    ~PipeWireConnection() {
+        pw_thread_loop_stop(loop);
+
+        if (core != nullptr) {
+            pw_core_disconnect(core);
         }
 
-        initializePipewire();
-}
+        pw_context_destroy(context);
+        pw_thread_loop_destroy(loop);
+        pw_deinit();
+    }
+
+    /*
+     * The connection every monitor shares, opened by the first one.
+     * Only called on the main thread.
+     */
+    static std::shared_ptr<PipeWireConnection> shared(const char* name) {
+        static std::weak_ptr<PipeWireConnection> s_connection;
+
+        auto connection = s_connection.lock();
+        if (!connection) {
+            connection = std::make_shared<PipeWireConnection>(name);
+            s_connection = connection;
+        }
 
+        return connection;
+    }
+};
+
+/*
+ * Constructor
+ */
 PipeWireMonitor::PipeWireMonitor(QString& applicationName, QString* deviceId, QObject* parent) :
-    QObject(parent),
+    CaptureSource(parent),
     m_useDefaultDevice(deviceId == nullptr) {
         setApplicationName(applicationName);
 
@@ -51,7 +86,7 @@ PipeWireMonitor::PipeWireMonitor(QString& applicationName, QString* deviceId, QO
 }
 
 PipeWireMonitor::PipeWireMonitor(QString& applicationName, QObject* parent) :
-    QObject(parent),
+    CaptureSource(parent),
     m_useDefaultDevice(true) {
         setApplicationName(applicationName);
         initializePipewire();
@@ -79,72 +114,106 @@ void PipeWireMonitor::setDeviceId(QString* deviceId) {
 PipeWireMonitor::~PipeWireMonitor() {
     if (m_stream != nullptr) {
         pw_thread_loop_lock(m_loop);
+        spa_hook_remove(&m_stream_listener);
         pw_stream_destroy(m_stream);
         m_stream = nullptr;
         pw_thread_loop_unlock(m_loop);
     }
 
-    if (m_context != nullptr) {
-        pw_context_destroy(m_context);
-    }
+    // The last monitor closes the connection
+    m_connection.reset();
+}
 
-    if (m_loop != nullptr) {
-        pw_thread_loop_destroy(m_loop);
-    }
+/***********************************************
+ * Getters
+ ***********************************************/
+
+int PipeWireMonitor::getChannels() {
+    return static_cast<int>(m_negotiatedFormat.load(std::memory_order_acquire) & 0xffffffffu);
+}
 
-    pw_deinit();
+int PipeWireMonitor::getBitsPerSample() {
+    return m_bytesPerSample * 8;
+}
+
+int PipeWireMonitor::getSampleRate() {
+    return static_cast<int>(m_negotiatedFormat.load(std::memory_order_acquire) >> 32);
+}
+
+QString PipeWireMonitor::getPipeWireVersion() {
+    return m_pipeWireVersion;
 }
 
 /*******************************************************
- * Public APIs
+ * Stream hooks
  *******************************************************/
 
-void PipeWireMonitor::startCapture(int minDurationInSeconds, QAudioDevice* device) {
-    qDebug() << "Starting capture";
+AudioFormat PipeWireMonitor::getStreamFormat() {
+    const uint64_t negotiated = m_negotiatedFormat.load(std::memory_order_acquire);
 
+    AudioFormat format;
+    format.sampleRate = static_cast<int>(negotiated >> 32);
+    format.bitsPerSample = getBitsPerSample();
+    format.channels = static_cast<int>(negotiated & 0xffffffffu);
+
+    // connectToStream() always asks for F32
+    format.floatingPoint = true;
+    return format;
+}
+
+bool PipeWireMonitor::startStream() {
     if (!m_stream) {
         qDebug() << "No PipeWire stream!";
-        return;
+        return false;
     }
 
     if (m_loop == nullptr) {
         qDebug() << "No PipeWire loop!";
-        return;
+        return false;
     }
 
-    // Disconnect any existing connections
-    onStopCapture();
-    m_audioBuffer.clear();
-    m_isCapturing = true;
+    pw_thread_loop_lock(m_loop);
 
-    // There must be a better way than waiting 500ms...
-    QTimer::singleShot(500, this, [this] {
-        this->connectToStream();
-    });
-}
+    // Stopped in stateChanged(), once the audio is flowing
+    m_connectTimer.start();
 
-/***********************************************
- * Getters
- ***********************************************/
+    auto state = pw_stream_get_state(m_stream, nullptr);
+    if (state == PW_STREAM_STATE_ERROR) {
+        // The sink went away or the like, so start over
+        qDebug() << "Reconnecting PipeWire stream";
+        pw_stream_disconnect(m_stream);
+        state = pw_stream_get_state(m_stream, nullptr);
+    }
 
-int PipeWireMonitor::getBufferLengthInSeconds() {
-    return m_bufferLengthInSeconds;
-}
+    bool started = true;
+    if (state == PW_STREAM_STATE_UNCONNECTED) {
+        started = connectToStream();
+    } else if (state == PW_STREAM_STATE_STREAMING) {
+        // Never got as far as pausing, so there is nothing to wait for
+        m_connectTimer.invalidate();
+        pw_stream_set_active(m_stream, true);
+    } else {
+        // Connected and negotiated already, just let the audio flow again
+        pw_stream_set_active(m_stream, true);
+    }
 
-int PipeWireMonitor::getChannels() {
-    return m_channels;
+    pw_thread_loop_unlock(m_loop);
+    return started;
 }
 
-int PipeWireMonitor::getBitsPerSample() {
-    return m_bytesPerSample * 8;
-}
+void PipeWireMonitor::stopStream() {
+    if (!m_stream) {
+        return;
+    }
 
-int PipeWireMonitor::getSampleRate() {
-    return m_sampleRate;
-}
+    pw_thread_loop_lock(m_loop);
 
-QString PipeWireMonitor::getPipeWireVersion() {
-    return m_pipeWireVersion;
+    // Stays connected, so the next capture doesn't negotiate all over again
+    if (pw_stream_get_state(m_stream, nullptr) != PW_STREAM_STATE_UNCONNECTED) {
+        pw_stream_set_active(m_stream, false);
+    }
+
+    pw_thread_loop_unlock(m_loop);
 }
 
 /*******************************************************
@@ -152,40 +221,41 @@ QString PipeWireMonitor::getPipeWireVersion() {
  *******************************************************/
 
 void PipeWireMonitor::initializePipewire() {
-    pw_init(nullptr, nullptr);
+    m_connection = PipeWireConnection::shared(m_applicationName.data());
+    m_loop = m_connection->loop;
 
     m_pipeWireVersion = QString(pw_get_library_version());
 
-    m_loop = pw_thread_loop_new(m_applicationName.data(), nullptr);
-    m_context = pw_context_new(pw_thread_loop_get_loop(m_loop), nullptr, 0);
-    m_core = pw_context_connect(m_context, nullptr, 0);
+    if (m_connection->core == nullptr) {
+        qCritical() << "Failed to connect to PipeWire";
+        return;
+    }
 
-    pw_thread_loop_start(m_loop);
     pw_thread_loop_lock(m_loop);
 
     const auto properties = pw_properties_new(
         PW_KEY_MEDIA_TYPE, "Audio",
         PW_KEY_MEDIA_CATEGORY, "Monitor",
         PW_KEY_MEDIA_ROLE, "Music",
-        // Hard code to Bluez monitor for now...
-        // PW_KEY_NODE_TARGET, "bluez_output.AC_80_0A_2B_EC_71.1.monitor"
         PW_KEY_STREAM_CAPTURE_SINK, "true",
         PW_KEY_APP_NAME, m_applicationName.data(),
         NULL);
 
+    // e.g. "bluez_output.AC_80_0A_2B_EC_71.1", rather than the default sink
+    if (!m_useDefaultDevice) {
+        pw_properties_set(properties, PW_KEY_TARGET_OBJECT, m_deviceId.data());
+    }
+
     static const pw_stream_events stream_events = {
         .version = PW_VERSION_STREAM_EVENTS,
-        // .state_changed = AudioStream::onStateChanged,
+        .state_changed = PipeWireMonitor::onStateChanged,
         .param_changed = PipeWireMonitor::onParamChanged,
         .process = PipeWireMonitor::onProcessAudio
     };
 
-    m_stream = pw_stream_new_simple(
-        pw_thread_loop_get_loop(m_loop),
-        m_applicationName.data(),
-        properties,
-        &stream_events,
-        (void *)this);
+    // On the shared connection, rather than pw_stream_new_simple() which
+    // would open one of its own
+    m_stream = pw_stream_new(m_connection->core, m_applicationName.data(), properties);
 
     if (!m_stream) {
         qCritical() << "Failed to create stream";
@@ -193,6 +263,7 @@ void PipeWireMonitor::initializePipewire() {
         return;
     }
 
+    pw_stream_add_listener(m_stream, &m_stream_listener, &stream_events, this);
     pw_thread_loop_unlock(m_loop);
 }
 
@@ -224,17 +295,15 @@ void PipeWireMonitor::negotiateFormat(const struct spa_pod* param) {
     pw_stream_update_params(m_stream, params, 1);
 
     // Store format info
-    m_sampleRate = format.info.raw.rate;
-    m_channels = format.info.raw.channels;
+    m_negotiatedFormat.store((static_cast<uint64_t>(format.info.raw.rate) << 32) | format.info.raw.channels, std::memory_order_release);
 
-    // Re-calculate the minimum buffer size
-    m_minBufferSize = m_sampleRate * m_channels * m_bytesPerSample * m_bufferLengthInSeconds;
-
-    qInfo() << "Final negotiated - Rate:" << m_sampleRate << "Channels:" << m_channels;
+    qInfo() << "Final negotiated - Rate:" << format.info.raw.rate << "Channels:" << format.info.raw.channels;
     qInfo() << "Accepted format and updated params";
 }
 
 void PipeWireMonitor::handleFinalFormat(const struct spa_pod* param) {
+    TraceSpan span("handleFinalFormat", "pipewire");
+
     // Parse the final format
     struct spa_audio_info format;
     if (spa_format_parse(param, &format.media_type, &format.media_subtype) < 0) {
@@ -264,14 +333,15 @@ void PipeWireMonitor::handleFinalFormat(const struct spa_pod* param) {
     else if (format.info.raw.format == SPA_AUDIO_FORMAT_F32)
         format_name = "SPA_AUDIO_FORMAT_F32";
 
-    // Store the final format info
-    m_sampleRate = format.info.raw.rate;
-    m_channels = format.info.raw.channels;
+    // Runs on the PipeWire thread with the loop locked, as does
+    // connectToStream(), so the timer is safe to read
+    recordLatency(LatencyStage::FormatNegotiation, m_negotiationTimer);
+    m_negotiationTimer.invalidate();
 
-    // Re-calculate the minimum buffer size
-    m_minBufferSize = m_sampleRate * m_channels * m_bytesPerSample * m_bufferLengthInSeconds;
+    // Store the final format info
+    m_negotiatedFormat.store((static_cast<uint64_t>(format.info.raw.rate) << 32) | format.info.raw.channels, std::memory_order_release);
 
-    qInfo() << "Final stream parameters - Format:" << format_name << "Rate:" << m_sampleRate << "Channels:" << m_channels;
+    qInfo() << "Final stream parameters - Format:" << format_name << "Rate:" << format.info.raw.rate << "Channels:" << format.info.raw.channels;
 }
 
 void PipeWireMonitor::paramChanged(void* userData, uint32_t id, const struct spa_pod* param) {
@@ -293,74 +363,48 @@ void PipeWireMonitor::paramChanged(void* userData, uint32_t id, const struct spa
 }
 
 void PipeWireMonitor::readFromStream(void *userData) {
-    if (!m_isCapturing.load()) {
-        qDebug() << "Not capturing, ignoring callback";
-        return;
-    }
-
+    // This runs on the PipeWire real-time thread, so there must be no
+    // logging, locking or allocation in here. The audio is copied into
+    // the ring buffer and picked up by onDrainRingBuffer().
     pw_buffer* buf = pw_stream_dequeue_buffer(m_stream);
 
     if (!buf) {
-        qCritical() << "No buffer available";
-        return;
-    }
-
-    if (!buf->buffer->datas[0].data) {
-        qWarning() << "Buffer data is null";
-        pw_stream_queue_buffer(m_stream, buf);
         return;
     }
 
-    // Get the PCM data from the buf
-    const char* raw_pcm = static_cast<const char*>(buf->buffer->datas[0].data);
-    int pcm_data_size = buf->buffer->datas[0].chunk->size;
+    const spa_data& data = buf->buffer->datas[0];
 
-    m_audioBuffer.append(raw_pcm, pcm_data_size);
-    if (m_audioBuffer.size() < m_minBufferSize) {
-        pw_stream_queue_buffer(m_stream, buf);
-        return;
+    if (isCapturing() && data.data != nullptr) {
+        // Get the PCM data from the buf
+        const char* raw_pcm = static_cast<const char*>(data.data) + data.chunk->offset;
+        m_ringBuffer.write(raw_pcm, data.chunk->size);
     }
 
-    m_isCapturing = false;
-
-    // Can't modify the PipeWire thread from within the thread itself,
-    // so defer this to the main UI thread:
-    QMetaObject::invokeMethod(this, "onStopCapture", Qt::QueuedConnection);
-
-    // Can't send signals from the PipeWire thread,
-    // so defer this to the main UI thread:
-    QMetaObject::invokeMethod(this, "captureCompleted", Qt::QueuedConnection, Q_ARG(QByteArray, m_audioBuffer));
-    return;
+    pw_stream_queue_buffer(m_stream, buf);
 }
 
-void PipeWireMonitor::onStopCapture() {
-    qDebug() << "Stopping capture";
-
-    m_isCapturing = false;
-
-    if (!m_stream) {
-        return;
-    }
-
-    pw_thread_loop_lock(m_loop);
+void PipeWireMonitor::stateChanged(enum pw_stream_state state, const char* error) {
+    // Runs on the PipeWire thread with the loop locked
+    TraceSpan span("stateChanged", "pipewire");
+    qDebug() << "PipeWire stream" << pw_stream_state_as_string(state);
 
-    if (pw_stream_get_state(m_stream, nullptr) != PW_STREAM_STATE_UNCONNECTED) {
-        pw_stream_disconnect(m_stream);
+    switch (state) {
+        case PW_STREAM_STATE_STREAMING:
+            recordLatency(LatencyStage::StreamConnect, m_connectTimer);
+            m_connectTimer.invalidate();
+            break;
+        case PW_STREAM_STATE_ERROR:
+            qWarning() << "PipeWire stream error:" << error;
+            break;
+        default:
+            break;
     }
-
-    pw_thread_loop_unlock(m_loop);
 }
 
-void PipeWireMonitor::connectToStream() {
-    pw_thread_loop_lock(m_loop);
-
-    enum pw_stream_state current_state = pw_stream_get_state(m_stream, nullptr);
-
-    if (current_state != PW_STREAM_STATE_UNCONNECTED) {
-        qCritical() << "Stream not in unconnected state, aborting";
-        pw_thread_loop_unlock(m_loop);
-        return;
-    }
+bool PipeWireMonitor::connectToStream() {
+    // Called with the loop locked
+    TraceSpan span("connectToStream", "pipewire");
+    m_negotiationTimer.start();
 
     uint8_t buffer[1024];
     struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
@@ -379,11 +423,11 @@ void PipeWireMonitor::connectToStream() {
 
     if (result < 0) {
         qDebug() << "Error connecting to stream: " << result;
-    } else {
-        qDebug() << "Connected to stream";
+        return false;
     }
 
-    pw_thread_loop_unlock(m_loop);
+    qDebug() << "Connected to stream";
+    return true;
 }
 
 /******************************
@@ -394,7 +438,13 @@ void PipeWireMonitor::onParamChanged(void* userData, uint32_t id, const struct s
     static_cast<PipeWireMonitor*>(userData)->paramChanged(userData, id, param);
 }
 
+void PipeWireMonitor::onStateChanged(void* userData, enum pw_stream_state old, enum pw_stream_state state, const char* error) {
+    static_cast<PipeWireMonitor*>(userData)->stateChanged(state, error);
+}
+
 void PipeWireMonitor::onProcessAudio(void* userData) {
+    TraceSpan span("process", "pipewire");
+
     auto* self = static_cast<PipeWireMonitor*>(userData);
     self->readFromStream(userData);
 }
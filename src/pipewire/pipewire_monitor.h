@@ -1,52 +1,51 @@
 #pragma once
 
+#include <QElapsedTimer>
 #include <QObject>
-#include <QAudioDevice>
 #include <pipewire/pipewire.h>
 #include <qcontainerfwd.h>
 #include <qobject.h>
 #include <qscopedpointer.h>
-
-class PipeWireMonitor : public QObject {
+#include <atomic>
+#include <memory>
+
+#include "audio/audio_format.h"
+#include "capture/capture_source.h"
+
+struct PipeWireConnection;
+
+/*
+ * Captures what is playing from PipeWire, by monitoring the default sink
+ * or the node named by `deviceId`.
+ *
+ * Every monitor in the process shares one PipeWire thread and connection,
+ * so monitoring another sink only costs another stream.
+ *
+ * The stream is connected, and its format negotiated, by the first
+ * capture and then stays connected. Later captures only make it active
+ * again, so audio flows within a quantum or two of asking for it.
+ */
+class PipeWireMonitor : public CaptureSource {
     Q_OBJECT
 
     public:
-        PipeWireMonitor(QString& applicationName, QAudioDevice* device = nullptr, QObject* parent = nullptr);
         PipeWireMonitor(QString& applicationName, QString* deviceId = nullptr, QObject* parent = nullptr);
         PipeWireMonitor(QString& applicationName, QObject* parent = nullptr);
         ~PipeWireMonitor();
 
-        void    startCapture(int minDurationInSeconds, QAudioDevice* device = nullptr);
-
         /*
-         * Getters
+         * Getters. The sample rate, bits per sample and channels are those
+         * of the PipeWire stream.
          */
-        int     getBufferLengthInSeconds();
         int     getSampleRate();
         int     getBitsPerSample();
         int     getChannels();
         QString getPipeWireVersion();
 
-    signals:
-
-        /*
-         * Raised when the stream has started capturing
-         */
-        void started();
-
-        /*
-         * Raised when the monitor has read at least `minDurationInSeconds`
-         * of data.
-         */
-        void captureCompleted(QByteArray buffer);
-
-        // TODO: Progress indicator
-        // void progressUpdate(int secondsProcessed);
-
-    public slots:
-        void    onStopCapture();
-        // TODO: Support cancellation
-        // void cancelCapture();
+    protected:
+        bool        startStream() override;
+        void        stopStream() override;
+        AudioFormat getStreamFormat() override;
 
     private:
         void                initializePipewire();
@@ -56,7 +55,8 @@ class PipeWireMonitor : public QObject {
         void                negotiateFormat(const struct spa_pod* param);
         void                handleFinalFormat(const struct spa_pod* param);
         void                readFromStream(void *userData);
-        void                connectToStream();
+        void                stateChanged(enum pw_stream_state state, const char* error);
+        bool                connectToStream();
 
         /*
          * These are char* because that is what the PipeWire API needs
@@ -69,27 +69,20 @@ class PipeWireMonitor : public QObject {
         // True if m_deviceId has not been set
         const bool          m_useDefaultDevice;
 
-        // Makes sure that we don't keep modifying m_audioBuffer
-        // once we have enough data.
-        std::atomic<bool>   m_isCapturing{true};
-
-        // Stores the captured audio in PCM format
-        QByteArray          m_audioBuffer;
-
         /*
         * PipeWire event handlers
         */
         static void     onProcessAudio(void *userData);
         static void     onParamChanged(void *userData, uint32_t id, const struct spa_pod *param);
+        static void     onStateChanged(void *userData, enum pw_stream_state old, enum pw_stream_state state, const char *error);
 
         /*
-         * PipeWire data structures
+         * PipeWire data structures. m_loop is the shared connection's.
          */
+        std::shared_ptr<PipeWireConnection> m_connection;
         pw_thread_loop      *m_loop = nullptr;
-        pw_context*         m_context = nullptr;
         pw_properties*      m_properties = nullptr;
-        pw_core*            m_core = nullptr;
-        pw_stream*          m_stream;
+        pw_stream*          m_stream = nullptr;
         struct spa_hook     m_stream_listener = {};
         struct pw_registry  *m_registry = nullptr;
         struct spa_hook     m_registry_listener;
@@ -97,9 +90,15 @@ class PipeWireMonitor : public QObject {
         uint32_t            m_monitor_fr_port_id = 0;
         uint32_t            m_input_port_id = 0;
 
-        int                 m_sampleRate  = 44100;  // Sample rate
-        int                 m_channels    = 1;      // Number of channels
+        // Sample rate << 32 | channels, written on the PipeWire thread as
+        // the format is agreed and read by the drain on the main thread.
+        // Packed so the two are always read from the same negotiation.
+        std::atomic<uint64_t> m_negotiatedFormat = (44100ull << 32) | 1;
         int                 m_bytesPerSample = 4;   // Bytes per sample
-        int                 m_bufferLengthInSeconds = 15;
-        int                 m_minBufferSize = 0; // m_sampleRate * m_channels * m_bytesPerSample * m_bufferLengthInSeconds;
+
+        // Time from asking for audio until the stream is streaming, and
+        // from connecting until the format is agreed. Only used with the
+        // loop locked.
+        QElapsedTimer       m_connectTimer;
+        QElapsedTimer       m_negotiationTimer;
 };
@@ -0,0 +1,28 @@
+#include <QFile>
+
+#include "process_stats.h"
+
+static qint64 readStatusField(const QByteArray& field) {
+    QFile status(QStringLiteral("/proc/self/status"));
+    if (!status.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return -1;
+    }
+
+    // Lines look like "VmRSS:     12345 kB"
+    while (!status.atEnd()) {
+        const QByteArray line = status.readLine();
+        if (line.startsWith(field)) {
+            return line.mid(field.size()).trimmed().split(' ').first().toLongLong();
+        }
+    }
+
+    return -1;
+}
+
+qint64 residentSetSizeInKiB() {
+    return readStatusField("VmRSS:");
+}
+
+qint64 peakResidentSetSizeInKiB() {
+    return readStatusField("VmHWM:");
+}
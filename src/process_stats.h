@@ -0,0 +1,14 @@
+#pragma once
+
+#include <QtGlobal>
+
+/*
+ * Footprint of this process, for comparing the tray app and the daemon.
+ * Both return -1 where /proc isn't available.
+ */
+
+// Resident set size
+qint64  residentSetSizeInKiB();
+
+// Peak resident set size since the process started
+qint64  peakResidentSetSizeInKiB();
@@ -2,3 +2,25 @@
 
 #define DARK_TRAY_ICON_SETTING QStringLiteral("darkModeIcon")
 #define SELECTED_DEVICE_SETTING QStringLiteral("deviceId")
+#define CONTINUOUS_CAPTURE_SETTING QStringLiteral("continuousCapture")
+#define PREROLL_LENGTH_SETTING QStringLiteral("prerollSeconds")
+#define STREAMING_FINGERPRINT_SETTING QStringLiteral("streamingFingerprint")
+#define PROGRESSIVE_IDENTIFY_SETTING QStringLiteral("progressiveIdentify")
+#define FINGERPRINT_ENGINE_SETTING QStringLiteral("fingerprintEngine")
+#define LOCAL_INDEX_SETTING QStringLiteral("localIndexPath")
+#define SILENCE_GATE_SETTING QStringLiteral("silenceGate")
+#define AUTO_IDENTIFY_SETTING QStringLiteral("autoIdentify")
+#define CAPTURE_SOURCES_SETTING QStringLiteral("captureSources")
+#define LOOKUP_FAIRNESS_SETTING QStringLiteral("lookupFairness")
+#define HEDGE_PERCENTILE_SETTING QStringLiteral("hedgePercentile")
+
+#define FINGERPRINT_ENGINE_NATIVE QStringLiteral("native")
+#define FINGERPRINT_ENGINE_VIBRA QStringLiteral("vibra")
+
+#define LOOKUP_FAIRNESS_IN_ORDER QStringLiteral("inOrder")
+#define LOOKUP_FAIRNESS_ROUND_ROBIN QStringLiteral("roundRobin")
+
+#define DEFAULT_PREROLL_LENGTH_IN_SECONDS 15
+
+// Signature lengths sent early by progressive identification
+#define PROGRESSIVE_CHECKPOINTS_IN_SECONDS { 3, 6, 10 }
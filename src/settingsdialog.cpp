@@ -3,6 +3,7 @@
 #include <QComboBox>
 #include <QMediaDevices>
 #include <QObject>
+#include <QSpinBox>
 
 #include "settingsdialog.h"
 #include "ui_settingsdialog.h"
@@ -21,10 +22,19 @@ SettingsDialog::SettingsDialog(QSettings *settings)
             ui->darkModeIcon->setCheckState(Qt::CheckState::Unchecked);
         }
 
+        ui->continuousCapture->setChecked(m_settings->value(CONTINUOUS_CAPTURE_SETTING, false).toBool());
+        ui->prerollLength->setValue(m_settings->value(PREROLL_LENGTH_SETTING, DEFAULT_PREROLL_LENGTH_IN_SECONDS).toInt());
+        ui->prerollLength->setEnabled(ui->continuousCapture->isChecked());
+        ui->autoIdentify->setChecked(m_settings->value(AUTO_IDENTIFY_SETTING, false).toBool());
+        ui->autoIdentify->setEnabled(ui->continuousCapture->isChecked());
+
         updateAudioDevices();
         connect(m_mediaDevices, &QMediaDevices::audioOutputsChanged, this, &SettingsDialog::updateAudioDevices);
         connect(ui->audioDeviceCombo, &QComboBox::currentIndexChanged, this, &SettingsDialog::onDeviceChanged);
         connect(ui->darkModeIcon, &QCheckBox::clicked, this, &SettingsDialog::setForceDarkMode);
+        connect(ui->continuousCapture, &QCheckBox::clicked, this, &SettingsDialog::setContinuousCapture);
+        connect(ui->prerollLength, &QSpinBox::valueChanged, this, &SettingsDialog::setPrerollLength);
+        connect(ui->autoIdentify, &QCheckBox::clicked, this, &SettingsDialog::setAutoIdentify);
         connect(ui->buttonBox, &QDialogButtonBox::clicked, this, &SettingsDialog::close);
         setMaximumSize(size());
         setMinimumSize(size());
@@ -67,3 +77,20 @@ void SettingsDialog::setForceDarkMode(bool checked) {
     m_settings->setValue(DARK_TRAY_ICON_SETTING, QVariant(checked));
     forceDarkModeChanged();
 }
+
+void SettingsDialog::setContinuousCapture(bool checked) {
+    m_settings->setValue(CONTINUOUS_CAPTURE_SETTING, QVariant(checked));
+    ui->prerollLength->setEnabled(checked);
+    ui->autoIdentify->setEnabled(checked);
+    continuousCaptureChanged();
+}
+
+void SettingsDialog::setPrerollLength(int seconds) {
+    m_settings->setValue(PREROLL_LENGTH_SETTING, QVariant(seconds));
+    continuousCaptureChanged();
+}
+
+void SettingsDialog::setAutoIdentify(bool checked) {
+    m_settings->setValue(AUTO_IDENTIFY_SETTING, QVariant(checked));
+    continuousCaptureChanged();
+}
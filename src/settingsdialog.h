@@ -26,9 +26,13 @@ private:
 
 signals:
     void forceDarkModeChanged();
+    void continuousCaptureChanged();
     void currentDeviceChanged(const QString& deviceId);
 
 private slots:
      void updateAudioDevices();
      void setForceDarkMode(bool checked);
+     void setContinuousCapture(bool checked);
+     void setPrerollLength(int seconds);
+     void setAutoIdentify(bool checked);
 };
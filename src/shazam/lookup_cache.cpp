@@ -0,0 +1,139 @@
+#include <QDebug>
+#include <QSet>
+
+#include "lookup_cache.h"
+
+LookupCache::LookupCache() {
+}
+
+std::optional<ShazamResponse> LookupCache::find(const SignatureSketch& sketch) {
+    removeExpired();
+
+    if (sketch.isEmpty()) {
+        m_misses++;
+        return std::nullopt;
+    }
+
+    // Only entries that share at least one band are worth comparing
+    QSet<quint64> candidates;
+    for (const quint64 key : bandKeys(sketch)) {
+        for (auto it = m_buckets.constFind(key); it != m_buckets.cend() && it.key() == key; ++it) {
+            candidates.insert(it.value());
+        }
+    }
+
+    const Entry* best = nullptr;
+    double bestSimilarity = LOOKUP_CACHE_MIN_SIMILARITY;
+
+    for (const quint64 id : candidates) {
+        const Entry& entry = *m_entries.constFind(id);
+        const double similarity = sketch.similarity(entry.sketch);
+
+        if (similarity >= bestSimilarity) {
+            best = &entry;
+            bestSimilarity = similarity;
+        }
+    }
+
+    if (best == nullptr) {
+        m_misses++;
+        return std::nullopt;
+    }
+
+    m_hits++;
+    qDebug() << "Lookup cache hit, similarity" << bestSimilarity;
+    return best->response;
+}
+
+void LookupCache::insert(const SignatureSketch& sketch, const ShazamResponse& response) {
+    if (sketch.isEmpty()) {
+        return;
+    }
+
+    removeExpired();
+
+    // Make room by dropping whatever expires first
+    while (m_entries.size() >= LOOKUP_CACHE_MAX_ENTRIES) {
+        auto oldest = m_entries.cbegin();
+        for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it) {
+            if (it->expiry.deadline() < oldest->expiry.deadline()) {
+                oldest = it;
+            }
+        }
+        remove(oldest.key());
+    }
+
+    const quint64 id = m_nextId++;
+    m_entries.insert(id, { sketch, response, QDeadlineTimer(LOOKUP_CACHE_TTL_SECONDS * 1000) });
+
+    for (const quint64 key : bandKeys(sketch)) {
+        m_buckets.insert(key, id);
+    }
+}
+
+void LookupCache::clear() {
+    m_entries.clear();
+    m_buckets.clear();
+}
+
+/*
+ * Getters
+ */
+
+quint64 LookupCache::getHits() const {
+    return m_hits;
+}
+
+quint64 LookupCache::getMisses() const {
+    return m_misses;
+}
+
+qsizetype LookupCache::getSize() const {
+    return m_entries.size();
+}
+
+/*******************************************************
+ * Private methods
+ *******************************************************/
+
+void LookupCache::removeExpired() {
+    QList<quint64> expired;
+    for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it) {
+        if (it->expiry.hasExpired()) {
+            expired.append(it.key());
+        }
+    }
+
+    for (const quint64 id : expired) {
+        remove(id);
+    }
+}
+
+void LookupCache::remove(quint64 id) {
+    const auto it = m_entries.constFind(id);
+    if (it == m_entries.cend()) {
+        return;
+    }
+
+    for (const quint64 key : bandKeys(it->sketch)) {
+        m_buckets.remove(key, id);
+    }
+
+    m_entries.erase(it);
+}
+
+QList<quint64> LookupCache::bandKeys(const SignatureSketch& sketch) const {
+    QList<quint64> keys;
+    keys.reserve(SKETCH_HASH_COUNT / LOOKUP_CACHE_ROWS_PER_BAND);
+
+    for (int band = 0; band < SKETCH_HASH_COUNT / LOOKUP_CACHE_ROWS_PER_BAND; band++) {
+        // FNV-1a over the band number and its values
+        quint64 key = 0xcbf29ce484222325ull ^ static_cast<quint64>(band);
+        for (int row = 0; row < LOOKUP_CACHE_ROWS_PER_BAND; row++) {
+            key = (key ^ sketch.getValue(band * LOOKUP_CACHE_ROWS_PER_BAND + row)) * 0x100000001b3ull;
+        }
+        keys.append(key);
+    }
+
+    return keys;
+}
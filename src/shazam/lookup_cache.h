@@ -0,0 +1,81 @@
+#pragma once
+
+#include <QDeadlineTimer>
+#include <QHash>
+#include <QMultiHash>
+#include <optional>
+
+#include "fingerprint/signature_sketch.h"
+#include "shazam_response.h"
+
+// How long a successful lookup is remembered for, roughly one song
+#define LOOKUP_CACHE_TTL_SECONDS 300
+
+// Upper bound on the number of remembered lookups
+#define LOOKUP_CACHE_MAX_ENTRIES 256
+
+// Estimated share of landmarks two captures must have in common to be
+// treated as the same song. Unrelated music scores close to zero, and a
+// capture has to share about half its audio with a cached one to score 0.3.
+#define LOOKUP_CACHE_MIN_SIMILARITY 0.3
+
+// Sketch values per LSH band, giving 42 bands of 3 out of the 128 values.
+// A cached capture with Jaccard similarity s is a candidate with
+// probability 1 - (1 - s^3)^42, an S-curve that crosses 1/2 at s = 0.29,
+// just under the threshold, so the buckets rather than the threshold
+// decide which entries are compared. Counting both the buckets and the
+// 128 value estimate, a capture with similarity
+//   0.1 or less (different music) is answered from the cache ~0% of the time
+//   0.2                        0.1%  (false positives)
+//   0.25                       5%
+//   0.3                        33%
+//   0.4                        93%   (false negatives 7%)
+//   0.5 or more (same song)    over 99.6%
+#define LOOKUP_CACHE_ROWS_PER_BAND 3
+
+/*
+ * Remembers recent Shazam results by what their audio sounded like.
+ *
+ * Every capture gives a slightly different signature, so results can't be
+ * looked up by URI. Instead each result is stored against a MinHash sketch
+ * of its signature, bucketed by locality-sensitive hashing, and a new
+ * capture that is close enough to a recent one gets that one's result.
+ */
+class LookupCache {
+    public:
+        LookupCache();
+
+        /*
+         * Returns the result of a recent lookup whose signature is similar
+         * to `sketch`, and counts a hit or a miss
+         */
+        std::optional<ShazamResponse>   find(const SignatureSketch& sketch);
+
+        void        insert(const SignatureSketch& sketch, const ShazamResponse& response);
+        void        clear();
+
+        /*
+         * Getters
+         */
+        quint64     getHits() const;
+        quint64     getMisses() const;
+        qsizetype   getSize() const;
+
+    private:
+        struct Entry {
+            SignatureSketch sketch;
+            ShazamResponse  response;
+            QDeadlineTimer  expiry;
+        };
+
+        void            removeExpired();
+        void            remove(quint64 id);
+        QList<quint64>  bandKeys(const SignatureSketch& sketch) const;
+
+        QHash<quint64, Entry>       m_entries;
+        QMultiHash<quint64, quint64> m_buckets;     // Band key -> entry id
+        quint64                     m_nextId = 1;
+
+        quint64                     m_hits = 0;
+        quint64                     m_misses = 0;
+};
@@ -0,0 +1,188 @@
+#include <QRandomGenerator>
+#include <algorithm>
+#include <limits>
+
+#include "lookup_scheduler.h"
+
+void LookupScheduler::setMaxInFlight(int maxInFlight) {
+    m_maxInFlight = std::max(1, maxInFlight);
+}
+
+int LookupScheduler::getMaxInFlight() const {
+    return m_maxInFlight;
+}
+
+void LookupScheduler::setFairness(LookupFairness fairness) {
+    m_fairness = fairness;
+}
+
+LookupFairness LookupScheduler::getFairness() const {
+    return m_fairness;
+}
+
+bool LookupScheduler::enqueue(quint64 requestId, const QString& uri, int lengthInSeconds, int source) {
+    const auto existing = m_byUri.constFind(uri);
+    if (existing != m_byUri.constEnd()) {
+        m_waiting.insert(*existing, requestId);
+        m_coalesced++;
+        return false;
+    }
+
+    Lookup lookup;
+    lookup.requestId = requestId;
+    lookup.uri = uri;
+    lookup.lengthInSeconds = lengthInSeconds;
+    lookup.source = source;
+
+    m_byUri.insert(uri, requestId);
+    m_queue.append(lookup);
+    return true;
+}
+
+std::optional<LookupScheduler::Lookup> LookupScheduler::next() {
+    if (m_queue.isEmpty() || m_inFlight.size() >= m_maxInFlight || !m_backoffUntil.hasExpired()) {
+        return std::nullopt;
+    }
+
+    Lookup lookup = m_queue.takeAt(m_fairness == LookupFairness::RoundRobin ? nextRoundRobin() : 0);
+    lookup.attempts++;
+    m_lastSource = lookup.source;
+    m_inFlight.insert(lookup.requestId, lookup);
+    return lookup;
+}
+
+bool LookupScheduler::throttled(quint64 requestId, qint64 retryAfterMs) {
+    // Back off whether or not this one is retried, the server wants a rest
+    backOff(retryAfterMs);
+
+    const auto lookup = m_inFlight.constFind(requestId);
+    if (lookup == m_inFlight.constEnd() || lookup->attempts >= LOOKUP_SCHEDULER_MAX_ATTEMPTS) {
+        return false;
+    }
+
+    // Ahead of everything queued since, it has waited longest
+    m_queue.prepend(*lookup);
+    m_inFlight.erase(lookup);
+    return true;
+}
+
+void LookupScheduler::backOff(qint64 retryAfterMs) {
+    m_throttled++;
+
+    m_backoffMs = m_backoffMs == 0 ? LOOKUP_SCHEDULER_INITIAL_BACKOFF_MS :
+        std::min<qint64>(m_backoffMs * 2, LOOKUP_SCHEDULER_MAX_BACKOFF_MS);
+
+    const double jitter = 1.0 + LOOKUP_SCHEDULER_BACKOFF_JITTER * (2 * QRandomGenerator::global()->generateDouble() - 1);
+    const auto delay = std::max(static_cast<qint64>(m_backoffMs * jitter), retryAfterMs);
+
+    // Lookups that were already in flight don't push the backoff out again
+    if (delay > m_backoffUntil.remainingTime()) {
+        m_backoffUntil.setRemainingTime(delay);
+    }
+}
+
+QList<quint64> LookupScheduler::finish(quint64 requestId, bool succeeded) {
+    QList<quint64> requestIds = { requestId };
+
+    const auto lookup = m_inFlight.constFind(requestId);
+    if (lookup != m_inFlight.constEnd()) {
+        m_byUri.remove(lookup->uri);
+        m_inFlight.erase(lookup);
+    }
+
+    QList<quint64> waiting = m_waiting.values(requestId);
+    std::sort(waiting.begin(), waiting.end());
+    requestIds.append(waiting);
+    m_waiting.remove(requestId);
+
+    if (succeeded) {
+        m_backoffMs = 0;
+    }
+
+    return requestIds;
+}
+
+bool LookupScheduler::cancel(quint64 requestId) {
+    if (m_waiting.contains(requestId)) {
+        return false;
+    }
+
+    // Only waiting on another lookup, which carries on without it
+    for (auto it = m_waiting.begin(); it != m_waiting.end(); ++it) {
+        if (it.value() == requestId) {
+            m_waiting.erase(it);
+            return true;
+        }
+    }
+
+    const auto lookup = m_inFlight.constFind(requestId);
+    if (lookup != m_inFlight.constEnd()) {
+        m_byUri.remove(lookup->uri);
+        m_inFlight.erase(lookup);
+        return true;
+    }
+
+    for (qsizetype i = 0; i < m_queue.size(); i++) {
+        if (m_queue[i].requestId == requestId) {
+            m_byUri.remove(m_queue[i].uri);
+            m_queue.removeAt(i);
+            break;
+        }
+    }
+
+    return true;
+}
+
+void LookupScheduler::clear() {
+    m_queue.clear();
+    m_inFlight.clear();
+    m_byUri.clear();
+    m_waiting.clear();
+}
+
+qint64 LookupScheduler::getBackoffRemaining() const {
+    return m_backoffUntil.remainingTime();
+}
+
+/*******************************************************
+ * Private methods
+ *******************************************************/
+
+qsizetype LookupScheduler::nextRoundRobin() const {
+    // The oldest lookup of the first source after the last one served,
+    // wrapping round to the lowest
+    qsizetype best = 0;
+    qint64 bestTurn = std::numeric_limits<qint64>::max();
+
+    for (qsizetype i = 0; i < m_queue.size(); i++) {
+        const qint64 source = m_queue[i].source;
+        const qint64 turn = source > m_lastSource ? source : source + (qint64(1) << 32);
+
+        if (turn < bestTurn) {
+            best = i;
+            bestTurn = turn;
+        }
+    }
+
+    return best;
+}
+
+/***********************************************
+ * Getters
+ ***********************************************/
+
+qsizetype LookupScheduler::getQueued() const {
+    return m_queue.size();
+}
+
+qsizetype LookupScheduler::getInFlight() const {
+    return m_inFlight.size();
+}
+
+quint64 LookupScheduler::getCoalesced() const {
+    return m_coalesced;
+}
+
+quint64 LookupScheduler::getThrottled() const {
+    return m_throttled;
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <QDeadlineTimer>
+#include <QHash>
+#include <QList>
+#include <QMultiHash>
+#include <QString>
+#include <optional>
+
+// Lookups allowed in flight at once, unless told otherwise
+#define LOOKUP_SCHEDULER_DEFAULT_MAX_IN_FLIGHT 4
+
+// After a throttled (429) or failed (5xx) response nothing is sent for
+// this long, doubling every time it happens again, up to the maximum.
+// The delay is randomised by up to this fraction either way, so several
+// clients don't all come back at once.
+#define LOOKUP_SCHEDULER_INITIAL_BACKOFF_MS 1000
+#define LOOKUP_SCHEDULER_MAX_BACKOFF_MS 60000
+#define LOOKUP_SCHEDULER_BACKOFF_JITTER 0.2
+
+// Times a lookup is sent before a throttled response is taken as final
+#define LOOKUP_SCHEDULER_MAX_ATTEMPTS 3
+
+enum class LookupFairness {
+    // Sent in the order they were made
+    InOrder,
+
+    // Capture sources take turns, so one that makes a lot of lookups
+    // can't hold up the others
+    RoundRobin
+};
+
+/*
+ * Decides when Shazam lookups go out.
+ *
+ * Lookups are queued in the order they are made, and at most
+ * `maxInFlight` are sent at once. A lookup of a signature that is already
+ * queued or in flight isn't sent again, it shares the result of the first
+ * one. Throttled lookups go back to the front of the queue, and nothing is
+ * sent until an exponential backoff (or the server's Retry-After) has
+ * passed. A successful response resets the backoff.
+ *
+ * Each lookup is tagged with the capture source it came from, and with
+ * round robin fairness the sources are served in turn rather than in the
+ * order their lookups were made.
+ *
+ * Only keeps the books, Shazam does the sending. Not thread safe.
+ */
+class LookupScheduler {
+    public:
+        struct Lookup {
+            quint64     requestId = 0;
+            QString     uri;
+            int         lengthInSeconds = 0;
+            int         source = 0;
+            int         attempts = 0;
+        };
+
+        void        setMaxInFlight(int maxInFlight);
+        int         getMaxInFlight() const;
+
+        void            setFairness(LookupFairness fairness);
+        LookupFairness  getFairness() const;
+
+        /*
+         * Queues a lookup. Returns false if the same signature is already
+         * queued or in flight, `requestId` then gets the same result.
+         */
+        bool        enqueue(quint64 requestId, const QString& uri, int lengthInSeconds, int source = 0);
+
+        /*
+         * The next lookup to send, which is then counted as in flight.
+         * Nothing while backing off or with too many in flight already.
+         */
+        std::optional<Lookup>   next();
+
+        /*
+         * Puts a throttled lookup back in the queue and backs off. Returns
+         * false, and leaves it in flight, if it has run out of attempts.
+         */
+        bool        throttled(quint64 requestId, qint64 retryAfterMs);
+
+        /*
+         * Backs off without retrying anything, for a throttled response to
+         * a lookup that may still be answered by another request
+         */
+        void        backOff(qint64 retryAfterMs);
+
+        /*
+         * Ends a lookup, successful or not, and returns every request id
+         * waiting on its result, `requestId` first
+         */
+        QList<quint64>  finish(quint64 requestId, bool succeeded);
+
+        /*
+         * Forgets a lookup that is no longer wanted. Returns false, and
+         * leaves it be, if other requests are waiting on its result.
+         */
+        bool        cancel(quint64 requestId);
+
+        /*
+         * Forgets every queued and in flight lookup. The backoff stays,
+         * the server is still throttling.
+         */
+        void        clear();
+
+        /*
+         * Milliseconds until lookups can be sent again, 0 if they can now
+         */
+        qint64      getBackoffRemaining() const;
+
+        /*
+         * Getters
+         */
+        qsizetype   getQueued() const;
+        qsizetype   getInFlight() const;
+        quint64     getCoalesced() const;
+        quint64     getThrottled() const;
+
+    private:
+        qsizetype   nextRoundRobin() const;
+
+        QList<Lookup>               m_queue;
+        QHash<quint64, Lookup>      m_inFlight;
+
+        // Signature URI -> the request id that is sending it, and the
+        // request ids sharing its result
+        QHash<QString, quint64>     m_byUri;
+        QMultiHash<quint64, quint64> m_waiting;
+
+        int                         m_maxInFlight = LOOKUP_SCHEDULER_DEFAULT_MAX_IN_FLIGHT;
+        LookupFairness              m_fairness = LookupFairness::InOrder;
+        int                         m_lastSource = -1;
+        qint64                      m_backoffMs = 0;
+        QDeadlineTimer              m_backoffUntil;
+
+        quint64                     m_coalesced = 0;
+        quint64                     m_throttled = 0;
+};
@@ -1,71 +1,482 @@
 #include <QNetworkRequest>
-#include <QRestAccessManager>
 #include <QRestReply>
+#include <QSslConfiguration>
+#include <QUrl>
 #include <QUuid>
 #include <qobject.h>
 #include <qobjectdefs.h>
+#include <algorithm>
 
+#include "latency_stats.h"
 #include "shazam.h"
 #include "shazam_body.h"
 #include "shazam_response.h"
+#include "trace.h"
 
-Shazam::Shazam(QObject* parent) : QObject(parent) {
+static const char* lookupTraceName(bool hedge) {
+    return hedge ? "shazamHedge" : "shazamLookup";
 }
 
-void Shazam::detectFromUri(const QString& uri, const int bufferLengthInSeconds) {
-    const auto networkAccessManager = new QNetworkAccessManager(this);
-    const auto restAccessManager = new QRestAccessManager(networkAccessManager, this);
+Shazam::Shazam(QObject* parent) :
+    QObject(parent),
+    m_networkAccessManager(this),
+    m_restAccessManager(&m_networkAccessManager, this),
+    m_hedgeNetworkAccessManager(this),
+    m_hedgeRestAccessManager(&m_hedgeNetworkAccessManager, this),
+    m_url(qEnvironmentVariableIsEmpty(SHAZAM_URL_ENVIRONMENT_VARIABLE) ?
+        SHAZAM_URL : qEnvironmentVariable(SHAZAM_URL_ENVIRONMENT_VARIABLE)) {
+        m_networkAccessManager.setTransferTimeout(SHAZAM_TRANSFER_TIMEOUT_MS);
+        m_hedgeNetworkAccessManager.setTransferTimeout(SHAZAM_TRANSFER_TIMEOUT_MS);
 
-    ShazamBody shazamBody(uri, bufferLengthInSeconds);
-    const auto jsonBody = shazamBody.toJsonDocument();
+        if (!m_url.endsWith('/')) {
+            m_url += '/';
+        }
 
-    const QString url =
-        SHAZAM_URL +
-        QUuid::createUuid().toString(QUuid::WithoutBraces) +
-        "/" +
-        QUuid::createUuid().toString(QUuid::WithoutBraces) +
-        SHAZAM_QUERY_PARAMS;
+        m_backoffTimer.setSingleShot(true);
+        connect(&m_backoffTimer, &QTimer::timeout, this, &Shazam::sendQueued);
+}
 
-    auto request = QNetworkRequest(QUrl(url));
-    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
-    request.setHeader(QNetworkRequest::UserAgentHeader, "Dalvik/2.1.0 (Linux; U; Android 6.0.1; SM-G920F Build/MMB29K)");
-    request.setRawHeader("Accept", "*/*");
-    request.setRawHeader("Connection", "keep-alive");
-    request.setRawHeader("Content-Language", "en_US");
+void Shazam::warmUp() {
+    // Offer HTTP/2 during the handshake, so the pre-connected session is
+    // the one the lookup goes out on
+    auto sslConfiguration = QSslConfiguration::defaultConfiguration();
+    sslConfiguration.setAllowedNextProtocols({
+        QSslConfiguration::ALPNProtocolHTTP2,
+        QSslConfiguration::NextProtocolHttp1_1
+    });
 
-    const auto response = restAccessManager->post(request, jsonBody);
-    QObject::connect(response, &QNetworkReply::finished, this, &Shazam::onShazamResponse);
+    const QUrl url(m_url);
+    const auto preconnect = [&](QNetworkAccessManager& networkAccessManager) {
+        if (url.scheme() == "https") {
+            networkAccessManager.connectToHostEncrypted(url.host(), url.port(443), sslConfiguration);
+        } else {
+            // A mock server
+            networkAccessManager.connectToHost(url.host(), url.port(80));
+        }
+    };
+
+    preconnect(m_networkAccessManager);
+
+    // A hedge is only sent when a lookup is already late, so it shouldn't
+    // have to wait for a handshake as well
+    if (m_hedgePercentile > 0) {
+        preconnect(m_hedgeNetworkAccessManager);
+    }
+}
+
+bool Shazam::openLocalIndex(const QString& path) {
+    if (path.isEmpty()) {
+        m_localIndex.close();
+        return true;
+    }
+
+    return m_localIndex.open(path);
+}
+
+quint64 Shazam::detectFromUri(const QString& uri, const int bufferLengthInSeconds, int source) {
+    const auto requestId = m_nextRequestId++;
+
+    Signature signature;
+    Signature::decodeFromUri(uri, signature);
+    // Left empty without the cache, so nothing is stored against it either
+    const auto sketch = m_lookupCacheEnabled ? SignatureSketch::fromSignature(signature) : SignatureSketch();
+
+    if (const auto cached = m_lookupCacheEnabled ? m_lookupCache.find(sketch) : std::nullopt) {
+        qDebug() << "Answered lookup" << requestId << "from the cache," << m_lookupCache.getHits() << "hits," << m_lookupCache.getMisses() << "misses";
+        completeLater(requestId, *cached);
+        return requestId;
+    }
+
+    if (m_localIndex.isOpen()) {
+        const auto local = m_localIndex.match(signature);
+        if (local.getFound()) {
+            qDebug() << "Answered lookup" << requestId << "from the local index";
+            m_lookupCache.insert(sketch, local);
+            completeLater(requestId, local);
+            return requestId;
+        }
+    }
+
+    m_pendingSketches.insert(requestId, sketch);
+
+    if (m_scheduler.enqueue(requestId, uri, bufferLengthInSeconds, source)) {
+        sendQueued();
+    } else {
+        qDebug() << "Lookup" << requestId << "shares the result of one already on its way";
+    }
+
+    return requestId;
+}
+
+void Shazam::setMaxInFlight(int maxInFlight) {
+    m_scheduler.setMaxInFlight(maxInFlight);
+    sendQueued();
+}
+
+void Shazam::setFairness(LookupFairness fairness) {
+    m_scheduler.setFairness(fairness);
+}
+
+void Shazam::setLookupCache(bool enabled) {
+    m_lookupCacheEnabled = enabled;
+    if (!enabled) {
+        m_lookupCache.clear();
+    }
+}
+
+void Shazam::setHedgePercentile(int percentile) {
+    m_hedgePercentile = std::clamp(percentile, 0, 99);
+}
+
+void Shazam::setMeasureHedging(bool enabled) {
+    m_measureHedging = enabled;
+}
+
+void Shazam::setOrderedResults(bool enabled) {
+    m_orderedResults = enabled;
+    m_nextResultId = m_nextRequestId;
+}
+
+void Shazam::cancelPending() {
+    // Forget the requests first, abort() emits finished() straight away
+    const auto responses = m_pendingRequests.keys();
+    for (const auto& lookup : std::as_const(m_pendingRequests)) {
+        traceAsyncEnd(lookupTraceName(lookup.hedge), lookup.requestId);
+    }
+
+    m_pendingRequests.clear();
+    m_pendingSketches.clear();
+    m_scheduler.clear();
+    m_backoffTimer.stop();
+
+    // Nothing earlier is left to wait for
+    m_heldResults.clear();
+    m_nextResultId = m_nextRequestId;
+
+    for (auto* response : responses) {
+        response->abort();
+    }
+}
+
+void Shazam::cancel(quint64 requestId) {
+    // Others are waiting on the same lookup
+    if (!m_scheduler.cancel(requestId)) {
+        return;
+    }
+
+    m_pendingSketches.remove(requestId);
+
+    // The request and its hedge, if it has one. Forget them first, abort()
+    // emits finished() straight away.
+    QList<QNetworkReply*> responses;
+    for (auto it = m_pendingRequests.begin(); it != m_pendingRequests.end();) {
+        if (it->requestId == requestId) {
+            traceAsyncEnd(lookupTraceName(it->hedge), requestId);
+            responses.append(it.key());
+            it = m_pendingRequests.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    for (auto* response : responses) {
+        response->abort();
+    }
+
+    sendQueued();
 }
 
 void Shazam::onShazamResponse() {
+    TraceSpan span("onShazamResponse", "network");
+
     // Use sender() to get the QNetworkReply that emitted the signal
     auto* response = qobject_cast<QNetworkReply*>(sender());
 
     if (response) {
+        if (!m_pendingRequests.contains(response)) {
+            // Cancelled
+            response->deleteLater();
+            return;
+        }
+
+        const auto lookup = m_pendingRequests.take(response);
+        const auto requestId = lookup.requestId;
+
+        recordLatency(LatencyStage::HttpRoundTrip, lookup.timer);
+        traceAsyncEnd(lookupTraceName(lookup.hedge), requestId);
+
+        // Beaten by its hedge and only kept going to see by how much
+        if (lookup.beatenAfterMs >= 0) {
+            if (response->error() == QNetworkReply::NoError) {
+                recordLatency(LatencyStage::HedgeSaving, (lookup.timer.elapsed() - lookup.beatenAfterMs) * 1000000);
+            }
+
+            response->deleteLater();
+            return;
+        }
+
+        qDebug() << "Shazam lookup" << requestId << (lookup.hedge ? "(hedge)" : "") << "took" << lookup.timer.elapsed() << "ms"
+                 << (response->attribute(QNetworkRequest::Http2WasUsedAttribute).toBool() ? "over HTTP/2" : "over HTTP/1.1");
+
+        const int status = response->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        const bool failed = response->error() != QNetworkReply::NoError || status == 429 || status >= 500;
+
+        // Whichever of a hedged pair answers first is used, the other is
+        // aborted, unless this one failed and the other may yet answer
+        if (auto* other = findOther(response, requestId)) {
+            if (failed) {
+                // The other request still counts, but the server wants a rest
+                if (status == 429 || status >= 500) {
+                    m_scheduler.backOff(response->rawHeader("Retry-After").toLongLong() * 1000);
+                    sendQueued();
+                }
+
+                qDebug() << "Lookup" << requestId << "failed, waiting for the other request";
+                response->deleteLater();
+                return;
+            }
+
+            if (lookup.hedge) {
+                m_hedgeWins++;
+                recordLatency(LatencyStage::HedgedLookup, m_pendingRequests[other].timer);
+            }
+
+            if (lookup.hedge && m_measureHedging) {
+                // Left to finish, the difference is what hedging saved
+                m_pendingRequests[other].beatenAfterMs = m_pendingRequests[other].timer.elapsed();
+            } else {
+                const auto otherLookup = m_pendingRequests.take(other);
+                traceAsyncEnd(lookupTraceName(otherLookup.hedge), requestId);
+
+                // A stalled request that is given up on still took at least
+                // this long. Leaving it out would keep only the fast round
+                // trips, and the hedge deadline would keep coming down.
+                if (!otherLookup.hedge) {
+                    recordLatency(LatencyStage::HttpRoundTrip, otherLookup.timer);
+                }
+
+                // Already forgotten, abort() emits finished() straight away
+                other->abort();
+            }
+        }
+
+        // Throttled, or Shazam is having trouble, so try again later
+        if (status == 429 || status >= 500) {
+            const qint64 retryAfterMs = response->rawHeader("Retry-After").toLongLong() * 1000;
+
+            if (m_scheduler.throttled(requestId, retryAfterMs)) {
+                qWarning() << "Shazam returned" << status << "so retrying lookup" << requestId << "in"
+                           << m_scheduler.getBackoffRemaining() << "ms";
+                response->deleteLater();
+                sendQueued();
+                return;
+            }
+        }
+
         QRestReply restResponse(response);
         if (!restResponse.isSuccess()) {
             qWarning() << "Error returned by Shazam";
             QMetaObject::invokeMethod(
                 this,
                 "onShazamError",
-                Qt::QueuedConnection);
+                Qt::QueuedConnection,
+                Q_ARG(quint64, requestId));
         } else {
-            const auto jsonResponse = restResponse.readJson();
+            // Parsed once it gets to the slot, straight from the bytes
+            traceFlowBegin("parseShazamResponse", requestId);
             QMetaObject::invokeMethod(
                 this,
                 "parseShazamResponse",
                 Qt::QueuedConnection,
-                Q_ARG(const QJsonDocument, jsonResponse.value()));
+                Q_ARG(quint64, requestId),
+                Q_ARG(QByteArray, restResponse.readBody()));
         }
         response->deleteLater();
     }
 }
 
-void Shazam::parseShazamResponse(const QJsonDocument& shazamJsonDocument) {
-    detectionComplete(ShazamResponse::fromJsonDocument(shazamJsonDocument));
+quint64 Shazam::getCacheHits() const {
+    return m_lookupCache.getHits();
+}
+
+quint64 Shazam::getCacheMisses() const {
+    return m_lookupCache.getMisses();
+}
+
+quint64 Shazam::getHedged() const {
+    return m_hedged;
+}
+
+quint64 Shazam::getHedgeWins() const {
+    return m_hedgeWins;
+}
+
+void Shazam::parseShazamResponse(quint64 requestId, const QByteArray& shazamJson) {
+    TraceSpan span("parseShazamResponse", "network");
+    traceFlowEnd("parseShazamResponse", requestId);
+
+    QElapsedTimer parseTimer;
+    parseTimer.start();
+    ShazamResponseFields fields;
+    const bool parsed = ::parseShazamResponse(shazamJson, fields);
+    recordLatency(LatencyStage::JsonParse, parseTimer);
+
+    QElapsedTimer decodeTimer;
+    decodeTimer.start();
+    ShazamResponse response;
+    if (parsed) {
+        response = ShazamResponse::fromFields(fields);
+    } else {
+        qWarning() << "Shazam returned malformed JSON for lookup" << requestId;
+    }
+    recordLatency(LatencyStage::ResponseDecode, decodeTimer);
+
+    const auto requestIds = m_scheduler.finish(requestId, true);
+    const auto sketch = m_pendingSketches.take(requestId);
+
+    // Only matches are cached, a miss is worth retrying with more audio
+    if (response.getFound()) {
+        m_lookupCache.insert(sketch, response);
+    }
+
+    for (const auto id : requestIds) {
+        m_pendingSketches.remove(id);
+        complete(id, response);
+    }
+
+    sendQueued();
 }
 
-void Shazam::onShazamError() {
+void Shazam::onShazamError(quint64 requestId) {
+    const auto requestIds = m_scheduler.finish(requestId, false);
+
     ShazamResponse shazamResponse;
-    detectionComplete(shazamResponse);
+    for (const auto id : requestIds) {
+        m_pendingSketches.remove(id);
+        complete(id, shazamResponse);
+    }
+
+    sendQueued();
+}
+
+void Shazam::sendQueued() {
+    while (const auto lookup = m_scheduler.next()) {
+        send(*lookup);
+    }
+
+    // Come back once the backoff is over
+    const auto backoff = m_scheduler.getBackoffRemaining();
+    if (backoff > 0 && m_scheduler.getQueued() > 0) {
+        m_backoffTimer.start(static_cast<int>(backoff));
+    }
+}
+
+/*******************************************************
+ * Private methods
+ *******************************************************/
+
+void Shazam::send(const LookupScheduler::Lookup& lookup) {
+    traceAsyncBegin(lookupTraceName(false), lookup.requestId);
+    auto* response = post(m_restAccessManager, lookup.uri, lookup.lengthInSeconds);
+
+    PendingLookup pending;
+    pending.requestId = lookup.requestId;
+    pending.uri = lookup.uri;
+    pending.lengthInSeconds = lookup.lengthInSeconds;
+    pending.timer.start();
+    m_pendingRequests.insert(response, pending);
+
+    if (m_hedgePercentile > 0) {
+        // Goes away with the response, and does nothing once it has answered
+        QTimer::singleShot(hedgeDeadline(), response, [this, response] { hedge(response); });
+    }
+}
+
+void Shazam::hedge(QNetworkReply* response) {
+    const auto pending = m_pendingRequests.constFind(response);
+    if (pending == m_pendingRequests.constEnd()) {
+        return;
+    }
+
+    // Nothing more goes out while Shazam is throttling
+    if (m_scheduler.getBackoffRemaining() > 0) {
+        qDebug() << "Not hedging lookup" << pending->requestId << "while backing off";
+        return;
+    }
+
+    qDebug() << "Lookup" << pending->requestId << "hasn't been answered after" << pending->timer.elapsed() << "ms, hedging it";
+
+    PendingLookup duplicate = *pending;
+    duplicate.hedge = true;
+    duplicate.timer.start();
+
+    traceAsyncBegin(lookupTraceName(true), duplicate.requestId);
+    m_pendingRequests.insert(post(m_hedgeRestAccessManager, duplicate.uri, duplicate.lengthInSeconds), duplicate);
+    m_hedged++;
+}
+
+QNetworkReply* Shazam::post(QRestAccessManager& restAccessManager, const QString& uri, int lengthInSeconds) {
+    ShazamBody shazamBody(uri, lengthInSeconds);
+    shazamBody.writeJson(m_requestBody);
+
+    const QString url =
+        m_url +
+        QUuid::createUuid().toString(QUuid::WithoutBraces) +
+        "/" +
+        QUuid::createUuid().toString(QUuid::WithoutBraces) +
+        SHAZAM_QUERY_PARAMS;
+
+    auto request = QNetworkRequest(QUrl(url));
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    request.setHeader(QNetworkRequest::UserAgentHeader, "Dalvik/2.1.0 (Linux; U; Android 6.0.1; SM-G920F Build/MMB29K)");
+    request.setRawHeader("Accept", "*/*");
+    request.setRawHeader("Content-Language", "en_US");
+
+    // Keep-alive is the default for HTTP/1.1, and a Connection header
+    // isn't allowed at all over HTTP/2
+    request.setAttribute(QNetworkRequest::Http2AllowedAttribute, true);
+    request.setTransferTimeout(SHAZAM_TRANSFER_TIMEOUT_MS);
+
+    auto* response = restAccessManager.post(request, m_requestBody);
+    QObject::connect(response, &QNetworkReply::finished, this, &Shazam::onShazamResponse);
+    return response;
+}
+
+QNetworkReply* Shazam::findOther(QNetworkReply* response, quint64 requestId) const {
+    for (auto it = m_pendingRequests.constBegin(); it != m_pendingRequests.constEnd(); ++it) {
+        if (it->requestId == requestId && it.key() != response && it->beatenAfterMs < 0) {
+            return it.key();
+        }
+    }
+
+    return nullptr;
+}
+
+int Shazam::hedgeDeadline() const {
+    if (latencyCount(LatencyStage::HttpRoundTrip) < SHAZAM_HEDGE_MIN_SAMPLES) {
+        return SHAZAM_HEDGE_DEFAULT_DEADLINE_MS;
+    }
+
+    const double deadline = latencyPercentile(LatencyStage::HttpRoundTrip, m_hedgePercentile / 100.0);
+    return std::clamp(static_cast<int>(deadline), SHAZAM_HEDGE_MIN_DEADLINE_MS, SHAZAM_HEDGE_MAX_DEADLINE_MS);
+}
+
+void Shazam::complete(quint64 requestId, const ShazamResponse& response) {
+    if (!m_orderedResults) {
+        detectionComplete(requestId, response);
+        return;
+    }
+
+    m_heldResults.insert(requestId, response);
+
+    while (!m_heldResults.isEmpty() && m_heldResults.firstKey() == m_nextResultId) {
+        detectionComplete(m_nextResultId++, m_heldResults.take(m_heldResults.firstKey()));
+    }
+}
+
+void Shazam::completeLater(quint64 requestId, const ShazamResponse& response) {
+    // Callers expect the result after detectFromUri() has returned
+    QMetaObject::invokeMethod(this, [this, requestId, response] {
+        complete(requestId, response);
+    }, Qt::QueuedConnection);
 }
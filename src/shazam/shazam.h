@@ -1,27 +1,219 @@
 #pragma once
 
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMap>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
 #include <QObject>
+#include <QRestAccessManager>
+#include <QTimer>
 #include <qstringview.h>
 #include <qtmetamacros.h>
 
+#include "fingerprint/signature_sketch.h"
+#include "index/local_index.h"
+#include "lookup_cache.h"
+#include "lookup_scheduler.h"
 #include "shazam_response.h"
 
 #define SHAZAM_URL QStringLiteral("https://amp.shazam.com/discovery/v5/en/US/android/-/tag/")
+
+// Lookups go to this URL instead of SHAZAM_URL when it is set, e.g. to a
+// local mock server
+#define SHAZAM_URL_ENVIRONMENT_VARIABLE "SONGDETECTOR_SHAZAM_URL"
 #define SHAZAM_QUERY_PARAMS QStringLiteral("?sync=true&webv3=true&sampling=true&connected=&shazamapiversion=v3&sharehub=true&video=v3")
 
+// A lookup that takes longer than this is abandoned and reported as not found
+#define SHAZAM_TRANSFER_TIMEOUT_MS 10000
+
+// A lookup that hasn't been answered by this percentile of recent round
+// trips is sent again on a second connection, see setHedgePercentile().
+// Until there are enough round trips to go by the default deadline is
+// used, and the deadline is always kept within the limits.
+#define SHAZAM_DEFAULT_HEDGE_PERCENTILE 95
+#define SHAZAM_HEDGE_MIN_SAMPLES 20
+#define SHAZAM_HEDGE_DEFAULT_DEADLINE_MS 3000
+#define SHAZAM_HEDGE_MIN_DEADLINE_MS 250
+#define SHAZAM_HEDGE_MAX_DEADLINE_MS (SHAZAM_TRANSFER_TIMEOUT_MS / 2)
+
+/*
+ * Shazam client. Lookups go out through a LookupScheduler, which caps how
+ * many are in flight, merges lookups of the same signature and backs off
+ * when Shazam throttles, so callers can queue as many as they like.
+ *
+ * A lookup that stalls is hedged: once it has taken longer than most do,
+ * the same lookup is sent again on a connection of its own, the first of
+ * the two to answer is used and the other is aborted. Hedges don't count
+ * towards the lookups in flight, there is at most one per lookup.
+ */
 class Shazam : public QObject {
     Q_OBJECT
 
     public:
         Shazam(QObject* parent);
 
-        void    detectFromUri(const QString& uri, const int bufferLengthInSeconds);
+        /*
+         * Opens (or refreshes) the TLS connection to Shazam ahead of the
+         * first lookup, so the lookup itself only costs one round trip.
+         * Cheap to call when the connection is already up.
+         */
+        void    warmUp();
+
+        /*
+         * Opens a local fingerprint index, which is then consulted before
+         * every remote lookup. An empty path closes it again.
+         */
+        bool    openLocalIndex(const QString& path);
+
+        /*
+         * Starts a lookup and returns its request id, which is passed
+         * back with detectionComplete(). If a recent lookup had a similar
+         * enough signature, or the local index knows the track, that
+         * result is passed back instead, without going to Shazam.
+         *
+         * `source` is the capture source the signature came from, which
+         * the lookups are shared out between, see setFairness().
+         */
+        quint64 detectFromUri(const QString& uri, const int bufferLengthInSeconds, int source = 0);
+
+        /*
+         * Lookups sent to Shazam at once, the rest wait their turn
+         */
+        void    setMaxInFlight(int maxInFlight);
+
+        /*
+         * Whether waiting lookups are sent in order or capture sources
+         * take turns
+         */
+        void    setFairness(LookupFairness fairness);
+
+        /*
+         * Whether lookups can be answered from recent similar ones, on by
+         * default. Off where every window has to be looked up on its own,
+         * as the cache would answer a window that straddles two tracks
+         * with the earlier one.
+         */
+        void    setLookupCache(bool enabled);
+
+        /*
+         * Percentile (1-99) of recent round trips after which a lookup is
+         * hedged, 0 never hedges
+         */
+        void    setHedgePercentile(int percentile);
+
+        /*
+         * Lets a request that its hedge beat run to the end, rather than
+         * aborting it, to record how much sooner the hedge answered as
+         * LatencyStage::HedgeSaving. Every hedge that wins then holds a
+         * request open for longer, so this is for benchmarking against a
+         * mock server.
+         */
+        void    setMeasureHedging(bool enabled);
+
+        /*
+         * Raises detectionComplete() in request id order, rather than in
+         * the order the lookups finish
+         */
+        void    setOrderedResults(bool enabled);
+
+        /*
+         * Aborts every lookup that is still in flight. No detectionComplete()
+         * is raised for cancelled lookups.
+         */
+        void    cancelPending();
+
+        /*
+         * Abandons one lookup, no detectionComplete() is raised for it
+         * unless it was already answered. Not for ordered results.
+         */
+        void    cancel(quint64 requestId);
+
+        /*
+         * Lookups answered from (and not found in) the recent lookup cache
+         */
+        quint64 getCacheHits() const;
+        quint64 getCacheMisses() const;
+
+        /*
+         * Lookups hedged, and how many of those the hedge answered first.
+         * How long each of those took, from the first request to the
+         * hedge's response, is kept as LatencyStage::HedgedLookup.
+         */
+        quint64 getHedged() const;
+        quint64 getHedgeWins() const;
 
     protected slots:
-        void    parseShazamResponse(const QJsonDocument& shazamJsonDocument);
-        void    onShazamError();
+        void    parseShazamResponse(quint64 requestId, const QByteArray& shazamJson);
+        void    onShazamError(quint64 requestId);
         void    onShazamResponse();
 
     signals:
-        void    detectionComplete(const ShazamResponse& response);
+        void    detectionComplete(quint64 requestId, const ShazamResponse& response);
+
+    private slots:
+        void    sendQueued();
+
+    private:
+        void    send(const LookupScheduler::Lookup& lookup);
+        void    hedge(QNetworkReply* response);
+        QNetworkReply*  post(QRestAccessManager& restAccessManager, const QString& uri, int lengthInSeconds);
+        QNetworkReply*  findOther(QNetworkReply* response, quint64 requestId) const;
+        int     hedgeDeadline() const;
+        void    complete(quint64 requestId, const ShazamResponse& response);
+        void    completeLater(quint64 requestId, const ShazamResponse& response);
+
+        struct PendingLookup {
+            quint64         requestId = 0;
+            QElapsedTimer   timer;
+
+            // What to send again when hedging, and whether this is the hedge
+            QString         uri;
+            int             lengthInSeconds = 0;
+            bool            hedge = false;
+
+            // When its hedge answered, for a request beaten by its hedge
+            // and left to finish (see setMeasureHedging())
+            qint64          beatenAfterMs = -1;
+        };
+
+        // One client for the lifetime of the app, so that connections
+        // (and HTTP/2 sessions) are kept alive and reused between lookups
+        QNetworkAccessManager           m_networkAccessManager;
+        QRestAccessManager              m_restAccessManager;
+
+        // Hedges go through a client of their own, so they don't queue
+        // behind (or share an HTTP/2 session with) the request that stalled
+        QNetworkAccessManager           m_hedgeNetworkAccessManager;
+        QRestAccessManager              m_hedgeRestAccessManager;
+        QString                         m_url;
+        int                             m_hedgePercentile = SHAZAM_DEFAULT_HEDGE_PERCENTILE;
+        quint64                         m_hedged = 0;
+        quint64                         m_hedgeWins = 0;
+        bool                            m_measureHedging = false;
+
+        quint64                         m_nextRequestId = 1;
+        QHash<QNetworkReply*, PendingLookup> m_pendingRequests;
+
+        // Decides when queued lookups are sent, the timer fires once a
+        // backoff is over
+        LookupScheduler                 m_scheduler;
+        QTimer                          m_backoffTimer;
+
+        // Results held back until every earlier request has completed
+        bool                            m_orderedResults = false;
+        quint64                         m_nextResultId = 1;
+        QMap<quint64, ShazamResponse>   m_heldResults;
+
+        // Sketches of the signatures still being looked up, so that the
+        // results can be cached against them
+        QHash<quint64, SignatureSketch> m_pendingSketches;
+        LookupCache                     m_lookupCache;
+        bool                            m_lookupCacheEnabled = true;
+
+        LocalIndex                      m_localIndex;
+
+        // Request bodies are written into this, which keeps its allocation
+        // from one lookup to the next once the network stack is done with it
+        QByteArray                      m_requestBody;
 };
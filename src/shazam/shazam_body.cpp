@@ -27,6 +27,14 @@ QJsonObject ShazamGelocation::toJsonObject() const {
     return obj;
 }
 
+void ShazamGelocation::writeJson(ShazamJsonWriter& writer) const {
+    writer.beginObject("geolocation");
+    writer.writeNumber("altitude", static_cast<double>(altitude));
+    writer.writeNumber("latitude", static_cast<double>(latitude));
+    writer.writeNumber("longitude", static_cast<double>(longitude));
+    writer.endObject();
+}
+
 ShazamSignature::ShazamSignature(const QString& uri, int sample_ms, int timestamp) :
     uri(uri),
     samplems(sample_ms),
@@ -41,6 +49,14 @@ QJsonObject ShazamSignature::toJsonObject() const {
     return obj;
 }
 
+void ShazamSignature::writeJson(ShazamJsonWriter& writer) const {
+    writer.beginObject("signature");
+    writer.writeNumber("samplems", static_cast<qint64>(samplems));
+    writer.writeNumber("timestamp", static_cast<qint64>(timestamp));
+    writer.writeString("uri", uri);
+    writer.endObject();
+}
+
 ShazamBody::ShazamBody(const QString& uri, int sample_ms) :
     timestamp(QDateTime::currentSecsSinceEpoch()),
     geolocation(),
@@ -60,3 +76,14 @@ QJsonDocument ShazamBody::toJsonDocument() const {
 
     return QJsonDocument(obj);
 }
+
+void ShazamBody::writeJson(QByteArray& destination) const {
+    // In the same (sorted) order as QJsonDocument
+    ShazamJsonWriter writer(destination);
+    writer.beginObject();
+    geolocation.writeJson(writer);
+    signature.writeJson(writer);
+    writer.writeNumber("timestamp", static_cast<qint64>(timestamp));
+    writer.writeString("timezone", timezone);
+    writer.endObject();
+}
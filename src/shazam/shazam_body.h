@@ -4,6 +4,8 @@
 #include <QJsonObject>
 #include <QString>
 
+#include "shazam_codec.h"
+
 class ShazamGelocation {
     public:
         ShazamGelocation();
@@ -11,6 +13,9 @@ class ShazamGelocation {
         // Convert to JSON object
         QJsonObject toJsonObject() const;
 
+        // Write as the "geolocation" member of the object being written
+        void        writeJson(ShazamJsonWriter& writer) const;
+
     private:
         float altitude;
         float latitude;
@@ -24,6 +29,9 @@ class ShazamSignature {
         // Convert to JSON object
         QJsonObject toJsonObject() const;
 
+        // Write as the "signature" member of the object being written
+        void        writeJson(ShazamJsonWriter& writer) const;
+
     private:
         const int         samplems;
         const int         timestamp;
@@ -37,6 +45,10 @@ class ShazamBody {
         // Convert to JSON document for REST
         QJsonDocument       toJsonDocument() const;
 
+        // Write the same JSON (compact) straight into `destination`,
+        // reusing its allocation
+        void                writeJson(QByteArray& destination) const;
+
     private:
         const int                 timestamp;
         const ShazamGelocation    geolocation;
@@ -0,0 +1,546 @@
+#include <charconv>
+#include <cmath>
+
+#include "shazam_codec.h"
+
+/*******************************************************
+ * Writer
+ *******************************************************/
+
+ShazamJsonWriter::ShazamJsonWriter(QByteArray& destination) :
+    m_destination(destination) {
+        // Keeps the capacity
+        m_destination.resize(0);
+}
+
+void ShazamJsonWriter::beginObject(const char* key) {
+    if (key != nullptr) {
+        writeKey(key);
+    }
+
+    m_destination.append('{');
+    m_first = true;
+}
+
+void ShazamJsonWriter::endObject() {
+    m_destination.append('}');
+    m_first = false;
+}
+
+void ShazamJsonWriter::writeString(const char* key, QStringView value) {
+    writeKey(key);
+
+    // Room for the common case, nothing that needs escaping
+    m_destination.reserve(m_destination.size() + value.size() + 2);
+    m_destination.append('"');
+
+    for (qsizetype i = 0; i < value.size(); i++) {
+        char32_t c = value[i].unicode();
+
+        if (c < 0x80) {
+            switch (c) {
+                case '"':  m_destination.append("\\\""); break;
+                case '\\': m_destination.append("\\\\"); break;
+                case '\b': m_destination.append("\\b"); break;
+                case '\f': m_destination.append("\\f"); break;
+                case '\n': m_destination.append("\\n"); break;
+                case '\r': m_destination.append("\\r"); break;
+                case '\t': m_destination.append("\\t"); break;
+                default:
+                    if (c < 0x20) {
+                        static const char hex[] = "0123456789abcdef";
+                        const char escape[] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf] };
+                        m_destination.append(escape, sizeof(escape));
+                    } else {
+                        m_destination.append(static_cast<char>(c));
+                    }
+            }
+            continue;
+        }
+
+        // Everything else goes out as UTF-8
+        if (QChar::isHighSurrogate(c) && i + 1 < value.size() && value[i + 1].isLowSurrogate()) {
+            c = QChar::surrogateToUcs4(static_cast<char16_t>(c), value[++i].unicode());
+        } else if (QChar::isSurrogate(c)) {
+            c = QChar::ReplacementCharacter;
+        }
+
+        if (c < 0x800) {
+            m_destination.append(static_cast<char>(0xc0 | (c >> 6)));
+        } else if (c < 0x10000) {
+            m_destination.append(static_cast<char>(0xe0 | (c >> 12)));
+            m_destination.append(static_cast<char>(0x80 | ((c >> 6) & 0x3f)));
+        } else {
+            m_destination.append(static_cast<char>(0xf0 | (c >> 18)));
+            m_destination.append(static_cast<char>(0x80 | ((c >> 12) & 0x3f)));
+            m_destination.append(static_cast<char>(0x80 | ((c >> 6) & 0x3f)));
+        }
+        m_destination.append(static_cast<char>(0x80 | (c & 0x3f)));
+    }
+
+    m_destination.append('"');
+    m_first = false;
+}
+
+void ShazamJsonWriter::writeNumber(const char* key, qint64 value) {
+    writeKey(key);
+
+    char buffer[24];
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    m_destination.append(buffer, result.ptr - buffer);
+    m_first = false;
+}
+
+void ShazamJsonWriter::writeNumber(const char* key, double value) {
+    writeKey(key);
+
+    // JSON has no infinities or NaNs, QJsonDocument writes them as null too
+    if (!std::isfinite(value)) {
+        m_destination.append("null");
+        m_first = false;
+        return;
+    }
+
+    // The shortest text that reads back as the same double
+    char buffer[32];
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    m_destination.append(buffer, result.ptr - buffer);
+    m_first = false;
+}
+
+void ShazamJsonWriter::writeKey(const char* key) {
+    if (!m_first) {
+        m_destination.append(',');
+    }
+
+    m_destination.append('"');
+    m_destination.append(key);
+    m_destination.append("\":");
+}
+
+/*******************************************************
+ * Parser
+ *******************************************************/
+
+namespace {
+
+/*
+ * Reads JSON a token at a time, straight out of the response
+ */
+class JsonCursor {
+    public:
+        JsonCursor(QByteArrayView json) :
+            m_position(json.data()),
+            m_end(json.data() + json.size()) {
+        }
+
+        /*
+         * The next character after any whitespace, 0 at the end
+         */
+        char peek() {
+            while (m_position < m_end &&
+                   (*m_position == ' ' || *m_position == '\n' || *m_position == '\r' || *m_position == '\t')) {
+                m_position++;
+            }
+
+            return m_position < m_end ? *m_position : 0;
+        }
+
+        bool consume(char c) {
+            if (peek() != c) {
+                return false;
+            }
+
+            m_position++;
+            return true;
+        }
+
+        /*
+         * A string's raw contents, escapes and all
+         */
+        bool readString(QByteArrayView& value) {
+            if (!consume('"')) {
+                return false;
+            }
+
+            const char* start = m_position;
+            while (m_position < m_end) {
+                const char c = *m_position;
+
+                if (c == '"') {
+                    value = QByteArrayView(start, m_position - start);
+                    m_position++;
+                    return true;
+                }
+
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    return false;
+                }
+
+                // Whatever is escaped, it isn't the end of the string
+                m_position += c == '\\' ? 2 : 1;
+            }
+
+            return false;
+        }
+
+        bool readNumber(double& value) {
+            const char c = peek();
+            if (c != '-' && (c < '0' || c > '9')) {
+                return false;
+            }
+
+            const auto result = std::from_chars(m_position, m_end, value);
+            if (result.ec != std::errc()) {
+                return false;
+            }
+
+            m_position = result.ptr;
+            return true;
+        }
+
+        bool skipLiteral(const char* literal) {
+            peek();
+
+            for (; *literal != 0; literal++, m_position++) {
+                if (m_position == m_end || *m_position != *literal) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        bool skipNumber() {
+            double ignored;
+            return readNumber(ignored);
+        }
+
+        bool skipValue(int depth);
+
+    private:
+        const char*     m_position;
+        const char*     m_end;
+};
+
+/*
+ * Calls `member(key, depth)` for each member of the object at the cursor,
+ * which has to read or skip its value
+ */
+template <typename Member>
+bool forEachMember(JsonCursor& cursor, int depth, Member member) {
+    if (depth > SHAZAM_CODEC_MAX_DEPTH || !cursor.consume('{')) {
+        return false;
+    }
+
+    if (cursor.consume('}')) {
+        return true;
+    }
+
+    do {
+        QByteArrayView key;
+        if (!cursor.readString(key) || !cursor.consume(':') || !member(key, depth + 1)) {
+            return false;
+        }
+    } while (cursor.consume(','));
+
+    return cursor.consume('}');
+}
+
+/*
+ * Calls `element(index, depth)` for each element of the array at the
+ * cursor, which has to read or skip it
+ */
+template <typename Element>
+bool forEachElement(JsonCursor& cursor, int depth, Element element) {
+    if (depth > SHAZAM_CODEC_MAX_DEPTH || !cursor.consume('[')) {
+        return false;
+    }
+
+    if (cursor.consume(']')) {
+        return true;
+    }
+
+    int index = 0;
+    do {
+        if (!element(index++, depth + 1)) {
+            return false;
+        }
+    } while (cursor.consume(','));
+
+    return cursor.consume(']');
+}
+
+bool JsonCursor::skipValue(int depth) {
+    switch (peek()) {
+        case '{':
+            return forEachMember(*this, depth, [this](QByteArrayView, int memberDepth) {
+                return skipValue(memberDepth);
+            });
+        case '[':
+            return forEachElement(*this, depth, [this](int, int elementDepth) {
+                return skipValue(elementDepth);
+            });
+        case '"': {
+            QByteArrayView ignored;
+            return readString(ignored);
+        }
+        case 't':
+            return skipLiteral("true");
+        case 'f':
+            return skipLiteral("false");
+        case 'n':
+            return skipLiteral("null");
+        default:
+            return skipNumber();
+    }
+}
+
+/*
+ * Reads a string member, or skips it if it is something else
+ */
+bool readStringOrSkip(JsonCursor& cursor, int depth, QByteArrayView& value) {
+    return cursor.peek() == '"' ? cursor.readString(value) : cursor.skipValue(depth);
+}
+
+bool parseMatches(JsonCursor& cursor, int depth, ShazamResponseFields& fields) {
+    if (cursor.peek() != '[') {
+        return cursor.skipValue(depth);
+    }
+
+    return forEachElement(cursor, depth, [&](int index, int elementDepth) {
+        if (index > 0 || cursor.peek() != '{') {
+            return cursor.skipValue(elementDepth);
+        }
+
+        return forEachMember(cursor, elementDepth, [&](QByteArrayView key, int memberDepth) {
+            const char c = cursor.peek();
+            if (key == "offset" && (c == '-' || (c >= '0' && c <= '9'))) {
+                return cursor.readNumber(fields.offset);
+            }
+
+            return cursor.skipValue(memberDepth);
+        });
+    });
+}
+
+bool parseMetadata(JsonCursor& cursor, int depth, QByteArrayView& album, QByteArrayView& releaseDate) {
+    return forEachElement(cursor, depth, [&](int, int elementDepth) {
+        if (cursor.peek() != '{') {
+            return cursor.skipValue(elementDepth);
+        }
+
+        QByteArrayView title;
+        QByteArrayView text;
+        const bool valid = forEachMember(cursor, elementDepth, [&](QByteArrayView key, int memberDepth) {
+            if (key == "title") {
+                return readStringOrSkip(cursor, memberDepth, title);
+            }
+
+            if (key == "text") {
+                return readStringOrSkip(cursor, memberDepth, text);
+            }
+
+            return cursor.skipValue(memberDepth);
+        });
+
+        if (!text.isNull()) {
+            if (title == "Album") {
+                album = text;
+            } else if (title == "Released") {
+                releaseDate = text;
+            }
+        }
+
+        return valid;
+    });
+}
+
+bool parseSections(JsonCursor& cursor, int depth, ShazamResponseFields& fields) {
+    if (cursor.peek() != '[') {
+        return cursor.skipValue(depth);
+    }
+
+    return forEachElement(cursor, depth, [&](int, int elementDepth) {
+        if (cursor.peek() != '{') {
+            return cursor.skipValue(elementDepth);
+        }
+
+        // The type could come after the metadata, so hold on to it until
+        // the end of the section
+        QByteArrayView type;
+        QByteArrayView album;
+        QByteArrayView releaseDate;
+
+        const bool valid = forEachMember(cursor, elementDepth, [&](QByteArrayView key, int memberDepth) {
+            if (key == "type") {
+                return readStringOrSkip(cursor, memberDepth, type);
+            }
+
+            if (key == "metadata" && cursor.peek() == '[') {
+                return parseMetadata(cursor, memberDepth, album, releaseDate);
+            }
+
+            return cursor.skipValue(memberDepth);
+        });
+
+        if (type == "SONG") {
+            if (!album.isNull()) {
+                fields.album = album;
+            }
+
+            if (!releaseDate.isNull()) {
+                fields.releaseDate = releaseDate;
+            }
+        }
+
+        return valid;
+    });
+}
+
+bool parseTrack(JsonCursor& cursor, int depth, ShazamResponseFields& fields) {
+    if (cursor.peek() != '{') {
+        return cursor.skipValue(depth);
+    }
+
+    fields.hasTrack = true;
+
+    return forEachMember(cursor, depth, [&](QByteArrayView key, int memberDepth) {
+        if (key == "key") {
+            return readStringOrSkip(cursor, memberDepth, fields.key);
+        }
+
+        if (key == "title") {
+            fields.hasTitle = true;
+            return readStringOrSkip(cursor, memberDepth, fields.title);
+        }
+
+        if (key == "subtitle") {
+            fields.hasSubtitle = true;
+            return readStringOrSkip(cursor, memberDepth, fields.subtitle);
+        }
+
+        if (key == "sections") {
+            return parseSections(cursor, memberDepth, fields);
+        }
+
+        return cursor.skipValue(memberDepth);
+    });
+}
+
+}
+
+bool parseShazamResponse(QByteArrayView json, ShazamResponseFields& fields) {
+    fields = ShazamResponseFields();
+    JsonCursor cursor(json);
+
+    const bool valid = forEachMember(cursor, 0, [&](QByteArrayView key, int depth) {
+        if (key == "matches") {
+            return parseMatches(cursor, depth, fields);
+        }
+
+        if (key == "track") {
+            return parseTrack(cursor, depth, fields);
+        }
+
+        return cursor.skipValue(depth);
+    });
+
+    // Nothing but whitespace after the response
+    return valid && cursor.peek() == 0;
+}
+
+/*******************************************************
+ * Decoding
+ *******************************************************/
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+
+    return -1;
+}
+
+static bool readHex4(QByteArrayView raw, qsizetype position, char16_t& value) {
+    if (position + 4 > raw.size()) {
+        return false;
+    }
+
+    value = 0;
+    for (qsizetype i = position; i < position + 4; i++) {
+        const int digit = hexValue(raw[i]);
+        if (digit < 0) {
+            return false;
+        }
+
+        value = static_cast<char16_t>(value << 4 | digit);
+    }
+
+    return true;
+}
+
+QString decodeJsonString(QByteArrayView raw) {
+    // Almost always, nothing to unescape
+    if (!raw.contains('\\')) {
+        return QString::fromUtf8(raw);
+    }
+
+    QString decoded;
+    decoded.reserve(raw.size());
+
+    qsizetype runStart = 0;
+    qsizetype i = 0;
+
+    while (i < raw.size()) {
+        if (raw[i] != '\\') {
+            i++;
+            continue;
+        }
+
+        decoded.append(QString::fromUtf8(raw.sliced(runStart, i - runStart)));
+
+        const char escape = i + 1 < raw.size() ? raw[i + 1] : 0;
+        i += 2;
+
+        switch (escape) {
+            case 'b': decoded.append(u'\b'); break;
+            case 'f': decoded.append(u'\f'); break;
+            case 'n': decoded.append(u'\n'); break;
+            case 'r': decoded.append(u'\r'); break;
+            case 't': decoded.append(u'\t'); break;
+            case 'u': {
+                // UTF-16 code units, which QString is made of already
+                char16_t unit = 0;
+                if (readHex4(raw, i, unit)) {
+                    decoded.append(QChar(unit));
+                    i += 4;
+                } else {
+                    decoded.append(QChar::ReplacementCharacter);
+                }
+                break;
+            }
+            default:
+                // \" \\ and \/ stand for themselves
+                if (escape != 0) {
+                    decoded.append(QLatin1Char(escape));
+                }
+        }
+
+        runStart = i;
+    }
+
+    if (runStart < raw.size()) {
+        decoded.append(QString::fromUtf8(raw.sliced(runStart)));
+    }
+
+    return decoded;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QString>
+#include <QStringView>
+#include <QtGlobal>
+
+// Objects and arrays in a Shazam response nested deeper than this are
+// taken to be malformed, which bounds the parser's recursion
+#define SHAZAM_CODEC_MAX_DEPTH 64
+
+/*
+ * Writes JSON straight into a buffer, with no intermediate objects.
+ *
+ * Only what a Shazam request needs: objects, strings and numbers. Keys are
+ * plain ASCII literals and aren't escaped. The buffer is emptied first but
+ * keeps its capacity, so writing into the same buffer again doesn't
+ * allocate once it is big enough (and nothing else still shares it).
+ */
+class ShazamJsonWriter {
+    public:
+        ShazamJsonWriter(QByteArray& destination);
+
+        /*
+         * `key` is nullptr for the top level object
+         */
+        void    beginObject(const char* key = nullptr);
+        void    endObject();
+
+        void    writeString(const char* key, QStringView value);
+        void    writeNumber(const char* key, qint64 value);
+        void    writeNumber(const char* key, double value);
+
+    private:
+        void    writeKey(const char* key);
+
+        QByteArray&     m_destination;
+        bool            m_first = true;
+};
+
+/*
+ * The parts of a Shazam response SongDetector uses.
+ *
+ * Strings are views of the raw (still escaped) JSON string contents in the
+ * response, so they are only valid for as long as the response is, and
+ * are empty if the field wasn't there. See decodeJsonString().
+ */
+struct ShazamResponseFields {
+    // Whether there was a "track" object at all, which is Shazam's way of
+    // saying it found something
+    bool            hasTrack = false;
+
+    QByteArrayView  key;
+    QByteArrayView  title;
+    QByteArrayView  subtitle;
+    bool            hasTitle = false;
+    bool            hasSubtitle = false;
+
+    // From the metadata of the SONG section
+    QByteArrayView  album;
+    QByteArrayView  releaseDate;
+
+    // Where in the track the first match was, in seconds, -1 if unknown
+    double          offset = -1;
+};
+
+/*
+ * Pulls the fields above out of a Shazam response in a single pass,
+ * skipping over everything else (images, share links, lyrics...) without
+ * building it. Never allocates. Returns false if `json` isn't valid JSON.
+ */
+bool    parseShazamResponse(QByteArrayView json, ShazamResponseFields& fields);
+
+/*
+ * Unescapes the raw contents of a JSON string
+ */
+QString decodeJsonString(QByteArrayView raw);
@@ -30,6 +30,13 @@ ShazamResponse::ShazamResponse(QString title, QString artist) :
 ShazamResponse::~ShazamResponse() {
 }
 
+ShazamResponse ShazamResponse::fromTrack(const QString& title, const QString& artist, const QString& album, int track) {
+    auto shazamResponse = ShazamResponse(title, artist);
+    shazamResponse.m_album = album;
+    shazamResponse.m_track = track;
+    return shazamResponse;
+}
+
 /* JSON Parser */
 ShazamResponse ShazamResponse::fromJsonDocument(const QJsonDocument& json) {
     static QStringList requiredFields = {"title", "subtitle"};
@@ -52,6 +59,9 @@ ShazamResponse ShazamResponse::fromJsonDocument(const QJsonDocument& json) {
     // The Shazam JSON schema seems to use subtitle for the arist name
     // I'm not sure how reliable that is...
     auto shazamResponse = ShazamResponse(track["title"].toString(), track["subtitle"].toString());
+    shazamResponse.m_key = track["key"].toString();
+    shazamResponse.parseMatches(json["matches"]);
+
     const auto sectionsRef = track["sections"];
     if (sectionsRef.isArray()) {
         shazamResponse.parseSections(sectionsRef);
@@ -60,6 +70,37 @@ ShazamResponse ShazamResponse::fromJsonDocument(const QJsonDocument& json) {
     return shazamResponse;
 }
 
+ShazamResponse ShazamResponse::fromFields(const ShazamResponseFields& fields) {
+    if (!fields.hasTrack) {
+        qWarning() << "Shazam couldn't identify song";
+        return ShazamResponse();
+    }
+
+    if (!fields.hasTitle || !fields.hasSubtitle) {
+        qWarning() << "Missing field: " << (fields.hasTitle ? "subtitle" : "title");
+        return ShazamResponse();
+    }
+
+    auto shazamResponse = ShazamResponse(decodeJsonString(fields.title), decodeJsonString(fields.subtitle));
+    shazamResponse.m_key = decodeJsonString(fields.key);
+    shazamResponse.m_album = decodeJsonString(fields.album);
+    shazamResponse.m_releaseDate = decodeJsonString(fields.releaseDate);
+    shazamResponse.m_offset = fields.offset;
+    return shazamResponse;
+}
+
+void ShazamResponse::parseMatches(const QJsonValue& matchesRef) {
+    if (!matchesRef.isArray() || matchesRef.toArray().isEmpty()) {
+        return;
+    }
+
+    // The first match is the one the track is for
+    const auto match = matchesRef.toArray().first().toObject();
+    if (match["offset"].isDouble()) {
+        m_offset = match["offset"].toDouble();
+    }
+}
+
 void ShazamResponse::parseSections(const QJsonValue& sectionsRef) {
     const auto sections = sectionsRef.toArray();
     for (auto &sectionRef : sections) {
@@ -96,6 +137,8 @@ void ShazamResponse::parseMetadata(const QJsonValue& metadataRef) {
 
             if (data[METADATA_TILE] == METADATA_ALBUM_FIELD) {
                 m_album = data[METADATA_TEXT].toString();
+            } else if (data[METADATA_TILE] == METADATA_RELEASE_DATE_FIELD) {
+                m_releaseDate = data[METADATA_TEXT].toString();
             }
         }
     }
@@ -124,3 +167,15 @@ QString ShazamResponse::getArtist() const {
 int ShazamResponse::getTrack() const {
     return m_track;
 }
+
+QString ShazamResponse::getKey() const {
+    return m_key;
+}
+
+QString ShazamResponse::getReleaseDate() const {
+    return m_releaseDate;
+}
+
+double ShazamResponse::getOffset() const {
+    return m_offset;
+}
@@ -4,6 +4,8 @@
 #include <QString>
 #include <qtmetamacros.h>
 
+#include "shazam_codec.h"
+
 class ShazamResponse {
     public:
         /*
@@ -18,6 +20,17 @@ class ShazamResponse {
 
         static ShazamResponse fromJsonDocument(const QJsonDocument& document);
 
+        /*
+         * From the fields parseShazamResponse() picked out of a response,
+         * the same result as fromJsonDocument() without the DOM
+         */
+        static ShazamResponse fromFields(const ShazamResponseFields& fields);
+
+        /*
+         * A song found without asking Shazam, e.g. in the local index
+         */
+        static ShazamResponse fromTrack(const QString& title, const QString& artist, const QString& album, int track);
+
         /* Getters */
         bool        getFound() const;
         QString     getTitle() const;
@@ -25,6 +38,14 @@ class ShazamResponse {
         QString     getAlbum() const;
         int         getTrack() const;
 
+        /*
+         * Shazam's id for the track, when and where in the track the
+         * match was (in seconds, -1 if not known)
+         */
+        QString     getKey() const;
+        QString     getReleaseDate() const;
+        double      getOffset() const;
+
     private:
         /* Constructors */
 
@@ -41,8 +62,12 @@ class ShazamResponse {
         QString     m_artist;
         QString     m_album;
         int         m_track;
+        QString     m_key;
+        QString     m_releaseDate;
+        double      m_offset = -1;
 
         /* JSON parser */
+        void        parseMatches(const QJsonValue& matchesRef);
         void        parseSections(const QJsonValue& sectionsRef);
         void        parseSection(const QJsonValue& sectionRef);
         void        parseMetadata(const QJsonValue& metadataRef);
@@ -9,24 +9,20 @@
 #include <QSet>
 #include <QSystemTrayIcon>
 #include <qnamespace.h>
-#include <vibra.h>
 
 #include "about_dialog.h"
 #include "song_detector.h"
-#include "pipewire/pipewire_monitor.h"
 #include "settingsdialog.h"
 #include "settings.h"
 
 SongDetector::SongDetector(QApplication* app)
     : m_applicationName("SongDetector")
-    , m_pipeWireMonitor(nullptr)
-    , m_shazam(this)
     , m_settings(this)
+    , m_identifier(m_applicationName, &m_settings, this)
     , m_icon(QIcon(":/resources/icons/app-light-mode.svg"))
     , m_iconPixmap(m_icon.pixmap(QSize())) {
-        initialisePipeWire();
-
-        connect(&m_shazam, &Shazam::detectionComplete, this, &SongDetector::onDetectionComplete);
+        connect(&m_identifier, &SongIdentifier::identified, this, &SongDetector::notifyFound);
+        connect(&m_identifier, &SongIdentifier::notIdentified, this, &SongDetector::notifyNotFound);
 
         // Setup system tray menu...
         m_menu.addAction(QCoreApplication::translate("ContextMenu", "Settings..."), this, &SongDetector::onOpenSettings);
@@ -42,16 +38,6 @@ SongDetector::SongDetector(QApplication* app)
         m_trayIcon.show();
 }
 
-void SongDetector::initialisePipeWire() {
-    // Delete any existing PipeWire monitor instance
-    if (m_pipeWireMonitor != nullptr) {
-        delete m_pipeWireMonitor;
-    }
-
-    m_pipeWireMonitor = new PipeWireMonitor(m_applicationName, this);
-    connect(m_pipeWireMonitor, &PipeWireMonitor::captureCompleted, this, &SongDetector::onCaptureCompleted);
-}
-
 void SongDetector::setTrayIcon() {
     bool darkModeIcon = false;
 
@@ -80,53 +66,56 @@ void SongDetector::setTrayIcon() {
  * Slots
  */
 void SongDetector::onStartDetection() {
-    m_pipeWireMonitor->startCapture(10);
+    m_identifier.identify();
 }
 
-void SongDetector::onCaptureCompleted(QByteArray audioBuffer) {
-    qDebug() << "onCaptureCompleted";
+void SongDetector::notifyFound(const ShazamResponse& response, const QString& source) {
+    QString text = QString("Found %1 - %2").arg(response.getArtist(), response.getTitle());
 
-    const auto fp = vibra_get_fingerprint_from_signed_pcm(
-        audioBuffer.data(),
-        audioBuffer.size(),
-        m_pipeWireMonitor->getSampleRate(),
-        m_pipeWireMonitor->getBitsPerSample(),
-        m_pipeWireMonitor->getChannels()
-    );
+    // Only worth saying where when there's more than one place to hear it
+    if (m_identifier.getSources().size() > 1) {
+        text += QString(" on %1").arg(source);
+    }
 
-    const auto uri = QString::fromUtf8(vibra_get_uri_from_fingerprint(fp));
-    m_shazam.detectFromUri(uri, m_pipeWireMonitor->getBufferLengthInSeconds());
+    KNotification::event(KNotification::Notification,
+        QString("SongDetector - Song identified"),
+        text,
+        m_iconPixmap,
+        KNotification::Persistent | KNotification::CloseOnTimeout
+    );
 }
 
-void SongDetector::onDetectionComplete(const ShazamResponse& response) {
-    if (response.getFound()) {
-        KNotification::event(KNotification::Notification,
-            QString("SongDetector - Song identified"),
-            QString("Found %1 - %2").arg(response.getArtist(), response.getTitle()),
-            m_iconPixmap,
-            KNotification::Persistent | KNotification::CloseOnTimeout
-        );
-    } else {
-        qWarning() << "Song not found";
-        KNotification::event(KNotification::Warning,
-            "SongDetector - Failed to identify song",
-            "SongDetector was unable to identify the song that is playing.",
-            QPixmap(),
-            KNotification::Persistent | KNotification::CloseOnTimeout
-        );
+void SongDetector::notifyNotFound(const QString& source) {
+    qWarning() << "Song not found on" << source;
+
+    // Adverts and talk between tracks aren't worth a warning
+    if (m_identifier.wasAutomatic(source)) {
+        return;
     }
+
+    const QString text = m_identifier.getSources().size() > 1 ?
+        QString("SongDetector was unable to identify the song that is playing on %1.").arg(source) :
+        QString("SongDetector was unable to identify the song that is playing.");
+
+    KNotification::event(KNotification::Warning,
+        "SongDetector - Failed to identify song",
+        text,
+        QPixmap(),
+        KNotification::Persistent | KNotification::CloseOnTimeout
+    );
 }
 
 void SongDetector::onOpenSettings() {
     const auto settingsDialog = new SettingsDialog(&m_settings);
     settingsDialog->setAttribute(Qt::WA_DeleteOnClose);
     connect(settingsDialog, &SettingsDialog::forceDarkModeChanged, this, &SongDetector::onForceDarkIconChanged);
+    connect(settingsDialog, &SettingsDialog::continuousCaptureChanged, this, &SongDetector::onContinuousCaptureChanged);
     connect(settingsDialog, &SettingsDialog::currentDeviceChanged, this, &SongDetector::onCurrentDeviceChanged);
     settingsDialog->show();
 }
 
 void SongDetector::onOpenAbout() {
-    const auto aboutDialog = new AboutDialog(m_pipeWireMonitor->getPipeWireVersion());
+    const auto aboutDialog = new AboutDialog(m_identifier.getPipeWireVersion());
     aboutDialog->setAttribute(Qt::WA_DeleteOnClose);
     aboutDialog->show();
 }
@@ -135,6 +124,11 @@ void SongDetector::onForceDarkIconChanged() {
     setTrayIcon();
 }
 
+void SongDetector::onContinuousCaptureChanged() {
+    // Auto identify goes along with continuous capture
+    m_identifier.applySettings();
+}
+
 void SongDetector::onCurrentDeviceChanged(const QString& deviceId) {
     qDebug() << "TODO: onCurrentDeviceChanged";
 }
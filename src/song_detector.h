@@ -1,5 +1,6 @@
 #pragma once
 
+#include <QHash>
 #include <QObject>
 #include <QSystemTrayIcon>
 #include <pthread.h>
@@ -10,8 +11,7 @@
 #include <qsettings.h>
 #include <qtmetamacros.h>
 
-#include "pipewire/pipewire_monitor.h"
-#include "shazam/shazam.h"
+#include "song_identifier.h"
 
 class SongDetector : public QObject {
     Q_OBJECT
@@ -21,23 +21,22 @@ public:
 
 public slots:
     void                onForceDarkIconChanged();
+    void                onContinuousCaptureChanged();
     void                onStartDetection();
     void                onOpenSettings();
     void                onOpenAbout();
-    void                onCaptureCompleted(QByteArray audioBuffer);
-    void                onDetectionComplete(const ShazamResponse& response);
     void                onCurrentDeviceChanged(const QString& deviceId);
 
 private:
-    PipeWireMonitor*    m_pipeWireMonitor = nullptr;
-    Shazam              m_shazam;
-    QSystemTrayIcon     m_trayIcon;
-    QMenu               m_menu;
     QString             m_applicationName;
     QSettings           m_settings;
+    SongIdentifier      m_identifier;
+    QSystemTrayIcon     m_trayIcon;
+    QMenu               m_menu;
     QIcon               m_icon;
     QPixmap             m_iconPixmap;
 
     void                setTrayIcon();
-    void                initialisePipeWire();
+    void                notifyFound(const ShazamResponse& response, const QString& source);
+    void                notifyNotFound(const QString& source);
 };
@@ -0,0 +1,416 @@
+#include <QDebug>
+
+#include "capture/capture_sources.h"
+#include "latency_stats.h"
+#include "pipewire/pipewire_monitor.h"
+#include "settings.h"
+#include "song_identifier.h"
+#include "trace.h"
+
+SongIdentifier::SongIdentifier(const QString& applicationName, QSettings* settings, QObject* parent,
+                               CaptureSource* captureSource) :
+    QObject(parent),
+    m_applicationName(applicationName),
+    m_settings(settings),
+    m_fingerprinter(this),
+    m_shazam(this) {
+        connect(&m_fingerprinter, &Fingerprinter::fingerprintReady, this, &SongIdentifier::onFingerprintReady);
+        connect(&m_shazam, &Shazam::detectionComplete, this, &SongIdentifier::onDetectionComplete);
+
+        m_shazam.openLocalIndex(m_settings->value(LOCAL_INDEX_SETTING).toString());
+        applySettings();
+
+        if (captureSource != nullptr) {
+            addCaptureSource(captureSource);
+            return;
+        }
+
+        const auto specs = m_settings->value(CAPTURE_SOURCES_SETTING, QStringList { CAPTURE_SOURCE_PIPEWIRE }).toStringList();
+        for (const auto& spec : specs) {
+            QString errorString;
+            auto* source = createCaptureSource(spec, m_applicationName, CAPTURE_SPEED_DEFAULT, errorString);
+
+            if (source == nullptr) {
+                qWarning() << "Skipping capture source" << spec << errorString;
+                continue;
+            }
+
+            addCaptureSource(source);
+        }
+
+        if (m_sources.isEmpty()) {
+            addCaptureSource(new PipeWireMonitor(m_applicationName));
+        }
+}
+
+void SongIdentifier::addCaptureSource(CaptureSource* captureSource) {
+    const int index = static_cast<int>(m_sources.size());
+
+    if (captureSource->objectName().isEmpty()) {
+        captureSource->setObjectName(qobject_cast<PipeWireMonitor*>(captureSource) != nullptr ?
+            CAPTURE_SOURCE_PIPEWIRE :
+            QString("source%1").arg(index));
+    }
+
+    Source source;
+    source.captureSource = captureSource;
+    m_sources.append(source);
+
+    captureSource->setParent(this);
+    connect(captureSource, &CaptureSource::captureCompleted, this, [this, index](QByteArray audioBuffer) {
+        onCaptureCompleted(index, audioBuffer);
+    });
+    connect(captureSource, &CaptureSource::chunkCaptured, this, [this, index](QByteArray chunk) {
+        onChunkCaptured(index, chunk);
+    });
+    connect(captureSource, &CaptureSource::captureSilent, this, [this, index] {
+        onCaptureSilent(index);
+    });
+
+    // Queued, as the capture source is in the middle of a drain
+    connect(captureSource, &CaptureSource::trackChanged, this, [this, index] {
+        onTrackChanged(index);
+    }, Qt::QueuedConnection);
+
+    applySourceSettings(index);
+}
+
+QStringList SongIdentifier::getSources() const {
+    QStringList names;
+    for (int i = 0; i < m_sources.size(); i++) {
+        names.append(nameOf(i));
+    }
+
+    return names;
+}
+
+void SongIdentifier::identify() {
+    for (int i = 0; i < m_sources.size(); i++) {
+        startIdentification(i, false);
+    }
+}
+
+bool SongIdentifier::identify(const QString& source) {
+    const int index = indexOf(source);
+    if (index < 0) {
+        return false;
+    }
+
+    startIdentification(index, false);
+    return true;
+}
+
+void SongIdentifier::stop() {
+    for (auto& source : m_sources) {
+        source.captureSource->onStopCapture();
+        source.pendingLookups.clear();
+        source.identifying = false;
+    }
+
+    m_shazam.cancelPending();
+}
+
+void SongIdentifier::setContinuousCapture(bool enabled) {
+    const int windowLength = m_settings->value(PREROLL_LENGTH_SETTING, DEFAULT_PREROLL_LENGTH_IN_SECONDS).toInt();
+
+    for (auto& source : m_sources) {
+        source.captureSource->setContinuousCapture(enabled, windowLength);
+    }
+}
+
+bool SongIdentifier::isContinuousCapture() const {
+    // Every source is set up the same
+    return !m_sources.isEmpty() && m_sources.first().captureSource->isContinuousCapture();
+}
+
+void SongIdentifier::applySettings() {
+    const auto engine = m_settings->value(FINGERPRINT_ENGINE_SETTING, FINGERPRINT_ENGINE_VIBRA).toString();
+    m_fingerprinter.setEngine(engine == FINGERPRINT_ENGINE_NATIVE ? FingerprintEngine::Native : FingerprintEngine::Vibra);
+
+    const auto fairness = m_settings->value(LOOKUP_FAIRNESS_SETTING, LOOKUP_FAIRNESS_ROUND_ROBIN).toString();
+    m_shazam.setFairness(fairness == LOOKUP_FAIRNESS_IN_ORDER ? LookupFairness::InOrder : LookupFairness::RoundRobin);
+    m_shazam.setHedgePercentile(m_settings->value(HEDGE_PERCENTILE_SETTING, SHAZAM_DEFAULT_HEDGE_PERCENTILE).toInt());
+
+    m_autoIdentify = m_settings->value(AUTO_IDENTIFY_SETTING, false).toBool();
+
+    for (int i = 0; i < m_sources.size(); i++) {
+        applySourceSettings(i);
+    }
+}
+
+bool SongIdentifier::isCaptureSuspended() const {
+    for (const auto& source : m_sources) {
+        if (!source.captureSource->isSuspended()) {
+            return false;
+        }
+    }
+
+    return !m_sources.isEmpty();
+}
+
+bool SongIdentifier::isAutoIdentify() const {
+    return m_autoIdentify && isContinuousCapture();
+}
+
+bool SongIdentifier::wasAutomatic(const QString& source) const {
+    const int index = indexOf(source);
+    return index >= 0 && m_sources[index].automatic;
+}
+
+const Shazam& SongIdentifier::getShazam() const {
+    return m_shazam;
+}
+
+quint64 SongIdentifier::getBufferAllocations() const {
+    quint64 allocations = 0;
+    for (const auto& source : m_sources) {
+        allocations += source.captureSource->getBufferAllocations();
+    }
+
+    return allocations;
+}
+
+QString SongIdentifier::getPipeWireVersion() const {
+    for (const auto& source : m_sources) {
+        auto* pipeWireMonitor = qobject_cast<PipeWireMonitor*>(source.captureSource);
+        if (pipeWireMonitor != nullptr) {
+            return pipeWireMonitor->getPipeWireVersion();
+        }
+    }
+
+    return QString();
+}
+
+/*
+ * Slots
+ */
+void SongIdentifier::onFingerprintReady(const FingerprintResult& result) {
+    TraceSpan span("onFingerprintReady", "identifier");
+
+    auto& source = m_sources[result.source];
+
+    if (result.generation != source.generation) {
+        qDebug() << "Dropping a fingerprint from an earlier identification on" << nameOf(result.source);
+        return;
+    }
+
+    if (!result.partial) {
+        recordLatency(LatencyStage::Fingerprint, source.fingerprintTimer);
+        source.fingerprintTimer.invalidate();
+    }
+
+    if (source.identified || !source.identifying) {
+        // An earlier signature has already been matched, or the
+        // identification was stopped
+        return;
+    }
+
+    const auto requestId = m_shazam.detectFromUri(result.uri, result.lengthInSeconds, result.source);
+    source.pendingLookups.insert(requestId, result.partial);
+}
+
+void SongIdentifier::onDetectionComplete(quint64 requestId, const ShazamResponse& response) {
+    TraceSpan span("onDetectionComplete", "identifier");
+
+    int index = 0;
+    while (index < m_sources.size() && !m_sources[index].pendingLookups.contains(requestId)) {
+        index++;
+    }
+
+    if (index == m_sources.size()) {
+        return;
+    }
+
+    auto& source = m_sources[index];
+    const bool partial = source.pendingLookups.take(requestId);
+
+    if (source.identified) {
+        return;
+    }
+
+    if (response.getFound()) {
+        source.identified = true;
+
+        if (partial) {
+            // Early exit, the rest of the capture isn't needed
+            qDebug() << "Identified from a partial signature on" << nameOf(index);
+            stopIdentification(index);
+        }
+
+        recordLatency(LatencyStage::Identification, source.identifyTimer);
+        traceAsyncEnd("identification", source.traceId);
+        source.identifying = false;
+
+        // A change that wasn't, only worth mentioning when asked for
+        const QString found = response.getArtist() + " - " + response.getTitle();
+        if (source.automatic && found == source.lastFound) {
+            qInfo() << "Still playing" << found << "on" << nameOf(index);
+            return;
+        }
+
+        source.lastFound = found;
+        identified(response, nameOf(index));
+        return;
+    }
+
+    if (!partial) {
+        source.finalLookupFailed = true;
+    }
+
+    notIdentifiedIfDone(index);
+}
+
+/*******************************************************
+ * Private methods
+ *******************************************************/
+
+void SongIdentifier::onChunkCaptured(int index, const QByteArray& chunk) {
+    TraceSpan span("onChunkCaptured", "identifier");
+
+    if (useStreamingFingerprint(index)) {
+        m_fingerprinter.feedStream(index, chunk, m_sources[index].captureSource->getFormat());
+    }
+}
+
+void SongIdentifier::onCaptureCompleted(int index, const QByteArray& audioBuffer) {
+    TraceSpan span("onCaptureCompleted", "identifier");
+    qDebug() << "onCaptureCompleted" << nameOf(index);
+
+    auto& source = m_sources[index];
+    source.fingerprintTimer.start();
+
+    // Fingerprinting happens on a worker thread, never on the main thread
+    if (useStreamingFingerprint(index)) {
+        // Every chunk has already been fed in, just collect the signature
+        m_fingerprinter.finishStream(index, source.captureSource->getBufferLengthInSeconds());
+        return;
+    }
+
+    m_fingerprinter.fingerprint(
+        audioBuffer,
+        source.captureSource->getFormat(),
+        source.captureSource->getBufferLengthInSeconds(),
+        index,
+        source.generation
+    );
+}
+
+void SongIdentifier::onCaptureSilent(int index) {
+    qInfo() << "Nothing to identify on" << nameOf(index) << "only silence was captured";
+
+    // No fingerprint, and no Shazam lookup that is bound to fail
+    m_sources[index].finalLookupFailed = true;
+    notIdentifiedIfDone(index);
+}
+
+void SongIdentifier::onTrackChanged(int index) {
+    if (!isAutoIdentify()) {
+        return;
+    }
+
+    if (m_sources[index].identifying) {
+        qDebug() << "Track changed on" << nameOf(index) << "during an identification, leaving it be";
+        return;
+    }
+
+    qInfo() << "Track changed on" << nameOf(index) << "identifying";
+    trackChanged(nameOf(index));
+    startIdentification(index, true);
+}
+
+void SongIdentifier::startIdentification(int index, bool automatic) {
+    TraceSpan span("identify", "identifier");
+
+    auto& source = m_sources[index];
+    source.traceId = traceNextId();
+    traceAsyncBegin("identification", source.traceId);
+
+    // Anything still on its way from an earlier identification is no
+    // longer wanted
+    for (const auto requestId : source.pendingLookups.keys()) {
+        m_shazam.cancel(requestId);
+    }
+
+    source.generation++;
+    source.identifyTimer.start();
+    source.fingerprintTimer.invalidate();
+    source.pendingLookups.clear();
+    source.identified = false;
+    source.finalLookupFailed = false;
+    source.identifying = true;
+    source.automatic = automatic;
+
+    // Connect to Shazam while the audio is captured, rather than after
+    m_shazam.warmUp();
+
+    if (useStreamingFingerprint(index)) {
+        // Progressive identification sends early signatures as the
+        // capture runs and stops as soon as one of them matches
+        QList<int> checkpoints;
+        if (m_settings->value(PROGRESSIVE_IDENTIFY_SETTING, true).toBool()) {
+            checkpoints = PROGRESSIVE_CHECKPOINTS_IN_SECONDS;
+        }
+
+        m_fingerprinter.startStream(index, source.generation, checkpoints);
+    }
+
+    source.captureSource->startCapture(10);
+}
+
+void SongIdentifier::stopIdentification(int index) {
+    // Only this source's lookups, the others carry on
+    auto& source = m_sources[index];
+    source.captureSource->onStopCapture();
+
+    for (const auto requestId : source.pendingLookups.keys()) {
+        m_shazam.cancel(requestId);
+    }
+
+    source.pendingLookups.clear();
+    source.identifying = false;
+}
+
+void SongIdentifier::notIdentifiedIfDone(int index) {
+    // Only give up once the full window has failed and no earlier
+    // signature can still come back with a match
+    auto& source = m_sources[index];
+    if (source.finalLookupFailed && source.pendingLookups.isEmpty()) {
+        recordLatency(LatencyStage::Identification, source.identifyTimer);
+        traceAsyncEnd("identification", source.traceId);
+        source.identifying = false;
+        notIdentified(nameOf(index));
+    }
+}
+
+void SongIdentifier::applySourceSettings(int index) {
+    auto* captureSource = m_sources[index].captureSource;
+
+    captureSource->setSilenceGate(m_settings->value(SILENCE_GATE_SETTING, true).toBool());
+    captureSource->setContinuousCapture(
+        m_settings->value(CONTINUOUS_CAPTURE_SETTING, false).toBool(),
+        m_settings->value(PREROLL_LENGTH_SETTING, DEFAULT_PREROLL_LENGTH_IN_SECONDS).toInt()
+    );
+    captureSource->setTrackChangeDetection(m_autoIdentify);
+}
+
+bool SongIdentifier::useStreamingFingerprint(int index) const {
+    // Either engine, vibra goes over the audio kept so far at each
+    // checkpoint. Continuous capture answers from the pre-roll window in
+    // one go.
+    return !m_sources[index].captureSource->isContinuousCapture() &&
+        m_settings->value(STREAMING_FINGERPRINT_SETTING, true).toBool();
+}
+
+int SongIdentifier::indexOf(const QString& source) const {
+    for (int i = 0; i < m_sources.size(); i++) {
+        if (nameOf(i) == source) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+QString SongIdentifier::nameOf(int index) const {
+    return m_sources[index].captureSource->objectName();
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QSettings>
+#include <QString>
+#include <QStringList>
+#include <qtmetamacros.h>
+
+#include "capture/capture_source.h"
+#include "fingerprint/fingerprinter.h"
+#include "shazam/shazam.h"
+
+/*
+ * The identification pipeline: capture -> fingerprint (worker threads)
+ * -> Shazam lookup.
+ *
+ * Only needs QtCore and QtNetwork, so it is shared by the tray app and
+ * the headless daemon, which each decide what to do with the result.
+ * Behaviour is configured from the SongDetector settings.
+ *
+ * Captures from the sources listed in the settings (PipeWire's default
+ * sink unless told otherwise), unless given a CaptureSource, which it
+ * takes ownership of. More can be added with addCaptureSource().
+ *
+ * Every source is identified on its own and its results are tagged with
+ * its name. The sources share one fingerprinting thread pool and one
+ * Shazam client, which takes lookups from each source in turn, so an
+ * extra source only costs its capture buffers and the CPU its audio takes.
+ *
+ * With auto identify on, continuous capture identifies each new track by
+ * itself as the track changes. A track that is still the last one found
+ * on that source isn't raised again.
+ */
+class SongIdentifier : public QObject {
+    Q_OBJECT
+
+    public:
+        SongIdentifier(const QString& applicationName, QSettings* settings, QObject* parent,
+                       CaptureSource* captureSource = nullptr);
+
+        /*
+         * Adds another source to identify from, which is named after its
+         * objectName() and set up like the others
+         */
+        void    addCaptureSource(CaptureSource* captureSource);
+
+        /*
+         * Names of the capture sources, in the order they were added
+         */
+        QStringList getSources() const;
+
+        /*
+         * Identifies what is playing on every source, raising identified()
+         * or notIdentified() for each once done
+         */
+        void    identify();
+
+        /*
+         * Identifies what is playing on one source. False if there is no
+         * such source.
+         */
+        bool    identify(const QString& source);
+
+        /*
+         * Stops every capture and any lookups in flight, no result is raised
+         */
+        void    stop();
+
+        /*
+         * Keeps listening in the background, with the pre-roll length
+         * from the settings, see CaptureSource::setContinuousCapture()
+         */
+        void    setContinuousCapture(bool enabled);
+        bool    isContinuousCapture() const;
+
+        /*
+         * Re-reads the settings that can change while running
+         */
+        void    applySettings();
+
+        /*
+         * True while continuous capture is suspended for silence on
+         * every source
+         */
+        bool    isCaptureSuspended() const;
+
+        /*
+         * True if continuous capture identifies each new track by itself,
+         * and whether the latest identification on `source` was started
+         * that way
+         */
+        bool    isAutoIdentify() const;
+        bool    wasAutomatic(const QString& source) const;
+
+        /*
+         * Capture buffers allocated so far by every source, which stays
+         * put once identifications reach a steady state
+         */
+        quint64 getBufferAllocations() const;
+
+        /*
+         * The Shazam client, for its lookup stats
+         */
+        const Shazam&   getShazam() const;
+
+        /*
+         * Empty unless capturing from PipeWire
+         */
+        QString getPipeWireVersion() const;
+
+    signals:
+        void    identified(const ShazamResponse& response, const QString& source);
+        void    notIdentified(const QString& source);
+
+        /*
+         * Raised when a track change starts an identification
+         */
+        void    trackChanged(const QString& source);
+
+    private slots:
+        void    onFingerprintReady(const FingerprintResult& result);
+        void    onDetectionComplete(quint64 requestId, const ShazamResponse& response);
+
+    private:
+        struct Source {
+            CaptureSource*  captureSource = nullptr;
+
+            // State of the identification in progress, lookup request id -> partial.
+            // The generation goes up with every identification, fingerprints
+            // of audio captured for an earlier one are dropped.
+            quint64         generation = 0;
+            QHash<quint64, bool> pendingLookups;
+            bool            identified = false;
+            bool            finalLookupFailed = false;
+            bool            identifying = false;
+
+            // Auto identify state, the last track found as "artist - title"
+            bool            automatic = false;
+            QString         lastFound;
+
+            // Latency stats for the identification in progress
+            QElapsedTimer   identifyTimer;
+            QElapsedTimer   fingerprintTimer;
+            quint64         traceId = 0;
+        };
+
+        /*
+         * Capture events from the source at `index`
+         */
+        void    onCaptureCompleted(int index, const QByteArray& audioBuffer);
+        void    onChunkCaptured(int index, const QByteArray& chunk);
+        void    onCaptureSilent(int index);
+        void    onTrackChanged(int index);
+
+        void    startIdentification(int index, bool automatic);
+        void    stopIdentification(int index);
+        void    notIdentifiedIfDone(int index);
+        void    applySourceSettings(int index);
+        bool    useStreamingFingerprint(int index) const;
+        int     indexOf(const QString& source) const;
+        QString nameOf(int index) const;
+
+        QString             m_applicationName;
+        QSettings*          m_settings;
+        QList<Source>       m_sources;
+
+        // Shared by every source
+        Fingerprinter       m_fingerprinter;
+        Shazam              m_shazam;
+
+        bool                m_autoIdentify = false;
+};
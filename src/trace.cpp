@@ -0,0 +1,250 @@
+#include <QCoreApplication>
+#include <QDebug>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QThreadPool>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+#define TRACE_FLOW_CATEGORY "hop"
+#define TRACE_ASYNC_CATEGORY "async"
+
+struct TraceEvent {
+    const char* name;
+    const char* category;
+    qint64      timestamp;  // Nanoseconds since tracing started
+    qint64      duration;   // Complete events only
+    quint64     id;         // Flow and async events only
+    char        phase;
+};
+
+struct TraceThreadBuffer {
+    std::unique_ptr<TraceEvent[]>   events;
+
+    // Only the owning thread writes, count is published after the event
+    std::atomic<size_t>     count{0};
+    std::atomic<uint64_t>   dropped{0};
+    std::atomic<bool>       claimed{false};
+
+    long                    threadId = 0;
+    char                    threadName[16] = {};
+};
+
+static std::atomic<bool>    g_tracing{false};
+static QString              g_path;
+static std::chrono::steady_clock::time_point g_start;
+
+// Never freed, a thread may still be recording while the trace is written
+static TraceThreadBuffer*   g_buffers = nullptr;
+static std::atomic<int>     g_nextBuffer{0};
+static std::atomic<quint64> g_nextId{1};
+
+static thread_local TraceThreadBuffer*  t_buffer = nullptr;
+static thread_local bool                t_outOfBuffers = false;
+
+static qint64 now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - g_start).count();
+}
+
+static TraceThreadBuffer* threadBuffer() {
+    if (t_buffer != nullptr || t_outOfBuffers) {
+        return t_buffer;
+    }
+
+    const int index = g_nextBuffer.fetch_add(1, std::memory_order_relaxed);
+    if (index >= TRACE_MAX_THREADS) {
+        t_outOfBuffers = true;
+        return nullptr;
+    }
+
+    auto* buffer = &g_buffers[index];
+    buffer->threadId = syscall(SYS_gettid);
+    pthread_getname_np(pthread_self(), buffer->threadName, sizeof(buffer->threadName));
+    buffer->claimed.store(true, std::memory_order_release);
+
+    t_buffer = buffer;
+    return buffer;
+}
+
+static void record(char phase, const char* name, const char* category, qint64 timestamp, qint64 duration, quint64 id) {
+    auto* buffer = threadBuffer();
+    if (buffer == nullptr) {
+        return;
+    }
+
+    const size_t index = buffer->count.load(std::memory_order_relaxed);
+    if (index >= TRACE_EVENTS_PER_THREAD) {
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    buffer->events[index] = { name, category, timestamp, duration, id, phase };
+    buffer->count.store(index + 1, std::memory_order_release);
+}
+
+bool startTracingFromEnvironment() {
+    if (g_buffers != nullptr || !qEnvironmentVariableIsSet(TRACE_ENVIRONMENT_VARIABLE)) {
+        return false;
+    }
+
+    g_path = qEnvironmentVariable(TRACE_ENVIRONMENT_VARIABLE);
+
+    // Pages are only really allocated once a thread writes to them
+    g_buffers = new TraceThreadBuffer[TRACE_MAX_THREADS];
+    for (int i = 0; i < TRACE_MAX_THREADS; i++) {
+        g_buffers[i].events.reset(new TraceEvent[TRACE_EVENTS_PER_THREAD]);
+    }
+
+    // Buffers are never given back, so a pool that retires idle threads
+    // would run out of them in a long session. Pools created from here on
+    // check isTracing() and do the same.
+    QThreadPool::globalInstance()->setExpiryTimeout(-1);
+
+    g_start = std::chrono::steady_clock::now();
+    g_tracing.store(true, std::memory_order_release);
+
+    qInfo() << "Tracing to" << g_path;
+    return true;
+}
+
+bool isTracing() {
+    return g_tracing.load(std::memory_order_relaxed);
+}
+
+quint64 traceNextId() {
+    return g_nextId.fetch_add(1, std::memory_order_relaxed);
+}
+
+void traceFlowBegin(const char* name, quint64 id) {
+    if (isTracing()) {
+        record('s', name, TRACE_FLOW_CATEGORY, now(), 0, id);
+    }
+}
+
+void traceFlowEnd(const char* name, quint64 id) {
+    if (isTracing()) {
+        record('f', name, TRACE_FLOW_CATEGORY, now(), 0, id);
+    }
+}
+
+void traceAsyncBegin(const char* name, quint64 id) {
+    if (isTracing()) {
+        record('b', name, TRACE_ASYNC_CATEGORY, now(), 0, id);
+    }
+}
+
+void traceAsyncEnd(const char* name, quint64 id) {
+    if (isTracing()) {
+        record('e', name, TRACE_ASYNC_CATEGORY, now(), 0, id);
+    }
+}
+
+TraceSpan::TraceSpan(const char* name, const char* category) :
+    m_name(name),
+    m_category(category),
+    m_start(isTracing() ? now() : -1) {
+}
+
+TraceSpan::~TraceSpan() {
+    if (m_start >= 0) {
+        const qint64 end = now();
+        record('X', m_name, m_category, m_start, end - m_start, 0);
+    }
+}
+
+/*
+ * Writing the trace
+ */
+static QByteArray metadataEvent(const char* name, long threadId, const QString& value) {
+    QJsonObject event;
+    event["ph"] = "M";
+    event["name"] = name;
+    event["pid"] = static_cast<qint64>(getpid());
+    event["tid"] = static_cast<qint64>(threadId);
+    event["args"] = QJsonObject{ { "name", value } };
+    return QJsonDocument(event).toJson(QJsonDocument::Compact);
+}
+
+static QByteArray traceEvent(const TraceEvent& event, long threadId) {
+    // Microseconds, with nanosecond precision
+    QByteArray json = QByteArray("{\"ph\":\"") + event.phase +
+        "\",\"name\":\"" + event.name +
+        "\",\"cat\":\"" + event.category +
+        "\",\"pid\":" + QByteArray::number(getpid()) +
+        ",\"tid\":" + QByteArray::number(static_cast<qint64>(threadId)) +
+        ",\"ts\":" + QByteArray::number(event.timestamp / 1000.0, 'f', 3);
+
+    switch (event.phase) {
+        case 'X':
+            json += ",\"dur\":" + QByteArray::number(event.duration / 1000.0, 'f', 3);
+            break;
+        case 'f':
+            // Bind to the span the arrow ends in
+            json += ",\"bp\":\"e\",\"id\":" + QByteArray::number(event.id);
+            break;
+        default:
+            json += ",\"id\":" + QByteArray::number(event.id);
+            break;
+    }
+
+    return json + "}";
+}
+
+bool writeTrace() {
+    if (g_buffers == nullptr) {
+        return false;
+    }
+
+    QSaveFile file(g_path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to write trace to" << g_path << file.errorString();
+        return false;
+    }
+
+    file.write("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    file.write(metadataEvent("process_name", getpid(), QCoreApplication::applicationName()));
+
+    const int threads = std::min(g_nextBuffer.load(std::memory_order_relaxed), TRACE_MAX_THREADS);
+    size_t events = 0;
+    uint64_t dropped = 0;
+
+    for (int i = 0; i < threads; i++) {
+        const auto& buffer = g_buffers[i];
+        if (!buffer.claimed.load(std::memory_order_acquire)) {
+            // Claimed, but the name isn't published yet
+            continue;
+        }
+
+        file.write(",\n" + metadataEvent("thread_name", buffer.threadId, QString::fromUtf8(buffer.threadName)));
+
+        const size_t count = buffer.count.load(std::memory_order_acquire);
+        for (size_t j = 0; j < count; j++) {
+            file.write(",\n" + traceEvent(buffer.events[j], buffer.threadId));
+        }
+
+        events += count;
+        dropped += buffer.dropped.load(std::memory_order_relaxed);
+    }
+
+    file.write("\n]}\n");
+
+    if (!file.commit()) {
+        qWarning() << "Failed to write trace to" << g_path << file.errorString();
+        return false;
+    }
+
+    qInfo() << "Wrote" << events << "trace events to" << g_path;
+    if (dropped > 0 || g_nextBuffer.load(std::memory_order_relaxed) > TRACE_MAX_THREADS) {
+        qWarning() << "Trace is incomplete," << dropped << "events dropped from full buffers";
+    }
+
+    return true;
+}
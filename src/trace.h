@@ -0,0 +1,78 @@
+#pragma once
+
+#include <QString>
+#include <QtGlobal>
+
+/*
+ * Optional tracing of the identification pipeline, written out in the
+ * Chrome JSON trace format (open it in Perfetto or chrome://tracing).
+ *
+ * Turned on by setting SONGDETECTOR_TRACE to the path the trace should be
+ * written to. Each thread records into its own fixed size buffer, claimed
+ * from a pool allocated up front, so recording never locks or allocates
+ * and is safe on the PipeWire real-time thread. Once a buffer is full
+ * further events from that thread are dropped (and counted).
+ *
+ * A buffer stays with its thread for good, so thread pools must not
+ * expire idle threads while tracing (see QThreadPool::setExpiryTimeout).
+ *
+ * Names and categories must be string literals, only the pointers are
+ * stored.
+ */
+
+#define TRACE_ENVIRONMENT_VARIABLE "SONGDETECTOR_TRACE"
+
+#define TRACE_MAX_THREADS 32
+#define TRACE_EVENTS_PER_THREAD (64 * 1024)
+
+/*
+ * Starts tracing if SONGDETECTOR_TRACE is set. Only the first call does
+ * anything.
+ */
+bool    startTracingFromEnvironment();
+
+bool    isTracing();
+
+/*
+ * Writes everything recorded so far. Recording carries on, so this can
+ * be called as often as needed.
+ */
+bool    writeTrace();
+
+/*
+ * A unique id to tie flow or async events together
+ */
+quint64 traceNextId();
+
+/*
+ * Flow arrows, e.g. from the thread that queues some work to the span
+ * that runs it on another thread. Both ends must be inside a span.
+ */
+void    traceFlowBegin(const char* name, quint64 id);
+void    traceFlowEnd(const char* name, quint64 id);
+
+/*
+ * Spans that start and end in different callbacks, such as a network
+ * request
+ */
+void    traceAsyncBegin(const char* name, quint64 id);
+void    traceAsyncEnd(const char* name, quint64 id);
+
+/*
+ * Records the time from construction to destruction on this thread
+ */
+class TraceSpan {
+    public:
+        TraceSpan(const char* name, const char* category);
+        ~TraceSpan();
+
+        TraceSpan(const TraceSpan&) = delete;
+        TraceSpan& operator=(const TraceSpan&) = delete;
+
+    private:
+        const char* m_name;
+        const char* m_category;
+
+        // -1 when not tracing
+        qint64      m_start;
+};
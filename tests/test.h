@@ -0,0 +1,21 @@
+#pragma once
+
+/*
+ * Tiny test harness, run by CTest.
+ *
+ * Each suite checks its results and reports anything wrong with
+ * testFailed(), which makes the run exit non-zero. A suite is registered
+ * with CTest under its name, see CMakeLists.txt.
+ */
+
+/*
+ * Reports a check that failed. `name` is the check, `message` says what
+ * was wrong.
+ */
+void    testFailed(const char* name, const char* message);
+
+/*
+ * Test suites
+ */
+void    testCapture();
+void    testFingerprint();
@@ -0,0 +1,86 @@
+#include <QByteArray>
+#include <cstdint>
+#include <vector>
+
+#include "audio/buffer_pool.h"
+#include "audio/decimator.h"
+#include "audio/rolling_window.h"
+#include "capture/capture_source.h"
+#include "test.h"
+
+// Captures handed over once the pool has warmed up
+#define TEST_CAPTURE_HANDOFFS 100
+
+/*
+ * Hands captures over to fingerprinting the way
+ * CaptureSource::completeFromPrerollWindow() does, each one still held (as
+ * if being fingerprinted) until the next is handed over, the worst case
+ * for the pool. Once warm, none of them may allocate.
+ */
+static void checkHandoffDoesNotAllocate() {
+    const qsizetype captureSize = qsizetype(DECIMATED_SAMPLE_RATE) * qsizetype(sizeof(int16_t)) * DEFAULT_CAPTURE_LENGTH_IN_SECONDS;
+
+    RollingAudioWindow window;
+    window.setCapacity(captureSize);
+
+    const std::vector<int16_t> audio(static_cast<size_t>(captureSize) / sizeof(int16_t), 1000);
+    window.append(reinterpret_cast<const char*>(audio.data()), captureSize);
+
+    AudioBufferPool pool;
+    QByteArray fingerprinting;
+
+    const auto handoff = [&] {
+        QByteArray buffer = pool.acquire(captureSize);
+        window.snapshot(captureSize, buffer);
+
+        // The previous capture is done with as this one is handed over
+        fingerprinting = buffer;
+        pool.recycle(std::move(buffer));
+    };
+
+    // Fills the pool
+    handoff();
+    handoff();
+    const quint64 warmAllocations = pool.getAllocations();
+
+    for (int i = 0; i < TEST_CAPTURE_HANDOFFS; i++) {
+        handoff();
+
+        if (fingerprinting.size() != captureSize) {
+            testFailed("capture_handoff", "the capture handed over has the wrong size");
+            return;
+        }
+    }
+
+    if (pool.getAllocations() != warmAllocations) {
+        testFailed("capture_handoff", "steady state handoffs allocated a capture buffer");
+    }
+}
+
+/*
+ * A buffer that is still held elsewhere must not be handed out again
+ */
+static void checkHeldBufferIsNotReused() {
+    AudioBufferPool pool;
+
+    QByteArray buffer = pool.acquire(1024);
+    buffer.append(1024, 'a');
+    const QByteArray held = buffer;
+    const char* heldData = held.constData();
+    pool.recycle(std::move(buffer));
+
+    QByteArray next = pool.acquire(1024);
+    if (next.constData() == heldData) {
+        testFailed("capture_held_buffer", "a buffer still being fingerprinted was handed out again");
+    }
+
+    next.append(1024, 'b');
+    if (held != QByteArray(1024, 'a')) {
+        testFailed("capture_held_buffer", "a buffer still being fingerprinted was overwritten");
+    }
+}
+
+void testCapture() {
+    checkHandoffDoesNotAllocate();
+    checkHeldBufferIsNotReused();
+}
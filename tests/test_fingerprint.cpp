@@ -0,0 +1,151 @@
+#include <QDir>
+#include <QStringList>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include <vibra.h>
+
+#include "audio/decimator.h"
+#include "audio/wav_reader.h"
+#include "fingerprint/signature.h"
+#include "fingerprint/streaming_fingerprinter.h"
+#include "test.h"
+
+// More WAV files to check, e.g. real recordings that can't be shipped
+#define TEST_AUDIO_ENVIRONMENT_VARIABLE "SONGDETECTOR_TEST_AUDIO"
+
+// Progressive identification looks up the first 3, 6 and 10 seconds, then
+// the full capture
+static constexpr int PREFIX_SECONDS[] = { 3, 6, 10, SIGNATURE_MAX_SECONDS };
+
+/*
+ * Reads up to SIGNATURE_MAX_SECONDS of a WAV file, as the 16kHz mono
+ * audio captures are fingerprinted from
+ */
+static bool readAudio(const QString& path, std::vector<int16_t>& audio) {
+    WavReader reader;
+    if (!reader.open(path)) {
+        return false;
+    }
+
+    AudioDecimator decimator;
+    decimator.configure(reader.getFormat());
+
+    QByteArray block(64 * 1024 / reader.getFormat().bytesPerFrame() * reader.getFormat().bytesPerFrame(), 0);
+    const size_t maxSamples = static_cast<size_t>(SIGNATURE_MAX_SECONDS) * DECIMATED_SAMPLE_RATE;
+
+    audio.clear();
+    while (audio.size() < maxSamples) {
+        const qsizetype read = reader.read(block.data(), block.size());
+        if (read < 0) {
+            return false;
+        }
+        if (read == 0) {
+            break;
+        }
+
+        const size_t offset = audio.size();
+        audio.resize(offset + static_cast<size_t>(decimator.getMaxOutputSamples(read)));
+        audio.resize(offset + static_cast<size_t>(decimator.process(block.constData(), read, audio.data() + offset)));
+    }
+
+    audio.resize(std::min(audio.size(), maxSamples));
+    return !audio.empty();
+}
+
+/*
+ * Says which band, if any, makes two signatures differ
+ */
+static void describeDifference(const QString& vibraUri, const QString& nativeUri, char* message, size_t size) {
+    Signature vibra;
+    Signature native;
+    if (!Signature::decodeFromUri(vibraUri, vibra) || !Signature::decodeFromUri(nativeUri, native)) {
+        snprintf(message, size, "a signature didn't decode");
+        return;
+    }
+
+    if (vibra.getNumberOfSamples() != native.getNumberOfSamples()) {
+        snprintf(message, size, "%u samples from vibra, %u from the native engine",
+            vibra.getNumberOfSamples(), native.getNumberOfSamples());
+        return;
+    }
+
+    for (int band = 0; band < SIGNATURE_BAND_COUNT; band++) {
+        const auto& expected = vibra.getPeaks(static_cast<FrequencyBand>(band));
+        const auto& actual = native.getPeaks(static_cast<FrequencyBand>(band));
+
+        size_t same = 0;
+        while (same < expected.size() && same < actual.size() &&
+               expected[same].fftPassNumber == actual[same].fftPassNumber &&
+               expected[same].peakMagnitude == actual[same].peakMagnitude &&
+               expected[same].correctedPeakFrequencyBin == actual[same].correctedPeakFrequencyBin) {
+            same++;
+        }
+
+        if (same != expected.size() || same != actual.size()) {
+            snprintf(message, size, "band %d has %zu peaks from vibra and %zu from the native engine, the first %zu agree",
+                band, expected.size(), actual.size(), same);
+            return;
+        }
+    }
+
+    snprintf(message, size, "the peaks agree but the URIs don't");
+}
+
+/*
+ * The native engine has to produce exactly the signature vibra does, or
+ * lookups from the two would differ
+ */
+static void checkNativeMatchesVibra(const QString& path) {
+    std::vector<int16_t> audio;
+    if (!readAudio(path, audio)) {
+        testFailed("fingerprint_conformance", qPrintable("couldn't read " + path));
+        return;
+    }
+
+    StreamingFingerprinter fingerprinter;
+
+    for (const int seconds : PREFIX_SECONDS) {
+        const size_t samples = std::min(audio.size(), static_cast<size_t>(seconds) * DECIMATED_SAMPLE_RATE);
+        const auto* data = reinterpret_cast<const char*>(audio.data());
+        const auto size = static_cast<qsizetype>(samples * sizeof(int16_t));
+
+        const auto fingerprint = vibra_get_fingerprint_from_signed_pcm(data, static_cast<int>(size), DECIMATED_SAMPLE_RATE, 16, 1);
+        const QString vibraUri = QString::fromUtf8(vibra_get_uri_from_fingerprint(fingerprint));
+
+        fingerprinter.reset();
+        fingerprinter.feed(data, size, AudioDecimator::outputFormat());
+        const QString nativeUri = fingerprinter.getSignature().encodeToUri();
+
+        if (nativeUri != vibraUri) {
+            char difference[160];
+            describeDifference(vibraUri, nativeUri, difference, sizeof(difference));
+
+            const QString message = QStringLiteral("%1, first %2s: %3").arg(path).arg(seconds).arg(difference);
+            testFailed("fingerprint_conformance", qPrintable(message));
+        }
+
+        if (samples == audio.size()) {
+            break;
+        }
+    }
+}
+
+void testFingerprint() {
+    QStringList paths = {
+        ":/tests/data/plucked_melody.wav",
+        ":/tests/data/noisy_chords.wav",
+    };
+
+    if (qEnvironmentVariableIsSet(TEST_AUDIO_ENVIRONMENT_VARIABLE)) {
+        const QDir directory(qEnvironmentVariable(TEST_AUDIO_ENVIRONMENT_VARIABLE));
+        for (const QString& name : directory.entryList({ "*.wav" }, QDir::Files, QDir::Name)) {
+            paths.append(directory.absoluteFilePath(name));
+        }
+    }
+
+    for (const QString& path : paths) {
+        checkNativeMatchesVibra(path);
+    }
+}
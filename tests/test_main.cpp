@@ -0,0 +1,47 @@
+#include <cstdio>
+#include <cstring>
+#include <QtGlobal>
+
+#include "test.h"
+
+static bool g_failed = false;
+
+void testFailed(const char* name, const char* message) {
+    fprintf(stderr, "%s failed: %s\n", name, message);
+    g_failed = true;
+}
+
+/*
+ * Keeps the code under test from cluttering the output
+ */
+static void quietMessageHandler(QtMsgType type, const QMessageLogContext& context, const QString& message) {
+    Q_UNUSED(context);
+
+    if (type == QtCriticalMsg || type == QtFatalMsg) {
+        fprintf(stderr, "%s\n", qPrintable(message));
+    }
+}
+
+/*
+ * Usage: SongDetector_tests [suite]
+ *
+ * Runs every suite, or only the one named
+ */
+int main(int argc, char* argv[]) {
+    const char* suite = argc > 1 ? argv[1] : nullptr;
+    const auto selected = [suite](const char* name) {
+        return suite == nullptr || strcmp(suite, name) == 0;
+    };
+
+    qInstallMessageHandler(quietMessageHandler);
+
+    if (selected("capture")) {
+        testCapture();
+    }
+
+    if (selected("fingerprint")) {
+        testFingerprint();
+    }
+
+    return g_failed ? 1 : 0;
+}